@@ -0,0 +1,73 @@
+#include "alloc.h"
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef TETRIS_ALLOC_COUNT
+static thread_local long allocation_count = 0;
+#endif
+
+bool IsAllocationCountEnabled()
+{
+#ifdef TETRIS_ALLOC_COUNT
+    return true;
+#else
+    return false;
+#endif
+}
+
+long GetAllocationCount()
+{
+#ifdef TETRIS_ALLOC_COUNT
+    return allocation_count;
+#else
+    return 0;
+#endif
+}
+
+#ifdef TETRIS_ALLOC_COUNT
+#ifdef __GLIBC__
+// malloc itself, which operator new and C libraries like ncurses both call
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+
+void *malloc(std::size_t size) noexcept
+{
+    allocation_count++;
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size) noexcept
+{
+    allocation_count++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, std::size_t size) noexcept
+{
+    allocation_count++;
+    return __libc_realloc(ptr, size);
+}
+}
+#else
+// Only operator new where malloc can't be wrapped. The other forms of
+// operator new and delete forward to these two.
+void *operator new(std::size_t size)
+{
+    allocation_count++;
+
+    void *ptr = std::malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+#endif
+#endif
@@ -0,0 +1,13 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+// Heap allocations counted by alloc.cc. Build with `make ALLOC_COUNT=1` to
+// enable, since it replaces malloc for the whole program. The tests always
+// count.
+bool IsAllocationCountEnabled();
+
+// Number of heap allocations made so far by the calling thread, or 0 when
+// counting is disabled
+long GetAllocationCount();
+
+#endif
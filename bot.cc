@@ -0,0 +1,451 @@
+#include "bot.h"
+#include "piece.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Score of a position the bot tops out in
+static const double LOST_SCORE = -1e9;
+
+// More than a piece ever has, counting tucks and spins. The rest are dropped.
+static const int MAX_PLACEMENTS = 128;
+
+// Entries of the transposition table, as a power of 2
+static const int TABLE_SIZE_LOG2 = 14;
+
+// Values are stored in the table as the bits of a float
+static uint64_t pack_value(double value)
+{
+    const float narrow = value;
+    uint32_t bits;
+    memcpy(&bits, &narrow, sizeof(bits));
+    return bits;
+}
+
+static double unpack_value(uint64_t stored)
+{
+    const uint32_t bits = stored;
+    float narrow;
+    memcpy(&narrow, &bits, sizeof(narrow));
+    return narrow;
+}
+
+double EvaluateField(const Field &field, const BotWeights &weights)
+{
+    int height = 0;
+    int holes = 0;
+    int bumpiness = 0;
+
+    for (int x = 0; x < FIELD_WIDTH; x++) {
+        const int column_height = field.GetColumnHeight(x);
+        height += column_height;
+
+        for (int y = 0; y < column_height; y++) {
+            if (IsEmptyTile(field.GetTileKind(Point(x, y))))
+                holes++;
+        }
+
+        if (x > 0)
+            bumpiness += std::abs(column_height - field.GetColumnHeight(x - 1));
+    }
+
+    return weights.height * height + weights.holes * holes + weights.bumpiness * bumpiness;
+}
+
+bool PlaceBotMove(Tetris &tetris, const BotMove &move)
+{
+    if (move.use_hold)
+        tetris.UpdateFrame(HOLD_PIECE);
+
+    return tetris.PlacePiece(move.placement) && !tetris.IsGameOver();
+}
+
+bool PlayBotMove(Bot &bot, Tetris &tetris, int depth)
+{
+    tetris.UpdateFrame(0);
+    if (tetris.IsGameOver())
+        return false;
+
+    const BotMove move = bot.FindMove(tetris, depth);
+    if (move.input_count == 0)
+        return false;
+
+    return PlaceBotMove(tetris, move);
+}
+
+Bot::Bot()
+    : table_(new TranspositionTable(TABLE_SIZE_LOG2, REPLACE_ALWAYS))
+{
+}
+
+Bot::~Bot()
+{
+    if (!thread_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_quitting_ = true;
+    }
+    generation_++;
+    cond_.notify_one();
+    thread_.join();
+}
+
+void Bot::SetWeights(const BotWeights &weights)
+{
+    weights_ = weights;
+    table_->Clear();
+}
+
+void Bot::SetEvaluator(BoardEvaluator *evaluator)
+{
+    evaluator_ = evaluator;
+    table_->Clear();
+}
+
+void Bot::SetBudget(std::chrono::microseconds budget)
+{
+    budget_ = budget;
+}
+
+void Bot::StartSearch(const Tetris &tetris)
+{
+    // Bots that only search with FindMove never start a thread
+    if (!thread_.joinable())
+        thread_ = std::thread(&Bot::run, this);
+
+    Job job = make_job(tetris);
+    job.generation = ++generation_;
+    job.is_async = true;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = job;
+        has_job_ = true;
+    }
+    cond_.notify_one();
+
+    deadline_ = std::chrono::steady_clock::now() + budget_;
+}
+
+void Bot::StopSearch()
+{
+    generation_++;
+}
+
+bool Bot::IsDue() const
+{
+    return std::chrono::steady_clock::now() >= deadline_;
+}
+
+bool Bot::GetBestMove(BotMove &move, int *depth)
+{
+    results_.Fetch();
+    const Result &result = results_.GetFront();
+
+    if (result.generation != generation_.load() || !result.has_move)
+        return false;
+
+    move = result.move;
+    if (depth)
+        *depth = result.depth;
+    return true;
+}
+
+BotMove Bot::FindMove(const Tetris &tetris, int depth)
+{
+    if (!context_)
+        context_.reset(new Context());
+
+    Job job = make_job(tetris);
+    job.context = context_.get();
+    BotMove best;
+    best.score = LOST_SCORE;
+
+    search(job, job.field, job.kinds, job.kind_count, job.hold, job.can_hold,
+            std::min(depth, job.kind_count), &best);
+    return best;
+}
+
+int Bot::GetInput(const Tetris &tetris, const BotMove &move)
+{
+    const int kind = tetris.GetTetrominoKind();
+
+    if (kind != move.placement.kind) {
+        const bool can_hold = move.use_hold && tetris.IsHoldEnable() && tetris.IsHoldAvailable();
+        return can_hold ? HOLD_PIECE : 0;
+    }
+
+    if (!context_)
+        context_.reset(new Context());
+
+    MoveGenerator<SRS> &generator = context_->generators[0];
+    Tetromino current(kind, tetris.GetTetrominoPos());
+    current.rotation = tetris.GetTetrominoRotation();
+    generator.Generate(tetris.GetField(), current, context_->placements[0]);
+
+    int path[MAX_BOT_INPUTS];
+    const int count = generator.GetPath(move.placement, path, MAX_BOT_INPUTS);
+
+    for (int i = 0; i < count; i++) {
+        if (path[i] != MOV_DOWN)
+            return path[0];
+    }
+
+    return MOV_HARDDROP;
+}
+
+Bot::Job Bot::make_job(const Tetris &tetris) const
+{
+    Job job;
+    job.field = tetris.GetField();
+    job.kinds[job.kind_count++] = tetris.GetTetrominoKind();
+
+    // Only what a player can see
+    for (int i = 0; i < tetris.GetNextPieceCount(); i++) {
+        const int kind = tetris.GetNextPiece(i).kind;
+        if (kind == E)
+            break;
+        job.kinds[job.kind_count++] = kind;
+    }
+
+    job.hold = tetris.GetHoldPiece().kind;
+    job.can_hold = tetris.IsHoldEnable() && tetris.IsHoldAvailable();
+    return job;
+}
+
+bool Bot::is_stopped(const Job &job) const
+{
+    return job.is_async && generation_.load(std::memory_order_relaxed) != job.generation;
+}
+
+void Bot::publish(const Job &job, int depth, const BotMove &move)
+{
+    Result &result = results_.GetBack();
+    result.generation = job.generation;
+    result.depth = depth;
+    result.has_move = true;
+    result.move = move;
+    results_.Publish();
+}
+
+void Bot::run()
+{
+    TET_TRACE_THREAD("bot");
+
+#ifdef __linux__
+    // Searches only in time the game loop and the renderer leave idle
+    sched_param param = {};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+    thread_context_.reset(new Context());
+
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this]() { return has_job_ || is_quitting_; });
+            if (is_quitting_)
+                return;
+
+            job = job_;
+            has_job_ = false;
+        }
+        job.context = thread_context_.get();
+
+        // One piece deeper at a time, until every known piece is placed
+        for (int depth = 1; depth <= job.kind_count; depth++) {
+            TET_TRACE_SCOPE("Bot::search");
+
+            BotMove best;
+            best.score = LOST_SCORE;
+            search(job, job.field, job.kinds, job.kind_count, job.hold, job.can_hold,
+                    depth, &best);
+
+            if (is_stopped(job))
+                break;
+            publish(job, depth, best);
+        }
+    }
+}
+
+double Bot::search(const Job &job, const Field &field, const int *kinds, int kind_count,
+        int hold, bool can_hold, int depth, BotMove *best)
+{
+    // Below the first piece, boards reached in another order share a value.
+    // It depends on the pieces a search this deep can place, hold included.
+    uint64_t key = 0;
+
+    if (!best) {
+        int queue[MAX_DEPTH + 3];
+        int count = std::min(kind_count, depth + 1);
+        std::copy(kinds, kinds + count, queue);
+        queue[count++] = 16 + depth;
+        queue[count++] = 32 + can_hold;
+
+        key = field.GetHash() ^ HashQueue(queue, count, hold);
+        uint64_t stored = 0;
+
+        if (table_->Probe(key, depth, stored))
+            return unpack_value(stored);
+    }
+
+    double value = search_piece(job, field, kinds[0], kinds + 1, kind_count - 1,
+            hold, false, depth, best);
+
+    // Holding places the held piece, or the next one if none is held yet
+    if (can_hold && hold == E && kind_count >= 2) {
+        value = std::max(value, search_piece(job, field, kinds[1], kinds + 2, kind_count - 2,
+                    kinds[0], true, depth, best));
+    }
+    else if (can_hold && hold != E && hold != kinds[0]) {
+        value = std::max(value, search_piece(job, field, hold, kinds + 1, kind_count - 1,
+                    kinds[0], true, depth, best));
+    }
+
+    // Stopped searches undercount, so they are not kept
+    if (!best && !is_stopped(job))
+        table_->Store(key, depth, pack_value(value));
+
+    return value;
+}
+
+double Bot::search_piece(const Job &job, const Field &field, int kind, const int *kinds,
+        int kind_count, int hold, bool use_hold, int depth, BotMove *best)
+{
+    // Each depth has its own generator, which keeps the paths of its pieces
+    const int level = std::max(depth, 1) - 1;
+    MoveGenerator<SRS> &generator = job.context->generators[level];
+    std::vector<Tetromino> &placements = job.context->placements[level];
+
+    Tetromino start(kind, SPAWN_POS);
+    start.rotation = SRS::SPAWN_ROTATIONS[kind];
+    generator.Generate(field, start, placements);
+
+    double values[MAX_PLACEMENTS];
+    const int count = std::min<int>(placements.size(), MAX_PLACEMENTS);
+
+    // The last piece of a search scores its boards in one batch
+    const bool is_leaf = depth <= 1 || kind_count == 0;
+    if (is_leaf && evaluator_)
+        evaluate_leaves(field, placements.data(), count, values);
+
+    double best_value = LOST_SCORE;
+
+    for (int i = 0; i < count; i++) {
+        if (is_stopped(job))
+            return best_value;
+
+        const Tetromino &placement = placements[i];
+        double value;
+        if (is_leaf && evaluator_)
+            value = values[i];
+        else
+            value = search_placement(job, field, placement, kinds, kind_count, hold, depth);
+        best_value = std::max(best_value, value);
+
+        if (!best || value <= best->score)
+            continue;
+
+        // Room for a hold and the hard drop around the path
+        int path[MAX_BOT_INPUTS];
+        int path_count = generator.GetPath(placement, path, MAX_BOT_INPUTS - 2);
+        if (path_count < 0)
+            continue;
+
+        while (path_count > 0 && path[path_count - 1] == MOV_DOWN)
+            path_count--;
+
+        best->use_hold = use_hold;
+        best->placement = placement;
+        best->score = value;
+
+        best->input_count = 0;
+        if (use_hold)
+            best->inputs[best->input_count++] = HOLD_PIECE;
+        for (int j = 0; j < path_count; j++)
+            best->inputs[best->input_count++] = path[j];
+        best->inputs[best->input_count++] = MOV_HARDDROP;
+
+        // Until the first depth is done, every better move is the best so far
+        if (job.is_async && depth == 1)
+            publish(job, 0, *best);
+    }
+
+    return best_value;
+}
+
+void Bot::evaluate_leaves(const Field &field, const Tetromino *placements, int count,
+        double *values)
+{
+    Field fields[MAX_PLACEMENTS];
+    int indices[MAX_PLACEMENTS];
+    int line_counts[MAX_PLACEMENTS];
+    double scores[MAX_PLACEMENTS];
+    int leaf_count = 0;
+
+    for (int i = 0; i < count; i++) {
+        const Tetromino &tet = placements[i];
+        Piece piece = GetPiece(tet.kind, tet.rotation);
+        values[i] = LOST_SCORE;
+
+        bool is_inside = true;
+        for (auto &tile: piece.tiles) {
+            tile += tet.pos;
+            if (tile.y >= FIELD_HEIGHT)
+                is_inside = false;
+        }
+        if (!is_inside)
+            continue;
+
+        Field &next = fields[leaf_count];
+        next = field;
+        next.SetPiece(piece);
+
+        line_counts[leaf_count] = next.GetClearedLineCount();
+        if (line_counts[leaf_count] > 0)
+            next.ClearLines();
+
+        indices[leaf_count++] = i;
+    }
+
+    evaluator_->Evaluate(fields, leaf_count, scores);
+
+    for (int i = 0; i < leaf_count; i++)
+        values[indices[i]] = weights_.lines * line_counts[i] + scores[i];
+}
+
+double Bot::search_placement(const Job &job, const Field &field, const Tetromino &placement,
+        const int *kinds, int kind_count, int hold, int depth)
+{
+    Piece piece = GetPiece(placement.kind, placement.rotation);
+    for (auto &tile: piece.tiles) {
+        tile += placement.pos;
+        if (tile.y >= FIELD_HEIGHT)
+            return LOST_SCORE;
+    }
+
+    Field next = field;
+    next.SetPiece(piece);
+
+    const int line_count = next.GetClearedLineCount();
+    if (line_count > 0)
+        next.ClearLines();
+
+    double value = weights_.lines * line_count;
+    if (depth > 1 && kind_count > 0)
+        value += search(job, next, kinds, kind_count, hold, true, depth - 1, nullptr);
+    else
+        value += EvaluateField(next, weights_);
+
+    return value;
+}
@@ -0,0 +1,170 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include "tetris.h"
+#include "field.h"
+#include "tetromino.h"
+#include "movegen.h"
+#include "transposition.h"
+#include "triple_buffer.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// How much each board feature is worth to a bot
+struct BotWeights {
+    double height = -0.510066;      // Sum of the column heights
+    double lines = 0.760666;        // Each line cleared on the way
+    double holes = -0.35663;        // Empty cells under the top of their column
+    double bumpiness = -0.184483;   // Height differences of neighboring columns
+};
+
+double EvaluateField(const Field &field, const BotWeights &weights);
+
+// Scores boards for a Bot in place of EvaluateField, many per call. A Bot
+// calls it from its search thread and from FindMove, so one shared by
+// several searches must be safe to call concurrently.
+class BoardEvaluator {
+public:
+    virtual ~BoardEvaluator() {}
+    virtual void Evaluate(const Field *fields, int count, double *values) = 0;
+};
+
+const int MAX_BOT_INPUTS = 48;
+
+// A placement and the inputs that play it from spawn, one per frame: hold,
+// the path MoveGenerator found to it, which may tuck or spin, and a hard
+// drop in place of its last drops
+struct BotMove {
+    bool use_hold = false;
+    Tetromino placement;
+    double score = 0;
+
+    int inputs[MAX_BOT_INPUTS] = {0};
+    int input_count = 0;
+};
+
+// Searches the placements MoveGenerator finds for the current piece and
+// the preview one piece deeper at a time, keeping the values of the boards
+// below the first piece in a transposition table. The search runs on its
+// own thread, started by the first StartSearch: StartSearch hands it a
+// position and returns, and GetBestMove never waits for it, so a game loop
+// can ask for a move on every frame.
+class Bot {
+public:
+    Bot();
+    ~Bot();
+
+    void SetWeights(const BotWeights &weights);
+
+    // Scores the boards at the end of a search with evaluator instead of
+    // the weights, which still score cleared lines. Not owned, and null
+    // goes back to the weights. Set it before searching.
+    void SetEvaluator(BoardEvaluator *evaluator);
+
+    // Time a search has before its move is due, 2 ms by default
+    void SetBudget(std::chrono::microseconds budget);
+
+    // Searches the position of tetris until the next call or StopSearch
+    void StartSearch(const Tetris &tetris);
+    void StopSearch();
+
+    // Whether the budget of the latest search has run out
+    bool IsDue() const;
+
+    // The best move found so far in the latest search, and how many pieces
+    // deep its search finished, 0 while the first one is still running.
+    // False until a first placement is scored.
+    bool GetBestMove(BotMove &move, int *depth = nullptr);
+
+    // Searches depth pieces on the calling thread, without a time limit
+    BotMove FindMove(const Tetris &tetris, int depth);
+
+    // The input that takes the current piece of tetris a frame closer to
+    // move, planned again from wherever gravity has taken it: hold if the
+    // move does, the next step of a path, and a hard drop once only drops
+    // are left or the placement is out of reach. 0 while the piece the move
+    // places isn't out yet. Call it on the thread that calls FindMove.
+    int GetInput(const Tetris &tetris, const BotMove &move);
+
+private:
+    enum { MAX_DEPTH = 7 };
+
+    // Move generation for each depth of a search, so the paths of the first
+    // piece outlive the searches below it. One for the search thread and
+    // one for FindMove, made on first use.
+    struct Context {
+        MoveGenerator<SRS> generators[MAX_DEPTH];
+        std::vector<Tetromino> placements[MAX_DEPTH];
+    };
+
+    struct Job {
+        Field field;
+        int kinds[MAX_DEPTH] = {0};
+        int kind_count = 0;
+        int hold = E;
+        bool can_hold = false;
+        uint32_t generation = 0;
+        bool is_async = false;
+        Context *context = nullptr;
+    };
+
+    struct Result {
+        uint32_t generation = 0;
+        int depth = 0;
+        bool has_move = false;
+        BotMove move;
+    };
+
+    BotWeights weights_;
+    BoardEvaluator *evaluator_ = nullptr;
+    std::chrono::microseconds budget_ {2000};
+    std::chrono::steady_clock::time_point deadline_;
+
+    std::unique_ptr<Context> context_;
+    std::unique_ptr<Context> thread_context_;
+    std::unique_ptr<TranspositionTable> table_;
+
+    // Game loop to search thread
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    Job job_;
+    bool has_job_ = false;
+    bool is_quitting_ = false;
+    std::atomic<uint32_t> generation_ {0};
+
+    // Search thread to game loop
+    TripleBuffer<Result> results_;
+
+    std::thread thread_;
+
+    void run();
+    Job make_job(const Tetris &tetris) const;
+    bool is_stopped(const Job &job) const;
+    void publish(const Job &job, int depth, const BotMove &move);
+    double search(const Job &job, const Field &field, const int *kinds, int kind_count,
+            int hold, bool can_hold, int depth, BotMove *best);
+    double search_piece(const Job &job, const Field &field, int kind, const int *kinds,
+            int kind_count, int hold, bool use_hold, int depth, BotMove *best);
+    double search_placement(const Job &job, const Field &field, const Tetromino &placement,
+            const int *kinds, int kind_count, int hold, int depth);
+    void evaluate_leaves(const Field &field, const Tetromino *placements, int count,
+            double *values);
+};
+
+// Plays move on tetris at once, holding first if it does, with
+// Tetris::PlacePiece. For headless games, where gravity has no time to act.
+// False if the placement doesn't fit or the game is over.
+bool PlaceBotMove(Tetris &tetris, const BotMove &move);
+
+// Spawns the next piece of tetris, clearing the lines of the last one, and
+// places the move bot finds for it depth pieces deep with PlaceBotMove.
+// False once the game is over or every placement locks above the field.
+bool PlayBotMove(Bot &bot, Tetris &tetris, int depth);
+
+#endif
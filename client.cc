@@ -0,0 +1,257 @@
+#include "client.h"
+#include "net.h"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstring>
+
+static const int KEY_INTERVAL_MILLISEC = 100;
+
+// Time for the last frames to arrive before spectators are checked
+static const int SETTLE_MILLISEC = 300;
+
+ClientPool::ClientPool()
+    : rng_(1)
+{
+    epoll_fd_ = epoll_create1(0);
+}
+
+ClientPool::~ClientPool()
+{
+    for (auto &client: clients_)
+        close(client->fd);
+
+    if (epoll_fd_ >= 0)
+        close(epoll_fd_);
+}
+
+bool ClientPool::add_client(int fd, bool is_spectator)
+{
+    if (fd < 0)
+        return false;
+
+    std::unique_ptr<Client> client(new Client);
+    client->fd = fd;
+    client->is_spectator = is_spectator;
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = client.get();
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+
+    clients_.push_back(std::move(client));
+
+    if (!is_spectator) {
+        player_count_++;
+        const char play = 'P';
+        return send(fd, &play, 1, MSG_NOSIGNAL) == 1;
+    }
+
+    return true;
+}
+
+bool ClientPool::ConnectUnix(const char *path, int count)
+{
+    path_ = path;
+
+    for (int i = 0; i < count; i++)
+        if (!add_client(::ConnectUnix(path), false))
+            return false;
+
+    return true;
+}
+
+bool ClientPool::ConnectTcp(int port, int count)
+{
+    port_ = port;
+
+    for (int i = 0; i < count; i++)
+        if (!add_client(::ConnectTcp(port), false))
+            return false;
+
+    return true;
+}
+
+void ClientPool::SetSpectatorCount(int count)
+{
+    spectator_count_ = count;
+}
+
+bool ClientPool::connect_spectators()
+{
+    for (int i = 0; i < spectator_count_; i++) {
+        const uint32_t game_id = clients_[i % player_count_]->frame.game_id;
+        const int fd = port_ ? ::ConnectTcp(port_) : ::ConnectUnix(path_.c_str());
+
+        if (!add_client(fd, true))
+            return false;
+
+        uint8_t watch[5] = {'W'};
+        for (int j = 0; j < 4; j++)
+            watch[1 + j] = (game_id >> (8 * j)) & 0xFF;
+
+        if (send(fd, watch, sizeof(watch), MSG_NOSIGNAL) != sizeof(watch))
+            return false;
+    }
+
+    return true;
+}
+
+void ClientPool::Run(double seconds)
+{
+    using Clock = std::chrono::steady_clock;
+
+    const auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(seconds));
+    auto next_keys = Clock::now();
+    bool has_spectators = spectator_count_ == 0 || player_count_ == 0;
+
+    epoll_event events[256];
+
+    while (Clock::now() < end) {
+        const int count = epoll_wait(epoll_fd_, events, 256, 10);
+
+        for (int i = 0; i < count; i++)
+            receive(*static_cast<Client *>(events[i].data.ptr));
+
+        // Spectators need the game ids from the players' hellos
+        if (!has_spectators) {
+            bool has_ids = true;
+            for (int i = 0; i < player_count_; i++)
+                has_ids = has_ids && clients_[i]->frame.game_id != 0;
+
+            if (has_ids) {
+                if (!connect_spectators())
+                    fprintf(stderr, "error: can't connect spectators\n");
+                has_spectators = true;
+            }
+        }
+
+        if (Clock::now() >= next_keys) {
+            press_keys();
+            next_keys += std::chrono::milliseconds(KEY_INTERVAL_MILLISEC);
+        }
+    }
+
+    // Pause every game so spectators can be compared with their players
+    for (auto &client: clients_) {
+        const char key = 'p';
+
+        if (!client->is_spectator && !(client->frame.flags & (FRAME_PAUSED | FRAME_GAME_OVER)))
+            send(client->fd, &key, 1, MSG_NOSIGNAL);
+    }
+
+    drain(SETTLE_MILLISEC);
+
+    for (auto &client: clients_) {
+        if (!client->is_spectator)
+            continue;
+
+        const int index = &client - &clients_[player_count_];
+        const Frame &frame = clients_[index % player_count_]->frame;
+
+        if (!client->has_key_frame || HasFrameChanged(client->frame, frame))
+            mismatches_++;
+    }
+}
+
+void ClientPool::drain(int millisec)
+{
+    using Clock = std::chrono::steady_clock;
+
+    const auto end = Clock::now() + std::chrono::milliseconds(millisec);
+    epoll_event events[256];
+
+    while (Clock::now() < end) {
+        const int count = epoll_wait(epoll_fd_, events, 256, 10);
+
+        for (int i = 0; i < count; i++)
+            receive(*static_cast<Client *>(events[i].data.ptr));
+    }
+}
+
+long ClientPool::GetDecodeErrorCount() const
+{
+    return decode_errors_;
+}
+
+long ClientPool::GetMismatchCount() const
+{
+    return mismatches_;
+}
+
+void ClientPool::PrintStats(FILE *fp) const
+{
+    fprintf(fp, "players: %d, spectators: %d, frames received: %ld, bytes received: %ld, "
+            "keys sent: %ld, decode errors: %ld, spectator mismatches: %ld\n",
+            player_count_, (int) clients_.size() - player_count_,
+            frames_received_, bytes_received_, keys_sent_, decode_errors_, mismatches_);
+}
+
+void ClientPool::receive(Client &client)
+{
+    for (;;) {
+        const int room = sizeof(client.in) - client.in_size;
+        const ssize_t size = recv(client.fd, client.in + client.in_size, room, 0);
+
+        if (size <= 0)
+            return;
+
+        client.in_size += size;
+        bytes_received_ += size;
+
+        // Apply every complete message
+        int offset = 0;
+        for (;;) {
+            const uint8_t *data = client.in + offset;
+            const int remaining = client.in_size - offset;
+
+            // The first frame must be a key frame
+            if (!client.has_key_frame && remaining > 2 &&
+                    data[2] != FRAME_KEY && data[2] != FRAME_HELLO) {
+                decode_errors_++;
+                client.in_size = 0;
+                return;
+            }
+
+            const int used = DecodeFrame(data, remaining, client.frame);
+
+            if (used < 0) {
+                decode_errors_++;
+                client.in_size = 0;
+                return;
+            }
+            if (used == 0)
+                break;
+
+            if (data[2] == FRAME_KEY)
+                client.has_key_frame = true;
+            if (data[2] != FRAME_HELLO)
+                frames_received_++;
+            offset += used;
+        }
+
+        memmove(client.in, client.in + offset, client.in_size - offset);
+        client.in_size -= offset;
+    }
+}
+
+void ClientPool::press_keys()
+{
+    static const char keys[] = "hlhljzxc ";
+
+    for (auto &client: clients_) {
+        if (client->is_spectator)
+            continue;
+
+        char key = keys[rng_() % (sizeof(keys) - 1)];
+
+        if (client->frame.flags & FRAME_GAME_OVER)
+            key = 'r';
+
+        if (send(client->fd, &key, 1, MSG_NOSIGNAL) == 1)
+            keys_sent_++;
+    }
+}
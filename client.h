@@ -0,0 +1,61 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include "frame.h"
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+// Local stand-in for remote players. Drives many server connections from
+// one thread, pressing random keys and decoding the frames that come back.
+// Spectators watch the players' games and are checked against them at the end.
+class ClientPool {
+public:
+    ClientPool();
+    ~ClientPool();
+
+    bool ConnectUnix(const char *path, int count);
+    bool ConnectTcp(int port, int count);
+    void SetSpectatorCount(int count);
+    void Run(double seconds);
+
+    long GetDecodeErrorCount() const;
+    long GetMismatchCount() const;
+    void PrintStats(FILE *fp) const;
+
+private:
+    struct Client {
+        int fd = -1;
+        bool is_spectator = false;
+        bool has_key_frame = false;
+        Frame frame;
+        uint8_t in[4 * MAX_FRAME_MESSAGE_SIZE];
+        int in_size = 0;
+    };
+
+    std::vector<std::unique_ptr<Client>> clients_;
+    std::minstd_rand rng_;
+    int epoll_fd_ = -1;
+
+    // Where spectators connect to
+    std::string path_;
+    int port_ = 0;
+    int player_count_ = 0;
+    int spectator_count_ = 0;
+
+    long frames_received_ = 0;
+    long bytes_received_ = 0;
+    long keys_sent_ = 0;
+    long decode_errors_ = 0;
+    long mismatches_ = 0;
+
+    bool add_client(int fd, bool is_spectator);
+    bool connect_spectators();
+    void receive(Client &client);
+    void press_keys();
+    void drain(int millisec);
+};
+
+#endif
@@ -1,7 +1,13 @@
 #include "display.h"
+#include "alloc.h"
+#include "trace.h"
 
 #include <locale.h>
 #include <ncurses.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstdarg>
 #include <cstdio>
 #include <algorithm>
 #include <iostream>
@@ -15,6 +21,11 @@ static const int DEFAULT_FG_COLOR = 10;
 static const int DEFAULT_BG_COLOR = 11;
 static const int DEFAULT_COLOR_PAIR = 10;
 static const int CLEARING_DURATION = 20;
+static const int64_t FRAME_BUDGET_NANOSEC = 1000000000LL / 60;
+
+static const char *phase_names[PHASE_COUNT] = {
+    "Input", "Update", "Render", "Refresh",
+};
 
 Display::Display(Tetris &tetris)
     : tetris_(tetris)
@@ -32,43 +43,213 @@ int Display::Open()
     if (initialize_screen())
         return 1;
 
-    // Timer
-    auto start = std::chrono::steady_clock::now();
+    // Lets the simulation wake up the renderer when a view is published
+    if (pipe(wake_pipe_)) {
+        finalize_screen();
+        return 1;
+    }
+    for (auto fd: wake_pipe_)
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
 
+    is_debug_mode_ = tetris_.IsDebugMode();
     tetris_.PlayGame();
 
+    // The game runs on its own thread at a fixed rate. This thread only
+    // reads keys and draws whatever view was published last.
+    std::thread simulation(&Display::run_simulation, this);
+    run_renderer();
+    simulation.join();
+
+    // Clean up
+    close(wake_pipe_[0]);
+    close(wake_pipe_[1]);
+    finalize_screen();
+
+    return 0;
+}
+
+void Display::run_simulation()
+{
+    TET_TRACE_THREAD("simulation");
+
+    using Clock = std::chrono::steady_clock;
+    const Clock::duration period =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1./60));
+
+    auto deadline = Clock::now();
+
     while (tetris_.IsPlaying()) {
+        int key = ERR;
+        keys_.Pop(key);
+        tick(key);
+
+        // Nothing is animating. Sleep until a key arrives and restart the clock.
+        if (is_idle()) {
+            wait_for_key();
+            deadline = Clock::now();
+            continue;
+        }
+
+        // Absolute deadlines so a late frame doesn't shift the ones after it
+        deadline += period;
+        std::this_thread::sleep_until(deadline);
+    }
+
+    // Let the renderer know the game has quit
+    publish_view();
+}
+
+void Display::tick(int key)
+{
+    // Input
+    const int move = key != ERR ? input_key(key) : 0;
+
+    // Game logic
+    is_bot_input_ = false;
+    if (clearing_timer_ == -1) {
+        PhaseTimer timer;
+        const int bot_input = get_bot_input();
+        is_bot_input_ = bot_input != 0;
+        tetris_.UpdateFrame(is_bot_input_ ? bot_input : move);
+        timings_[PHASE_UPDATE].Add(timer.Lap());
+    }
+
+    // Effects
+    update_effect();
+    update_game_over();
+    handle_events();
+    update_message();
+
+    publish_view();
+    frame_++;
+}
+
+void Display::run_renderer()
+{
+    TET_TRACE_THREAD("render");
+
+    auto start = std::chrono::steady_clock::now();
+    unsigned long render_count = 0;
+
+    for (;;) {
+        // Block until a key is pressed or a new view is published
+        struct pollfd fds[2] = {
+            {STDIN_FILENO, POLLIN, 0},
+            {wake_pipe_[0], POLLIN, 0},
+        };
+        poll(fds, 2, -1);
+
+        if (fds[1].revents & POLLIN) {
+            char buf[64];
+            while (read(wake_pipe_[0], buf, sizeof(buf)) > 0)
+                ;
+        }
+
+        PhaseTimer timer;
 
         // Input
-        const int move = input_key();
+        int key;
+        bool has_key = false;
+        bool is_trace_requested = false;
+        while ((key = getch()) != ERR) {
+            // Exported here, so a large trace doesn't hold up the game
+            if (key == 't') {
+                is_trace_requested = true;
+                continue;
+            }
+            has_key |= keys_.Push(key);
+        }
+
+        if (has_key) {
+            // Lock so the notification can't slip in before the wait
+            std::lock_guard<std::mutex> lock(key_mutex_);
+            key_cond_.notify_one();
+        }
 
-        // Game logic
-        if (clearing_timer_ == -1)
-            tetris_.UpdateFrame(move);
+        timings_[PHASE_INPUT].Add(timer.Lap());
 
-        // Rednering
-        render();
+        if (is_trace_requested && trace_file_) {
+            ExportTrace(trace_file_);
+            timer.Lap();
+        }
 
-        // Measure frame cost
-        const std::chrono::duration<double> dur = std::chrono::steady_clock::now() - start;
-        const double elapsed_sec = dur.count();
-        const long remaining_millisec = 1000 * (1./60 - elapsed_sec);
+        // Rendering
+        if (!views_.Fetch())
+            continue;
 
-        // Wait
-        std::this_thread::sleep_for(std::chrono::milliseconds(remaining_millisec));
+        const ViewState &view = views_.GetFront();
+        if (!view.is_playing)
+            break;
 
-        // Restart timer
-        start = std::chrono::steady_clock::now();
-        frame_++;
+        render(view);
+        timings_[PHASE_RENDER].Add(timer.Lap());
 
-        if (frame_ % 10 == 0)
-            fps_ = 1. / elapsed_sec;
+        {
+            TET_TRACE_SCOPE("refresh");
+            refresh();
+        }
+        timings_[PHASE_REFRESH].Add(timer.Lap());
+        render_count++;
+
+        // Measure frame rate
+        if (render_count % 10 == 0) {
+            const auto now = std::chrono::steady_clock::now();
+            const std::chrono::duration<double> dur = now - start;
+            fps_ = 10. / dur.count();
+            start = now;
+        }
     }
+}
 
-    // Clean up
-    finalize_screen();
+void Display::SetTraceFile(const char *filename)
+{
+    trace_file_ = filename;
+}
 
-    return 0;
+void Display::SetBot(Bot *bot)
+{
+    bot_ = bot;
+}
+
+void Display::SetHintEnable(bool enable)
+{
+    // Kept once made: destroying it joins its idle-priority thread, which
+    // could stall the tick
+    if (!enable) {
+        if (hint_bot_)
+            hint_bot_->StopSearch();
+        is_hint_enable_ = false;
+        return;
+    }
+
+    if (!hint_bot_)
+        hint_bot_.reset(new Bot());
+
+    if (!is_hint_enable_ && tetris_.IsPlaying() && !tetris_.IsGameOver())
+        hint_bot_->StartSearch(tetris_);
+    is_hint_enable_ = true;
+}
+
+void Display::SaveFrameStats(const char *filename) const
+{
+    FILE *fp = fopen(filename, "w");
+
+    if (!fp) {
+        fprintf(stderr, "can't open file: %s\n", filename);
+        return;
+    }
+
+    fprintf(fp, "frame budget: %lld ns\n", (long long) FRAME_BUDGET_NANOSEC);
+
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        const Histogram &timing = timings_[i];
+
+        fprintf(fp, "\n[%s] over budget: %lld\n", phase_names[i],
+                (long long) timing.GetCountAbove(FRAME_BUDGET_NANOSEC));
+        timing.Print(fp);
+    }
+
+    fclose(fp);
 }
 
 static void assign_color(int pair_id, int r, int g, int b)
@@ -97,6 +278,7 @@ static void initialize_colors()
     assign_color(J, 100, 300, 1000);
     assign_color(L, 1000, 500, 0);
     assign_color(T, 1000, 0, 500);
+    assign_color(G, 500, 500, 500);
     assign_color(DEFAULT_COLOR_PAIR, 800, 800, 800);
 }
 
@@ -109,7 +291,7 @@ static const char *get_tile_symbol(int kind)
             s = ".";
             break;
 
-        case I: case O: case S: case Z: case J: case L: case T:
+        case I: case O: case S: case Z: case J: case L: case T: case G:
             s = "\u25A3"; // solid square
             break;
 
@@ -142,35 +324,326 @@ int Display::initialize_screen()
     return 0;
 }
 
+int Display::Benchmark(int frame_count)
+{
+    static const int WARMUP_FRAME_COUNT = 120;
+    static const int keys[] = {
+        KEY_LEFT, 'z', KEY_DOWN, KEY_RIGHT, KEY_RIGHT, 'x', ' ', 'c',
+        KEY_RIGHT, 'x', KEY_LEFT, KEY_LEFT, KEY_LEFT, ' ', 'z', ' ',
+    };
+
+    // Render into a terminal that discards its output
+    FILE *out = fopen("/dev/null", "w");
+    SCREEN *screen = out ? newterm(getenv("TERM") ? nullptr : "xterm", out, stdin) : nullptr;
+
+    if (!screen) {
+        fprintf(stderr, "error: can't open terminal for benchmark\n");
+        return 1;
+    }
+    initialize_colors();
+
+    is_debug_mode_ = tetris_.IsDebugMode();
+    tetris_.PlayGame();
+
+    Histogram frame_times;
+    long allocated_frame_count = 0;
+    long allocation_count = 0;
+
+    for (int frame = 0; frame < frame_count; frame++) {
+        int key = frame % 4 == 0 ? keys[(frame / 4) % 16] : ERR;
+
+        if (tetris_.IsGameOver() && game_over_counter_ == 0)
+            key = 'r';
+
+        const long old_count = GetAllocationCount();
+        PhaseTimer timer;
+
+        tick(key);
+        views_.Fetch();
+        render(views_.GetFront());
+        refresh();
+
+        frame_times.Add(timer.Lap());
+
+        const long count = GetAllocationCount() - old_count;
+        if (frame >= WARMUP_FRAME_COUNT && count > 0) {
+            allocated_frame_count++;
+            allocation_count += count;
+        }
+    }
+
+    endwin();
+    delscreen(screen);
+    fclose(out);
+
+    printf("frames: %d (warm-up: %d)\n", frame_count, WARMUP_FRAME_COUNT);
+    printf("frame time p50: %lld ns, p99: %lld ns, max: %lld ns\n",
+            (long long) frame_times.GetPercentile(50),
+            (long long) frame_times.GetPercentile(99),
+            (long long) frame_times.GetMax());
+    if (!IsAllocationCountEnabled()) {
+        printf("allocations: not counted, build with ALLOC_COUNT=1\n");
+        return 0;
+    }
+    printf("allocating frames: %ld, allocations: %ld\n",
+            allocated_frame_count, allocation_count);
+
+    return allocated_frame_count > 0 ? 1 : 0;
+}
+
 void Display::finalize_screen()
 {
     endwin();
 }
 
-void Display::render()
+bool Display::is_idle() const
 {
-    erase();
+    if (clearing_timer_ != -1 || !message_queue_.IsEmpty())
+        return false;
 
-    draw_borders();
-    draw_field();
+    if (tetris_.IsPaused())
+        return true;
 
-    draw_ghost();
-    draw_tetromino();
+    if (tetris_.IsGameOver() && game_over_counter_ == 0)
+        return true;
 
-    draw_effect();
+    return false;
+}
 
-    draw_info();
-    draw_message();
-    draw_debug();
+int Display::get_bot_input()
+{
+    if (!bot_ || tetris_.IsPaused() || tetris_.IsGameOver())
+        return 0;
 
-    draw_game_over();
-    draw_pause();
+    // Until the next move is due, the piece falls as usual
+    if (!is_bot_moving_) {
+        if (!bot_->IsDue() || !bot_->GetBestMove(bot_move_))
+            return 0;
 
-    refresh();
+        bot_->StopSearch();
+        is_bot_moving_ = true;
+    }
+
+    // Steered every tick, so gravity can't throw the move off
+    const int input = bot_->GetInput(tetris_, bot_move_);
+    if (input == MOV_HARDDROP)
+        is_bot_moving_ = false;
+
+    return input;
+}
+
+void Display::wait_for_key()
+{
+    std::unique_lock<std::mutex> lock(key_mutex_);
+    key_cond_.wait(lock, [this]() { return !keys_.IsEmpty(); });
 }
 
-void Display::draw_borders() const
+void Display::update_effect()
 {
+    if (clearing_timer_ >= 0)
+        clearing_timer_--;
+}
+
+void Display::handle_events()
+{
+    GameEvent event;
+    bool has_held = false;
+
+    while (tetris_.PollEvent(event)) {
+        switch (event.kind) {
+        case EVENT_SPAWN:
+            // Pieces that spawn while a move is played, after a hold, are
+            // part of that move. Any other spawn ends it, in case the piece
+            // locked before its hard drop.
+            if (is_bot_moving_ && !(bot_move_.use_hold &&
+                    tetris_.GetTetrominoKind() == bot_move_.placement.kind))
+                is_bot_moving_ = false;
+            if (bot_ && !is_bot_moving_)
+                bot_->StartSearch(tetris_);
+            if (is_hint_enable_)
+                hint_bot_->StartSearch(tetris_);
+            is_hint_stale_ = false;
+            break;
+
+        case EVENT_HOLD:
+            // Holding into an empty slot spawns the next piece a tick later
+            if (is_hint_enable_)
+                hint_bot_->StopSearch();
+            is_hint_stale_ = true;
+            has_held = true;
+            break;
+
+        case EVENT_CLEAR:
+            clear_event_ = event;
+            clearing_timer_ = CLEARING_DURATION;
+            break;
+
+        case EVENT_TSPIN:
+            // Clears are announced when their effect ends
+            if (event.line_count == 0)
+                push_clear_messages(event);
+            break;
+
+        case EVENT_GAME_OVER:
+            game_over_counter_ = 60;
+            is_bot_moving_ = false;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // A swap with the held piece spawns nothing, so search the swapped one
+    if (is_hint_stale_ && !has_held) {
+        if (is_hint_enable_ && !tetris_.IsGameOver())
+            hint_bot_->StartSearch(tetris_);
+        is_hint_stale_ = false;
+    }
+}
+
+void Display::update_message()
+{
+    if (clearing_timer_ == 0)
+        push_clear_messages(clear_event_);
+
+    // Messages are queued in frame order, so expired ones are at the front
+    while (!message_queue_.IsEmpty() && frame_ - message_queue_.Front().start > 60)
+        message_queue_.PopFront();
+}
+
+void Display::push_clear_messages(const GameEvent &event)
+{
+    if (event.is_perfect_clear)
+        push_message("PERFECT CLEAR");
+
+    if (event.tspin == TSPIN_NORMAL)
+        push_message("T-SPIN");
+    else if (event.tspin == TSPIN_MINI)
+        push_message("T-SPIN MINI");
+
+    switch (event.line_count) {
+    case 1: push_message("SINGLE"); break;
+    case 2: push_message("DOUBLE"); break;
+    case 3: push_message("TRIPLE"); break;
+    case 4: push_message("TETRIS"); break;
+    default: break;
+    }
+
+    push_message("%+5d", event.clear_points);
+
+    if (event.line_count == 0)
+        return;
+
+    if (event.combo_counter > 0) {
+        push_message("%d COMBO", event.combo_counter);
+        push_message("%+5d", event.combo_points);
+    }
+
+    if (event.back_to_back > 0)
+        push_message("%d BACK TO BACK", event.back_to_back);
+}
+
+void Display::push_message(const char *fmt, ...)
+{
+    Message &msg = message_queue_.PushBack();
+    va_list va;
+
+    va_start(va, fmt);
+    vsnprintf(msg.str, sizeof(msg.str), fmt, va);
+    va_end(va);
+
+    msg.start = frame_;
+}
+
+void Display::update_game_over()
+{
+    if (game_over_counter_ > 0)
+        game_over_counter_--;
+}
+
+void Display::publish_view()
+{
+    ViewState &view = views_.GetBack();
+
+    for (int y = -1; y < FIELD_HEIGHT + 1; y++)
+        for (int x = -1; x < FIELD_WIDTH + 1; x++)
+            view.tiles[y + 1][x + 1] = tetris_.GetFieldTileKind(Point(x, y));
+
+    view.current = tetris_.GetCurrentPiece();
+    view.ghost = tetris_.GetGhostPiece();
+
+    // Whatever the hint search has found so far, without waiting for it
+    BotMove hint;
+    view.hint = Piece();
+    if (is_hint_enable_ && hint_bot_->GetBestMove(hint)) {
+        view.hint = GetPiece(hint.placement.kind, hint.placement.rotation);
+        for (auto &tile: view.hint.tiles)
+            tile += hint.placement.pos;
+    }
+    view.hold = tetris_.GetHoldPiece();
+    for (int i = 0; i < (int) view.next.size(); i++)
+        view.next[i] = tetris_.GetNextPiece(i);
+    for (int i = 0; i < (int) view.kind_list.size(); i++)
+        view.kind_list[i] = tetris_.GetPieceKindList(i);
+
+    view.is_playing = tetris_.IsPlaying();
+    view.is_paused = tetris_.IsPaused();
+    view.is_game_over = tetris_.IsGameOver();
+    view.is_hold_enable = tetris_.IsHoldEnable();
+    view.is_hold_available = tetris_.IsHoldAvailable();
+
+    view.score = tetris_.GetScore();
+    view.lines = tetris_.GetTotalLineCount();
+    view.level = tetris_.GetLevel();
+    view.combo_counter = tetris_.GetComboCounter();
+    view.lock_delay_timer = tetris_.GetLockDelayTimer();
+    view.reset_counter = tetris_.GetResetCounter();
+    view.gravity = (float) tetris_.GetGravity() / GRAVITY_UNIT;
+
+    view.cleared_line_count = clear_event_.line_count;
+    std::copy(clear_event_.cleared_lines, clear_event_.cleared_lines + 4, view.cleared_lines);
+    view.clearing_timer = clearing_timer_;
+    view.game_over_counter = game_over_counter_;
+    view.messages = message_queue_;
+
+    views_.Publish();
+
+    // A full pipe already means the renderer has a wake-up pending
+    if (wake_pipe_[1] >= 0) {
+        const char wake = 0;
+        const ssize_t written = write(wake_pipe_[1], &wake, 1);
+        (void) written;
+    }
+}
+
+void Display::render(const ViewState &view)
+{
+    TET_TRACE_SCOPE("Display::render");
+
+    erase();
+
+    draw_borders(view);
+    draw_field(view);
+
+    draw_ghost(view);
+    draw_hint(view);
+    draw_tetromino(view);
+
+    draw_effect(view);
+
+    draw_info(view);
+    draw_message(view);
+    draw_debug(view);
+
+    draw_game_over(view);
+    draw_pause(view);
+}
+
+void Display::draw_borders(const ViewState &view) const
+{
+    TET_TRACE_SCOPE("Display::draw_borders");
+
     for (int y = 0; y < FIELD_HEIGHT; y++) {
         // Side borders
         draw_tile(-1, y, B);
@@ -180,33 +653,37 @@ void Display::draw_borders() const
         {
             // Bottom border
             const int y = -1;
-            const int kind = tetris_.GetFieldTileKind(Point(x, y));
+            const int kind = view.GetTileKind(x, y);
             draw_tile(x, y, kind);
         }
         {
             // Top border
             const int y = FIELD_HEIGHT;
-            const int kind = tetris_.GetFieldTileKind(Point(x, y));
+            const int kind = view.GetTileKind(x, y);
             draw_tile(x, y, kind);
         }
     }
 }
 
-void Display::draw_field() const
+void Display::draw_field(const ViewState &view) const
 {
+    TET_TRACE_SCOPE("Display::draw_field");
+
     // Stack
     for (int y = 0; y < FIELD_HEIGHT; y++) {
         for (int x = 0; x < FIELD_WIDTH; x++) {
-            const int kind = tetris_.GetFieldTileKind(Point(x, y));
+            const int kind = view.GetTileKind(x, y);
             draw_tile(x, y, kind);
         }
     }
 }
 
-void Display::draw_ghost() const
+void Display::draw_ghost(const ViewState &view) const
 {
+    TET_TRACE_SCOPE("Display::draw_ghost");
+
     const bool IS_HOLLOW = true;
-    const Piece piece = tetris_.GetGhostPiece();
+    const Piece &piece = view.ghost;
 
     if (IsEmptyTile(piece.kind))
         return;
@@ -216,15 +693,35 @@ void Display::draw_ghost() const
     }
 }
 
-void Display::draw_tetromino() const
+void Display::draw_hint(const ViewState &view) const
 {
-    if (clearing_timer_ >=0)
+    TET_TRACE_SCOPE("Display::draw_hint");
+
+    const Piece &piece = view.hint;
+
+    if (IsEmptyTile(piece.kind) || view.clearing_timer >= 0)
         return;
 
-    if (tetris_.IsGameOver() || tetris_.IsPaused())
+    if (view.is_game_over || view.is_paused)
         return;
 
-    const Piece piece = tetris_.GetCurrentPiece();
+    attrset(COLOR_PAIR(piece.kind));
+    for (auto pos: piece.tiles)
+        draw_str(pos.x, pos.y, "\u25A2"); // rounded hollow square
+    attrset(0);
+}
+
+void Display::draw_tetromino(const ViewState &view) const
+{
+    TET_TRACE_SCOPE("Display::draw_tetromino");
+
+    if (view.clearing_timer >=0)
+        return;
+
+    if (view.is_game_over || view.is_paused)
+        return;
+
+    const Piece &piece = view.current;
 
     if (IsEmptyTile(piece.kind))
         return;
@@ -234,28 +731,24 @@ void Display::draw_tetromino() const
     }
 }
 
-void Display::draw_effect()
+void Display::draw_effect(const ViewState &view) const
 {
+    TET_TRACE_SCOPE("Display::draw_effect");
+
     const int duration = CLEARING_DURATION;
-    const int clear_count = tetris_.GetClearedLineCount();
+    const int clear_count = view.cleared_line_count;
+    const int clearing_timer = view.clearing_timer;
 
-    if (clear_count > 0 && clearing_timer_ == -1)
-        clearing_timer_ = duration;
-    else if (clearing_timer_ >= 0)
-        clearing_timer_--;
-    else
+    if (clearing_timer < 0)
         return;
 
-    int cleared_lines[4] = {0};
-    tetris_.GetClearedLines(cleared_lines);
-
     const int frame_per_tile = duration / 5;
-    const int erase = clearing_timer_ / frame_per_tile;
-    const bool is_flashing = (clear_count == 4) && (clearing_timer_ % 2 == 0);
+    const int erase = clearing_timer / frame_per_tile;
+    const bool is_flashing = (clear_count == 4) && (clearing_timer % 2 == 0);
 
     // Clear animation
     for (int i = 0; i < clear_count; i++) {
-        const int cleared_y = cleared_lines[i];
+        const int cleared_y = view.cleared_lines[i];
 
         for (int x = erase; x < 10 - erase; x++) {
             draw_blank(x, cleared_y, is_flashing);
@@ -266,7 +759,7 @@ void Display::draw_effect()
     if (is_flashing) {
         for (int y = 0; y < FIELD_HEIGHT; y++) {
             for (int x = 0; x < FIELD_WIDTH; x++) {
-                const int kind = tetris_.GetFieldTileKind(Point(x, y));
+                const int kind = view.GetTileKind(x, y);
                 if (IsEmptyTile(kind))
                     draw_blank(x, y, is_flashing);
             }
@@ -274,21 +767,23 @@ void Display::draw_effect()
     }
 }
 
-void Display::draw_info() const
+void Display::draw_info(const ViewState &view) const
 {
+    TET_TRACE_SCOPE("Display::draw_info");
+
     {
         int x = 19, y = 20;
 
         draw_str(x, y--, "SCORE");
-        draw_text(x, y--, "%5d", tetris_.GetScore());
+        draw_text(x, y--, "%5d", view.score);
 
         y--;
         draw_str(x, y--, "LINES");
-        draw_text(x, y--, "%5d", tetris_.GetTotalLineCount());
+        draw_text(x, y--, "%5d", view.lines);
 
         y--;
         draw_str(x, y--, "LEVEL");
-        draw_text(x, y--, "%5d", tetris_.GetLevel());
+        draw_text(x, y--, "%5d", view.level);
 
         y--;
         draw_str(x, y--, "Q: Quit");
@@ -310,9 +805,9 @@ void Display::draw_info() const
 
         draw_str(x, y, "NEXT");
 
-        if (!tetris_.IsPaused()) {
-            for (int i = 0; i < 14; i++) {
-                const Piece next = tetris_.GetNextPiece(i);
+        if (!view.is_paused) {
+            for (int i = 0; i < (int) view.next.size(); i++) {
+                const Piece &next = view.next[i];
 
                 if (next.kind == E)
                     continue;
@@ -327,11 +822,11 @@ void Display::draw_info() const
         int x = -6, y = 20;
 
         draw_str(x, y, "HOLD");
-        if (!tetris_.IsPaused()) {
-            const Piece hold = tetris_.GetHoldPiece();
+        if (!view.is_paused) {
+            const Piece &hold = view.hold;
 
-            if (!IsEmptyTile(hold.kind) && tetris_.IsHoldEnable()) {
-                const bool is_hollow = !tetris_.IsHoldAvailable();
+            if (!IsEmptyTile(hold.kind) && view.is_hold_enable) {
+                const bool is_hollow = !view.is_hold_available;
                 for (const auto &pos: hold.tiles) {
                     draw_tile(x + pos.x + 1, y + pos.y - 2, hold.kind, is_hollow);
                 }
@@ -346,101 +841,55 @@ void Display::draw_info() const
     }
 }
 
-void Display::draw_message()
+void Display::draw_message(const ViewState &view) const
 {
-    const int line_count = tetris_.GetClearedLineCount();
-    const int tspin = tetris_.GetTspinKind();
-
-    const bool send =
-        (tspin != TSPIN_NONE && line_count == 0) ||
-        (line_count > 0  && clearing_timer_ == 0);
-
-    if (send) {
-        if (tetris_.IsPerfectClear() && clearing_timer_ == 0) {
-            message_queue_.push_back({"PERFECT CLEAR", frame_});
-        }
-
-        if (tspin == TSPIN_NORMAL) {
-            message_queue_.push_back({"T-SPIN", frame_});
-        }
-        else if (tspin == TSPIN_MINI) {
-            message_queue_.push_back({"T-SPIN MINI", frame_});
-        }
-
-        switch (line_count) {
-        case 1: message_queue_.push_back({"SINGLE", frame_}); break;
-        case 2: message_queue_.push_back({"DOUBLE", frame_}); break;
-        case 3: message_queue_.push_back({"TRIPLE", frame_}); break;
-        case 4: message_queue_.push_back({"TETRIS", frame_}); break;
-        default: break;
-        }
-
-        char buf[64] = {'\0'};
-        sprintf(buf, "%+5d", tetris_.GetClearPoints());
-        message_queue_.push_back({buf, frame_});
-    }
-
-    const int combo_count = tetris_.GetComboCounter();
-
-    if (combo_count > 0 && clearing_timer_ == 0) {
-        char buf[64] = {'\0'};
-        sprintf(buf, "%d COMBO", combo_count);
-        message_queue_.push_back({buf, frame_});
-        sprintf(buf, "%+5d", tetris_.GetComboPoints());
-        message_queue_.push_back({buf, frame_});
-    }
-
-    const int back_to_back = tetris_.GetBackToBackCounter();
-
-    if (back_to_back > 0 && clearing_timer_ == 0) {
-        char buf[64] = {'\0'};
-        sprintf(buf, "%d BACK TO BACK", back_to_back);
-        message_queue_.push_back({buf, frame_});
-    }
-
-    message_queue_.erase(
-            std::remove_if(
-                message_queue_.begin(),
-                message_queue_.end(),
-                [=](const Message &msg) { return frame_ - msg.start > 60; }),
-            message_queue_.end());
+    TET_TRACE_SCOPE("Display::draw_message");
 
     int x = -7, y = 14;
-    for (const auto &msg: message_queue_) {
-        draw_str(x, y--, msg.str.c_str());
+    for (size_t i = 0; i < view.messages.Size(); i++) {
+        draw_str(x, y--, view.messages[i].str);
     }
 }
 
-void Display::draw_debug() const
+void Display::draw_debug(const ViewState &view) const
 {
-    if (!tetris_.IsDebugMode())
+    TET_TRACE_SCOPE("Display::draw_debug");
+
+    if (!is_debug_mode_)
         return;
 
     int x = 0, y = -3;
     draw_str(x, y--, "[DEBUG]");
-    draw_text(x, y--, "Lock Delay Timer: %d", tetris_.GetLockDelayTimer());
-    draw_text(x, y--, "Reset Counter: %d", tetris_.GetResetCounter());
-    draw_text(x, y--, "Gravity: %g", tetris_.GetGravity());
-    draw_text(x, y--, "Combo Counter: %d", tetris_.GetComboCounter());
+    draw_text(x, y--, "Lock Delay Timer: %d", view.lock_delay_timer);
+    draw_text(x, y--, "Reset Counter: %d", view.reset_counter);
+    draw_text(x, y--, "Gravity: %g", view.gravity);
+    draw_text(x, y--, "Combo Counter: %d", view.combo_counter);
 
     draw_str(x, y, "Next Piece Kinds: ");
-    for (int i = 0; i < 14; i++) {
-        const int kind = tetris_.GetPieceKindList(i);
+    for (int i = 0; i < (int) view.kind_list.size(); i++) {
+        const int kind = view.kind_list[i];
         draw_text(x + 18 + i, y, "%d", kind);
     }
+    y -= 2;
+
+    draw_str(x, y--, "Phase       p50(us)   p99(us)   max(us)");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        const Histogram &timing = timings_[i];
+        draw_text(x, y--, "%-8s %10.1f%10.1f%10.1f", phase_names[i],
+                timing.GetPercentile(50) / 1000.,
+                timing.GetPercentile(99) / 1000.,
+                timing.GetMax() / 1000.);
+    }
 }
 
-void Display::draw_game_over()
+void Display::draw_game_over(const ViewState &view) const
 {
-    if (!tetris_.IsGameOver())
-        return;
+    TET_TRACE_SCOPE("Display::draw_game_over");
 
-    if (game_over_counter_ == -1)
-        game_over_counter_ = 60;
-    else if (game_over_counter_ > 0)
-        game_over_counter_--;
+    if (!view.is_game_over)
+        return;
 
-    const int fill_y = game_over_counter_ / 2;
+    const int fill_y = view.game_over_counter / 2;
 
     for (int y = fill_y; y < FIELD_HEIGHT; y++) {
         for (int x = 0; x < FIELD_WIDTH; x++) {
@@ -448,7 +897,7 @@ void Display::draw_game_over()
         }
     }
 
-    if (game_over_counter_ == 0) {
+    if (view.game_over_counter == 0) {
         int x = 0, y = 11;
         draw_str(x, y--, "          ");
         draw_str(x, y--, "GAME OVER ");
@@ -456,9 +905,11 @@ void Display::draw_game_over()
     }
 }
 
-void Display::draw_pause() const
+void Display::draw_pause(const ViewState &view) const
 {
-    if (!tetris_.IsPaused())
+    TET_TRACE_SCOPE("Display::draw_pause");
+
+    if (!view.is_paused)
         return;
 
     for (int y = 0; y < FIELD_HEIGHT; y++) {
@@ -469,9 +920,8 @@ void Display::draw_pause() const
     draw_str(2, 10, "PAUSE");
 }
 
-int Display::input_key()
+int Display::input_key(int key)
 {
-    const int key = getch();
     int move = 0;
 
     switch (key) {
@@ -514,6 +964,10 @@ int Display::input_key()
         tetris_.SetHoldEnable(!tetris_.IsHoldEnable());
         break;
 
+    case '4':
+        SetHintEnable(!is_hint_enable_);
+        break;
+
     case 9: // TAB
         if (tetris_.IsDebugMode()) {
             const Piece piece = tetris_.GetCurrentPiece();
@@ -556,10 +1010,10 @@ void Display::draw_str(int x, int y, const char *str) const
 
 void Display::draw_tile(int x, int y, int kind, bool is_hollow) const
 {
-    if (IsEmptyTile(kind) && !tetris_.IsDebugMode())
+    if (IsEmptyTile(kind) && !is_debug_mode_)
         return;
 
-    if (IsSolidTile(kind))
+    if (IsSolidTile(kind) || IsGarbageTile(kind))
         attrset(COLOR_PAIR(kind));
     else
         attrset(COLOR_PAIR(DEFAULT_COLOR_PAIR));
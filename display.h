@@ -2,51 +2,146 @@
 #define DISPLAY_H
 
 #include "tetris.h"
-#include <string>
-#include <deque>
+#include "bot.h"
+#include "triple_buffer.h"
+#include "ring.h"
+#include "stats.h"
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <array>
 
 struct Message {
-    Message(const std::string &message, unsigned long start_frame)
-        : str(message), start(start_frame)
-    {
-    }
-
-    std::string str = "";
+    char str[24] = {'\0'};
     unsigned long start = 0;
 };
 
+using MessageQueue = Ring<Message, 16>;
+
+// Everything render() needs, copied out of the game once per simulation tick.
+// The renderer never touches Tetris directly.
+struct ViewState {
+    // Field including borders, indexed by [y + 1][x + 1]
+    std::array<std::array<int8_t, FIELD_WIDTH + 2>, FIELD_HEIGHT + 2> tiles {};
+
+    Piece current;
+    Piece ghost;
+    Piece hint;
+    Piece hold;
+    std::array<Piece, 6> next;
+    std::array<int, 14> kind_list {};
+
+    bool is_playing = false;
+    bool is_paused = false;
+    bool is_game_over = false;
+    bool is_hold_enable = false;
+    bool is_hold_available = false;
+
+    int score = 0;
+    int lines = 0;
+    int level = 0;
+    int combo_counter = 0;
+    int lock_delay_timer = 0;
+    int reset_counter = 0;
+    float gravity = 0.f;
+
+    int cleared_line_count = 0;
+    int cleared_lines[4] = {0};
+    int clearing_timer = -1;
+    int game_over_counter = -1;
+    MessageQueue messages;
+
+    int GetTileKind(int x, int y) const { return tiles[y + 1][x + 1]; }
+};
+
+enum FramePhase {
+    PHASE_INPUT = 0,
+    PHASE_UPDATE,
+    PHASE_RENDER,
+    PHASE_REFRESH,
+    PHASE_COUNT
+};
+
 class Display {
 public:
     Display(Tetris &tetris);
     ~Display();
 
     int Open();
+    int Benchmark(int frame_count);
+    void SetTraceFile(const char *filename);
+
+    // Lets bot play every piece once its budget runs out, steering it one
+    // input per tick. Not owned.
+    void SetBot(Bot *bot);
+
+    // Shows where a bot searching in the background would place the piece
+    void SetHintEnable(bool enable);
+    void SaveFrameStats(const char *filename) const;
 
 private:
     Tetris &tetris_;
     Point global_offset_ = {};
-    std::deque<Message> message_queue_;
+    bool is_debug_mode_ = false;
+    const char *trace_file_ = nullptr;
 
+    // Simulation thread
+    MessageQueue message_queue_;
+    GameEvent clear_event_;
     int clearing_timer_ = -1;
     int game_over_counter_ = -1;
     unsigned long frame_ = 0;
+    Bot *bot_ = nullptr;
+    BotMove bot_move_;
+    bool is_bot_moving_ = false;
+    bool is_bot_input_ = false;
+    std::unique_ptr<Bot> hint_bot_;
+    bool is_hint_enable_ = false;
+    bool is_hint_stale_ = false;
+
+    // Render thread
     float fps_ = 0.f;
 
+    // Shared
+    TripleBuffer<ViewState> views_;
+    SpscRing<int, 64> keys_;
+    std::array<Histogram, PHASE_COUNT> timings_;
+    std::mutex key_mutex_;
+    std::condition_variable key_cond_;
+    int wake_pipe_[2] = {-1, -1};
+
     int initialize_screen();
     void finalize_screen();
-    int input_key();
-
-    void render();
-    void draw_borders() const;
-    void draw_field() const;
-    void draw_ghost() const;
-    void draw_tetromino() const;
-    void draw_effect();
-    void draw_info() const;
-    void draw_message();
-    void draw_debug() const;
-    void draw_game_over();
-    void draw_pause() const;
+
+    void run_simulation();
+    void tick(int key);
+    void run_renderer();
+    int input_key(int key);
+    bool is_idle() const;
+    int get_bot_input();
+    void wait_for_key();
+
+    void update_effect();
+    void handle_events();
+    void update_message();
+    void push_clear_messages(const GameEvent &event);
+    void push_message(const char *fmt, ...);
+    void update_game_over();
+    void publish_view();
+
+    void render(const ViewState &view);
+    void draw_borders(const ViewState &view) const;
+    void draw_field(const ViewState &view) const;
+    void draw_ghost(const ViewState &view) const;
+    void draw_hint(const ViewState &view) const;
+    void draw_tetromino(const ViewState &view) const;
+    void draw_effect(const ViewState &view) const;
+    void draw_info(const ViewState &view) const;
+    void draw_message(const ViewState &view) const;
+    void draw_debug(const ViewState &view) const;
+    void draw_game_over(const ViewState &view) const;
+    void draw_pause(const ViewState &view) const;
 
     void draw_str(int x, int y, const char *str) const;
     void draw_tile(int x, int y, int kind, bool is_hollow = false) const;
@@ -1,104 +1,129 @@
 #include "field.h"
 #include "log.h"
+#include "trace.h"
 
 #include <algorithm>
 #include <cassert>
 
-Field::Field()
+template <int W, int H>
+BasicField<W, H>::BasicField()
 {
 }
 
-Field::~Field()
+template <int W, int H>
+BasicField<W, H>::~BasicField()
 {
 }
 
+template <int W, int H>
 static bool is_inside_field(Point pos)
 {
-    if (pos.x < 0 || pos.x >= FIELD_WIDTH)
+    if (pos.x < 0 || pos.x >= W)
         return false;
 
-    if (pos.y < 0 || pos.y >= FIELD_HEIGHT)
+    if (pos.y < 0 || pos.y >= H)
         return false;
 
     return true;
 }
 
-bool Field::is_inside_hole(Point pos) const
-{
-    return pos.y == FIELD_HEIGHT && (pos.x >= hole_start_ && pos.x <= hole_end_);
-}
-
-void Field::Clear()
+template <int W, int H>
+void BasicField<W, H>::Clear()
 {
     lines_.fill(Line());
+    heights_.fill(0);
+    bottom_ = 0;
 }
 
-bool Field::IsEmpty() const
+template <int W, int H>
+bool BasicField<W, H>::IsEmpty() const
 {
     return std::find_if(lines_.begin(), lines_.end(),
-            [](const auto &line){ return line.tile_count > 0 && !line.is_cleared; })
+            [](const auto &line){ return line.mask != 0 && !line.is_cleared; })
         == lines_.end();
 }
 
-int Field::GetTileKind(Point pos) const
+template <int W, int H>
+uint64_t BasicField<W, H>::GetHash() const
 {
-    if (is_inside_hole(pos))
-        return E;
+    uint64_t hash = 0;
+
+    for (int y = 0; y < H; y++) {
+        hash = (hash ^ get_line(y).mask) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 29;
+    }
 
-    if (!is_inside_field(pos))
+    return hash;
+}
+
+template <int W, int H>
+int BasicField<W, H>::GetTileKind(Point pos) const
+{
+    if (!is_inside_field<W, H>(pos))
         return B;
 
-    return lines_[pos.y][pos.x];
+    return get_line(pos.y)[pos.x];
 }
 
-void Field::SetTileKind(Point pos, int kind)
+template <int W, int H>
+void BasicField<W, H>::SetTileKind(Point pos, int kind)
 {
     const int x = pos.x, y = pos.y;
 
-    AddLog("Field::SetTileKind(): kind: %d, x: %d, y: %d", kind, pos.x, pos.y);
-    TET_ASSERT(IsEmptyTile(lines_[y][x]));
-    TET_ASSERT(is_inside_field(pos));
+    TET_ASSERT(IsEmptyTile(get_line(y)[x]));
+    TET_ASSERT((is_inside_field<W, H>(pos)));
 
-    lines_[y].SetTile(x, kind);
+    get_line(y).SetTile(x, kind);
+    heights_[x] = std::max<int>(heights_[x], y + 1);
 
-    if (lines_[y].IsFilled())
+    if (get_line(y).IsFilled())
         cleared_line_count_++;
 }
 
-void Field::SetPiece(const Piece &piece)
+template <int W, int H>
+void BasicField<W, H>::SetPiece(const Piece &piece)
 {
-    for (auto pos: piece.tiles) {
-        if (is_inside_hole(pos))
-            continue;
-
+    for (auto pos: piece.tiles)
         SetTileKind(pos, piece.kind);
-    }
 }
 
-void Field::SetTopHole(int start_x, int end_x)
+template <int W, int H>
+bool BasicField<W, H>::InsertGarbageLine(int hole_x)
 {
-    if (start_x < 0 || start_x >= FIELD_WIDTH ||
-        end_x   < 0 || end_x   >= FIELD_WIDTH) {
-        hole_start_ = hole_end_ = -1;
-        return;
+    const bool has_overflowed = get_line(H - 1).mask != 0;
+
+    // The old top line becomes the new bottom one
+    bottom_ = (bottom_ + H - 1) % H;
+
+    Line &line = get_line(0);
+    line = Line();
+
+    for (int x = 0; x < W; x++) {
+        if (x != hole_x)
+            line.SetTile(x, G);
     }
 
-    hole_start_ = start_x;
-    hole_end_ = end_x;
+    for (int x = 0; x < W; x++) {
+        if (x != hole_x || heights_[x] > 0)
+            heights_[x] = std::min(heights_[x] + 1, H);
+    }
+
+    return !has_overflowed;
 }
 
-int Field::GetClearedLineCount() const
+template <int W, int H>
+int BasicField<W, H>::GetClearedLineCount() const
 {
     return cleared_line_count_;
 }
 
-void Field::GetClearedLines(int *cleared_line_y) const
+template <int W, int H>
+void BasicField<W, H>::GetClearedLines(int *cleared_line_y) const
 {
     int index = 0;
-    int y = 0;
 
-    for (auto line = lines_.begin(); line != lines_.end(); ++line, ++y) {
-        if (line->is_cleared) {
+    for (int y = 0; y < H; y++) {
+        if (get_line(y).is_cleared) {
             cleared_line_y[index++] = y;
 
             if (index == 4)
@@ -107,14 +132,66 @@ void Field::GetClearedLines(int *cleared_line_y) const
     }
 }
 
-void Field::ClearLines()
+template <int W, int H>
+void BasicField<W, H>::ClearLines()
 {
-    auto it = std::remove_if(
-            lines_.begin(),
-            lines_.end(),
-            [](const Line &line) { return line.is_cleared; });
+    TET_TRACE_SCOPE("Field::ClearLines");
+
+    int count = 0;
+
+    for (int y = 0; y < H; y++) {
+        if (get_line(y).is_cleared)
+            continue;
 
-    std::fill(it, lines_.end(), Line());
+        if (count != y)
+            get_line(count) = get_line(y);
+        count++;
+    }
+
+    for (int y = count; y < H; y++)
+        get_line(y) = Line();
 
     cleared_line_count_ = 0;
+    update_heights();
+}
+
+template <int W, int H>
+int BasicField<W, H>::GetColumnHeight(int x) const
+{
+    return heights_[x];
 }
+
+template <int W, int H>
+RowMask<W> BasicField<W, H>::GetRowMask(int y) const
+{
+    assert(y >= 0 && y < H);
+
+    return get_line(y).mask;
+}
+
+template <int W, int H>
+void BasicField<W, H>::update_heights()
+{
+    RowMask<W> seen = 0;
+
+    for (int y = H - 1; y >= 0 && seen != GetFullRowMask<W>(); y--) {
+        const RowMask<W> mask = get_line(y).mask & ~seen;
+
+        for (int x = 0; x < W; x++) {
+            if (mask & (1u << x))
+                heights_[x] = y + 1;
+        }
+        seen |= mask;
+    }
+
+    for (int x = 0; x < W; x++) {
+        if (!(seen & (1u << x)))
+            heights_[x] = 0;
+    }
+}
+
+// Visible rows only, guideline buffer zone, and narrow training fields
+template class BasicField<FIELD_WIDTH, FIELD_HEIGHT>;
+template class BasicField<FIELD_WIDTH, FIELD_BUFFER_HEIGHT>;
+template class BasicField<4, FIELD_HEIGHT>;
+template class BasicField<6, FIELD_HEIGHT>;
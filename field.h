@@ -3,25 +3,63 @@
 
 #include "point.h"
 #include "piece.h"
+#include <cassert>
 #include <cstdint>
 #include <array>
+#include <type_traits>
 
 constexpr int FIELD_WIDTH = 10;
 constexpr int FIELD_HEIGHT = 20;
 
-class Field {
+// Rows a game keeps: the visible ones and the buffer zone above them, where
+// pieces spawn and may lock
+constexpr int FIELD_BUFFER_HEIGHT = 2 * FIELD_HEIGHT;
+
+// Smallest unsigned type with a bit for every column
+template <int W>
+using RowMask =
+    typename std::conditional<(W <= 8), uint8_t,
+    typename std::conditional<(W <= 16), uint16_t, uint32_t>::type>::type;
+
+template <int W>
+constexpr RowMask<W> GetFullRowMask()
+{
+    return static_cast<RowMask<W>>((uint64_t(1) << W) - 1);
+}
+
+// Stack of W by H tiles. Instantiated in field.cc for the supported sizes.
+template <int W, int H>
+class BasicField {
 public:
-    Field();
-    ~Field();
+    static_assert(W >= 4 && W <= 32, "width must fit a row mask and a piece");
+    static_assert(H >= 4 && H <= 255, "height must fit a piece");
+
+    static constexpr int WIDTH = W;
+    static constexpr int HEIGHT = H;
+
+    BasicField();
+    ~BasicField();
 
     void Clear();
     bool IsEmpty() const;
 
+    // Hash of which cells are filled, for transposition tables
+    uint64_t GetHash() const;
+
     // Tile
     int GetTileKind(Point pos) const;
     void SetTileKind(Point pos, int kind);
     void SetPiece(const Piece &piece);
-    void SetTopHole(int start_x, int end_x);
+
+    // One above the highest tile in column x, or 0 if it is empty
+    int GetColumnHeight(int x) const;
+
+    // Bit x set where tile (x, y) is filled, for scanning many columns at once
+    RowMask<W> GetRowMask(int y) const;
+
+    // Pushes every line up by one and fills the bottom line except hole_x.
+    // Returns false if the top line had tiles and was pushed out.
+    bool InsertGarbageLine(int hole_x);
 
     // Cleared lines
     int GetClearedLineCount() const;
@@ -30,15 +68,15 @@ public:
 
 private:
     struct Line {
-        std::array<int8_t, FIELD_WIDTH> elem {0};
+        std::array<int8_t, W> elem {0};
         bool is_cleared = false;
-        int8_t tile_count = 0;
+        RowMask<W> mask = 0;
 
         Line () {}
         const int8_t operator[](int i) const { return elem[i]; }
         int8_t &operator[](int i) { return elem[i]; }
 
-        bool IsFilled() const { return tile_count == FIELD_WIDTH; }
+        bool IsFilled() const { return mask == GetFullRowMask<W>(); }
         void MarkCleared() { is_cleared = true; }
 
         void SetTile(int x, int kind)
@@ -47,18 +85,24 @@ private:
             assert(IsEmptyTile((*this)[x]));
 
             (*this)[x] = kind;
-            tile_count++;
+            mask |= 1u << x;
 
             if (IsFilled())
                 MarkCleared();
         }
     };
 
-    std::array<Line, FIELD_HEIGHT> lines_;
+    // Circular, so lines can be inserted at the bottom without moving the rest
+    std::array<Line, H> lines_;
+    std::array<uint8_t, W> heights_ {};
+    int bottom_ = 0;
     int cleared_line_count_ = 0;
-    int hole_start_ = -1, hole_end_ = -1;
 
-    bool is_inside_hole(Point pos) const;
+    Line &get_line(int y) { return lines_[(bottom_ + y) % H]; }
+    const Line &get_line(int y) const { return lines_[(bottom_ + y) % H]; }
+    void update_heights();
 };
 
+using Field = BasicField<FIELD_WIDTH, FIELD_BUFFER_HEIGHT>;
+
 #endif
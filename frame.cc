@@ -0,0 +1,183 @@
+#include "frame.h"
+#include <algorithm>
+
+static uint8_t *put_u8(uint8_t *p, uint8_t value)
+{
+    *p++ = value;
+    return p;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t value)
+{
+    *p++ = value & 0xFF;
+    *p++ = value >> 8;
+    return p;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        *p++ = (value >> (8 * i)) & 0xFF;
+    return p;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= uint32_t(p[i]) << (8 * i);
+    return value;
+}
+
+void ComposeFrame(const Tetris &tetris, uint32_t number, Frame &frame)
+{
+    // Stack
+    for (int y = 0; y < FIELD_HEIGHT; y++)
+        for (int x = 0; x < FIELD_WIDTH; x++)
+            frame.tiles[y * FIELD_WIDTH + x] = tetris.GetFieldTileKind(Point(x, y));
+
+    // Pieces
+    const Piece ghost = tetris.GetGhostPiece();
+    const Piece current = tetris.GetCurrentPiece();
+    const bool show_current = !tetris.IsGameOver() && !tetris.IsPaused();
+
+    for (auto pos: ghost.tiles) {
+        if (IsSolidTile(ghost.kind) && pos.y >= 0 && pos.y < FIELD_HEIGHT)
+            frame.tiles[pos.y * FIELD_WIDTH + pos.x] = ghost.kind + GHOST_TILE;
+    }
+    for (auto pos: current.tiles) {
+        if (show_current && IsSolidTile(current.kind) && pos.y >= 0 && pos.y < FIELD_HEIGHT)
+            frame.tiles[pos.y * FIELD_WIDTH + pos.x] = current.kind;
+    }
+
+    // Info
+    frame.number = number;
+    frame.score = tetris.GetScore();
+    frame.lines = tetris.GetTotalLineCount();
+    frame.level = tetris.GetLevel();
+    frame.flags = 0;
+    if (tetris.IsPaused())
+        frame.flags |= FRAME_PAUSED;
+    if (tetris.IsGameOver())
+        frame.flags |= FRAME_GAME_OVER;
+    frame.hold = std::max<int>(E, tetris.GetHoldPiece().kind);
+
+    for (int i = 0; i < (int) frame.next.size(); i++)
+        frame.next[i] = std::max<int>(E, tetris.GetNextPiece(i).kind);
+}
+
+bool HasFrameChanged(const Frame &prev, const Frame &curr)
+{
+    return prev.tiles != curr.tiles ||
+        prev.score != curr.score ||
+        prev.lines != curr.lines ||
+        prev.level != curr.level ||
+        prev.flags != curr.flags ||
+        prev.hold != curr.hold ||
+        prev.next != curr.next;
+}
+
+int EncodeFrame(const Frame *prev, const Frame &curr, uint8_t *buf)
+{
+    uint8_t *p = buf + 2;
+
+    p = put_u8(p, prev ? FRAME_DIFF : FRAME_KEY);
+    p = put_u32(p, curr.number);
+    p = put_u32(p, curr.score);
+    p = put_u32(p, curr.lines);
+    p = put_u32(p, curr.level);
+    p = put_u8(p, curr.flags);
+    p = put_u8(p, curr.hold);
+    for (auto kind: curr.next)
+        p = put_u8(p, kind);
+
+    uint8_t *count = p++;
+    *count = 0;
+
+    for (int i = 0; i < (int) curr.tiles.size(); i++) {
+        const int old_kind = prev ? prev->tiles[i] : E;
+
+        if (curr.tiles[i] != old_kind) {
+            p = put_u8(p, i);
+            p = put_u8(p, curr.tiles[i]);
+            (*count)++;
+        }
+    }
+
+    const int size = p - buf;
+    put_u16(buf, size - 2);
+
+    return size;
+}
+
+int EncodeHello(uint32_t game_id, uint8_t *buf)
+{
+    uint8_t *p = buf;
+
+    p = put_u16(p, FRAME_HELLO_SIZE - 2);
+    p = put_u8(p, FRAME_HELLO);
+    p = put_u32(p, game_id);
+
+    return p - buf;
+}
+
+int DecodeFrame(const uint8_t *data, int size, Frame &frame)
+{
+    if (size < 2)
+        return 0;
+
+    const int body_size = get_u16(data);
+    if (body_size < 1 || body_size > MAX_FRAME_MESSAGE_SIZE - 2)
+        return -1;
+    if (size < 2 + body_size)
+        return 0;
+
+    const uint8_t *p = data + 2;
+    const int type = *p++;
+
+    if (type == FRAME_HELLO) {
+        if (body_size != FRAME_HELLO_SIZE - 2)
+            return -1;
+
+        frame.game_id = get_u32(p);
+        return FRAME_HELLO_SIZE;
+    }
+
+    if (body_size < FRAME_HEADER_SIZE - 2)
+        return -1;
+
+    if (type == FRAME_KEY)
+        frame.tiles.fill(E);
+    else if (type != FRAME_DIFF)
+        return -1;
+
+    frame.number = get_u32(p); p += 4;
+    frame.score = get_u32(p); p += 4;
+    frame.lines = get_u32(p); p += 4;
+    frame.level = get_u32(p); p += 4;
+    frame.flags = *p++;
+    frame.hold = *p++;
+    for (auto &kind: frame.next)
+        kind = *p++;
+
+    const int count = *p++;
+    if (body_size != FRAME_HEADER_SIZE - 2 + 2 * count)
+        return -1;
+
+    for (int i = 0; i < count; i++) {
+        const int index = *p++;
+        const int8_t kind = *p++;
+
+        if (index >= (int) frame.tiles.size())
+            return -1;
+
+        frame.tiles[index] = kind;
+    }
+
+    return 2 + body_size;
+}
@@ -0,0 +1,56 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "tetris.h"
+#include <cstdint>
+#include <array>
+
+// What a remote player sees: the stack with the current and ghost pieces
+// composited in, plus the info panel.
+struct Frame {
+    uint32_t game_id = 0;
+    std::array<int8_t, FIELD_WIDTH * FIELD_HEIGHT> tiles {};
+    uint32_t number = 0;
+    int32_t score = 0;
+    int32_t lines = 0;
+    int32_t level = 0;
+    uint8_t flags = 0;
+    uint8_t hold = 0;
+    std::array<uint8_t, 6> next {};
+};
+
+enum FrameType {
+    FRAME_KEY = 1,  // changes from an empty frame
+    FRAME_DIFF = 2, // changes from the previous frame
+    FRAME_HELLO = 3, // game id, sent once to a new player
+};
+
+enum FrameFlag {
+    FRAME_PAUSED = 1 << 0,
+    FRAME_GAME_OVER = 1 << 1,
+};
+
+// Ghost tiles are sent as kind + GHOST_TILE
+constexpr int GHOST_TILE = 16;
+
+// Wire message: u16 body size, u8 type, u32 number, i32 score, i32 lines,
+// i32 level, u8 flags, u8 hold, u8 next[6], u8 change count,
+// then {u8 tile index, i8 kind} for each change. Little-endian.
+// A hello message is u16 body size, u8 type, u32 game id.
+constexpr int FRAME_HEADER_SIZE = 2 + 1 + 4 + 12 + 1 + 1 + 6 + 1;
+constexpr int FRAME_HELLO_SIZE = 2 + 1 + 4;
+constexpr int MAX_FRAME_MESSAGE_SIZE = FRAME_HEADER_SIZE + 2 * FIELD_WIDTH * FIELD_HEIGHT;
+
+void ComposeFrame(const Tetris &tetris, uint32_t number, Frame &frame);
+bool HasFrameChanged(const Frame &prev, const Frame &curr);
+
+// Writes a message turning prev into curr, or a key frame when prev is null.
+// buf needs MAX_FRAME_MESSAGE_SIZE bytes. Returns the message size.
+int EncodeFrame(const Frame *prev, const Frame &curr, uint8_t *buf);
+int EncodeHello(uint32_t game_id, uint8_t *buf);
+
+// Applies one message to frame, a hello sets game_id. Returns the bytes consumed,
+// 0 if the message is incomplete, or -1 if it is malformed.
+int DecodeFrame(const uint8_t *data, int size, Frame &frame);
+
+#endif
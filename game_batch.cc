@@ -0,0 +1,723 @@
+#include "game_batch.h"
+#include "tetromino.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdlib>
+
+// Same as Tetris
+static const int LOCK_DELAY_FRAME_COUNT = 30;
+static const int MAX_RESET_COUNT = 16;
+
+// Pieces spawn on the top visible row as in Tetris, or as high as they fit
+// on a shorter field. The rows above it are the buffer zone.
+template <int W, int H>
+struct Spawn {
+    static constexpr int X = W / 2 - 1;
+    static constexpr int Y = H - 2 < SPAWN_POS.y ? H - 2 : SPAWN_POS.y;
+};
+
+template <int W, int H>
+BasicGameBatch<W, H>::BasicGameBatch(int game_count)
+    : game_count_(game_count)
+{
+    assert(game_count > 0);
+
+    rows_.resize(game_count * H);
+    tiles_.resize(game_count * H * W);
+    cleared_line_counts_.resize(game_count);
+
+    kinds_.resize(game_count);
+    rotations_.resize(game_count);
+    xs_.resize(game_count);
+    ys_.resize(game_count);
+    hold_kinds_.resize(game_count);
+    is_hold_available_.resize(game_count);
+    bags_.resize(game_count * BAG_SIZE);
+    bag_heads_.resize(game_count);
+    bag_sizes_.resize(game_count);
+    rngs_.resize(game_count);
+
+    gravity_drops_.resize(game_count);
+    gravities_.resize(game_count);
+    lock_delay_timers_.resize(game_count);
+    reset_counters_.resize(game_count);
+
+    is_game_over_.assign(game_count, 1);
+    need_spawn_.resize(game_count);
+    is_stepping_.resize(game_count);
+    has_landed_.resize(game_count);
+
+    last_moves_.resize(game_count);
+    last_kick_xs_.resize(game_count);
+    last_kick_ys_.resize(game_count);
+    tspin_kinds_.resize(game_count);
+
+    garbage_line_counts_.resize(game_count * GARBAGE_SIZE);
+    garbage_hole_xs_.resize(game_count * GARBAGE_SIZE);
+    garbage_heads_.resize(game_count);
+    garbage_sizes_.resize(game_count);
+    is_garbage_due_.resize(game_count);
+    attacks_.resize(game_count);
+
+    scorers_.resize(game_count);
+}
+
+template <int W, int H>
+BasicGameBatch<W, H>::~BasicGameBatch()
+{
+}
+
+template <int W, int H>
+int BasicGameBatch<W, H>::GetGameCount() const
+{
+    return game_count_;
+}
+
+template <int W, int H>
+void BasicGameBatch<W, H>::PlayGames(const unsigned int *seeds)
+{
+    for (int i = 0; i < game_count_; i++)
+        PlayGame(i, seeds[i]);
+}
+
+template <int W, int H>
+void BasicGameBatch<W, H>::PlayGame(int game, unsigned int seed)
+{
+    InitializePieces();
+
+    // Bags
+    rngs_[game].seed(seed);
+    bag_heads_[game] = 0;
+    bag_sizes_[game] = 0;
+    for (int i = 0; i < 2; i++)
+        generate_bag(game);
+
+    // Field
+    std::fill_n(get_rows(game), H, 0);
+    std::fill_n(&tiles_[game * H * W], H * W, E);
+    cleared_line_counts_[game] = 0;
+
+    // Pieces
+    kinds_[game] = E;
+    rotations_[game] = 0;
+    xs_[game] = 0;
+    ys_[game] = 0;
+    hold_kinds_[game] = E;
+    is_hold_available_[game] = 0;
+
+    // Timers
+    gravity_drops_[game] = 0;
+    gravities_[game] = GetLevelGravity(1);
+    lock_delay_timers_[game] = -1;
+    reset_counters_[game] = -1;
+
+    // Flags
+    is_game_over_[game] = 0;
+    need_spawn_[game] = 1;
+
+    // T-spin
+    last_moves_[game] = 0;
+    last_kick_xs_[game] = 0;
+    last_kick_ys_[game] = 0;
+    tspin_kinds_[game] = TSPIN_NONE;
+
+    // Garbage
+    garbage_heads_[game] = 0;
+    garbage_sizes_[game] = 0;
+    is_garbage_due_[game] = 0;
+    attacks_[game] = 0;
+
+    scorers_[game].Reset();
+}
+
+template <int W, int H>
+void BasicGameBatch<W, H>::UpdateFrame(const int *moves)
+{
+    const int count = game_count_;
+
+    // Line clears and spawns
+    for (int i = 0; i < count; i++)
+        is_stepping_[i] = !is_game_over_[i] && begin_piece(i);
+
+    // Gravity
+    for (int i = 0; i < count; i++) {
+        const bool is_falling = is_stepping_[i] && !is_instant_gravity(i) &&
+            !(moves[i] & (HOLD_PIECE | MOV_HARDDROP));
+        const bool is_soft_dropping = is_falling && (moves[i] & MOV_DOWN);
+
+        gravity_drops_[i] += is_falling ? gravities_[i] : 0;
+        gravity_drops_[i] += is_soft_dropping ? GRAVITY_UNIT : 0;
+    }
+
+    // Moves
+    for (int i = 0; i < count; i++) {
+        if (!is_stepping_[i])
+            continue;
+
+        const int move = moves[i];
+
+        if (move & HOLD_PIECE) {
+            hold_piece(i);
+            is_stepping_[i] = 0;
+            continue;
+        }
+        else if (move & MOV_HARDDROP) {
+            const int distance = get_drop_distance(i, rotations_[i], xs_[i], ys_[i]);
+            ys_[i] -= distance;
+            lock_delay_timers_[i] = 0;
+
+            scorers_[i].AddHardDrop(distance);
+        }
+        else if (is_instant_gravity(i)) {
+            // 20G as in Tetris: the piece stays on the stack, only reaching
+            // a lower row restarts lock delay, and down locks at once
+            const int old_y = ys_[i];
+            shift_piece(i, move);
+            rotate_piece(i, move);
+            ys_[i] -= get_drop_distance(i, rotations_[i], xs_[i], ys_[i]);
+
+            if (ys_[i] < old_y)
+                lock_delay_timers_[i] = -1;
+            if (move & MOV_DOWN)
+                lock_delay_timers_[i] = 0;
+        }
+        else {
+            move_piece(i, move);
+        }
+
+        if (move)
+            last_moves_[i] = move;
+
+        has_landed_[i] = !can_fit(i, kinds_[i], rotations_[i], xs_[i], ys_[i] - 1);
+        if (has_landed_[i]) {
+            gravity_drops_[i] = 0;
+            if (lock_delay_timers_[i] == -1)
+                lock_delay_timers_[i] = LOCK_DELAY_FRAME_COUNT;
+        }
+
+        if (lock_delay_timers_[i] == 0 && has_landed_[i]) {
+            lock_piece(i);
+            is_stepping_[i] = 0;
+        }
+    }
+
+    // Lock delay
+    for (int i = 0; i < count; i++)
+        lock_delay_timers_[i] -= is_stepping_[i] && lock_delay_timers_[i] > 0;
+}
+
+template <int W, int H>
+void BasicGameBatch<W, H>::PlacePiece(const int *rotations, const int *xs, bool *results)
+{
+    for (int i = 0; i < game_count_; i++) {
+        const int rotation = rotations[i];
+        const int x = xs[i];
+
+        const bool can_place = !is_game_over_[i] &&
+            rotation >= 0 && rotation < 4 && begin_piece(i) &&
+            can_fit(i, kinds_[i], rotation, x, ys_[i]);
+
+        if (can_place) {
+            const int distance = get_drop_distance(i, rotation, x, ys_[i]);
+
+            rotations_[i] = rotation;
+            xs_[i] = x;
+            ys_[i] -= distance;
+            last_moves_[i] = MOV_HARDDROP;
+
+            scorers_[i].AddHardDrop(distance);
+            lock_piece(i);
+        }
+
+        if (results)
+            results[i] = can_place;
+    }
+}
+
+template <int W, int H>
+bool BasicGameBatch<W, H>::is_occupied(int game, int x, int y) const
+{
+    if (x < 0 || x >= W || y < 0 || y >= H)
+        return true;
+
+    return (get_rows(game)[y] >> x) & 1;
+}
+
+template <int W, int H>
+bool BasicGameBatch<W, H>::can_fit(int game, int kind, int rotation, int x, int y) const
+{
+    const Piece piece = GetPiece(kind, rotation);
+
+    for (auto tile: piece.tiles) {
+        if (is_occupied(game, x + tile.x, y + tile.y))
+            return false;
+    }
+
+    return true;
+}
+
+template <int W, int H>
+int BasicGameBatch<W, H>::get_drop_distance(int game, int rotation, int x, int y) const
+{
+    int distance = 0;
+
+    while (can_fit(game, kinds_[game], rotation, x, y - distance - 1))
+        distance++;
+
+    return distance;
+}
+
+template <int W, int H>
+bool BasicGameBatch<W, H>::begin_piece(int game)
+{
+    // Clears lines
+    if (cleared_line_counts_[game] > 0 || tspin_kinds_[game] > 0) {
+        scorers_[game].Commit();
+        clear_lines(game);
+        gravities_[game] = GetLevelGravity(scorers_[game].GetLevel());
+    }
+
+    // Spawn
+    if (need_spawn_[game]) {
+        const bool has_overflowed = is_garbage_due_[game] && !insert_garbage(game);
+        is_garbage_due_[game] = 0;
+
+        if (has_overflowed || !spawn_piece(game)) {
+            is_game_over_[game] = 1;
+            return false;
+        }
+
+        scorers_[game].Start();
+        lock_delay_timers_[game] = -1;
+        reset_counters_[game] = 0;
+        is_hold_available_[game] = 1;
+        last_kick_xs_[game] = 0;
+        last_kick_ys_[game] = 0;
+        tspin_kinds_[game] = TSPIN_NONE;
+    }
+
+    return true;
+}
+
+template <int W, int H>
+bool BasicGameBatch<W, H>::spawn_piece(int game)
+{
+    if (bag_sizes_[game] == 7)
+        generate_bag(game);
+
+    kinds_[game] = bags_[game * BAG_SIZE + bag_heads_[game]];
+    bag_heads_[game] = (bag_heads_[game] + 1) % BAG_SIZE;
+    bag_sizes_[game]--;
+
+    rotations_[game] = 0;
+    xs_[game] = Spawn<W, H>::X;
+    ys_[game] = Spawn<W, H>::Y;
+
+    need_spawn_[game] = 0;
+    return can_fit(game, kinds_[game], 0, xs_[game], ys_[game]);
+}
+
+template <int W, int H>
+void BasicGameBatch<W, H>::generate_bag(int game)
+{
+    std::array<int, 7> kinds = {I, O, S, Z, J, L, T};
+    ShufflePieces(kinds.data(), kinds.size(), rngs_[game]);
+
+    for (auto kind: kinds) {
+        const int index = (bag_heads_[game] + bag_sizes_[game]) % BAG_SIZE;
+        bags_[game * BAG_SIZE + index] = kind;
+        bag_sizes_[game]++;
+    }
+}
+
+template <int W, int H>
+bool BasicGameBatch<W, H>::is_instant_gravity(int game) const
+{
+    return gravities_[game] >= GetLevelGravity(20);
+}
+
+template <int W, int H>
+bool BasicGameBatch<W, H>::shift_piece(int game, int move)
+{
+    const int dx = (move & MOV_LEFT) ? -1 : (move & MOV_RIGHT) ? 1 : 0;
+
+    if (!dx || !can_fit(game, kinds_[game], rotations_[game], xs_[game] + dx, ys_[game]))
+        return false;
+
+    xs_[game] += dx;
+    return true;
+}
+
+template <int W, int H>
+bool BasicGameBatch<W, H>::rotate_piece(int game, int move)
+{
+    const int kind = kinds_[game];
+    const int old_rotation = rotations_[game];
+    const int rotation =
+        (move & ROT_LEFT)  ? (old_rotation + 3) % 4 :
+        (move & ROT_RIGHT) ? (old_rotation + 1) % 4 : old_rotation;
+
+    if (rotation == old_rotation)
+        return false;
+
+    last_kick_xs_[game] = 0;
+    last_kick_ys_[game] = 0;
+
+    for (int i = 0; i < SRS::KICK_COUNT; i++) {
+        const Point offset = SRS::GetKickOffset(kind, old_rotation, rotation, i);
+
+        if (can_fit(game, kind, rotation, xs_[game] + offset.x, ys_[game] + offset.y)) {
+            rotations_[game] = rotation;
+            xs_[game] += offset.x;
+            ys_[game] += offset.y;
+            last_kick_xs_[game] = -offset.x;
+            last_kick_ys_[game] = -offset.y;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <int W, int H>
+void BasicGameBatch<W, H>::move_piece(int game, int move)
+{
+    const int kind = kinds_[game];
+    bool has_moved = false;
+
+    // Drop
+    int32_t &gravity_drop = gravity_drops_[game];
+    int y = ys_[game];
+
+    while (gravity_drop >= GRAVITY_UNIT) {
+        y--;
+        gravity_drop -= GRAVITY_UNIT;
+        if (!can_fit(game, kind, rotations_[game], xs_[game], y)) {
+            y++;
+            break;
+        }
+    }
+
+    if (y != ys_[game]) {
+        ys_[game] = y;
+        has_moved = true;
+    }
+
+    has_moved = shift_piece(game, move) || has_moved;
+    has_moved = rotate_piece(game, move) || has_moved;
+
+    // Lock delay
+    if (has_moved && lock_delay_timers_[game] > 0 && reset_counters_[game] < MAX_RESET_COUNT) {
+        lock_delay_timers_[game] = -1;
+        reset_counters_[game]++;
+    }
+
+    if (has_moved && (move & MOV_DOWN))
+        scorers_[game].AddSoftDrop();
+}
+
+template <int W, int H>
+void BasicGameBatch<W, H>::hold_piece(int game)
+{
+    if (IsEmptyTile(hold_kinds_[game])) {
+        hold_kinds_[game] = kinds_[game];
+        need_spawn_[game] = 1;
+    }
+    else if (is_hold_available_[game]) {
+        std::swap(kinds_[game], hold_kinds_[game]);
+        rotations_[game] = 0;
+        xs_[game] = Spawn<W, H>::X;
+        ys_[game] = Spawn<W, H>::Y;
+        lock_delay_timers_[game] = -1;
+        reset_counters_[game] = 0;
+
+        if (!can_fit(game, kinds_[game], 0, xs_[game], ys_[game]))
+            is_game_over_[game] = 1;
+    }
+
+    is_hold_available_[game] = 0;
+}
+
+template <int W, int H>
+void BasicGameBatch<W, H>::lock_piece(int game)
+{
+    RowMask<W> *rows = get_rows(game);
+    int8_t *tiles = &tiles_[game * H * W];
+
+    bool is_locked_out = true;
+
+    for (auto pos: GetCurrentPiece(game).tiles) {
+        rows[pos.y] |= 1 << pos.x;
+        tiles[pos.y * W + pos.x] = kinds_[game];
+        is_locked_out = is_locked_out && pos.y > Spawn<W, H>::Y;
+    }
+
+    int cleared_line_count = 0;
+    bool is_perfect_clear = true;
+
+    for (int y = 0; y < H; y++) {
+        cleared_line_count += rows[y] == GetFullRowMask<W>();
+        is_perfect_clear = is_perfect_clear && (rows[y] == 0 || rows[y] == GetFullRowMask<W>());
+    }
+
+    cleared_line_counts_[game] = cleared_line_count;
+    tspin_kinds_[game] = detect_tspin(game);
+    scorers_[game].AddLineClear(cleared_line_count, tspin_kinds_[game], is_perfect_clear);
+
+    // Attack offsets pending garbage first
+    attacks_[game] += cancel_garbage(game, scorers_[game].GetAttack());
+    is_garbage_due_[game] = cleared_line_count == 0;
+
+    need_spawn_[game] = 1;
+    is_game_over_[game] = is_locked_out;
+}
+
+template <int W, int H>
+void BasicGameBatch<W, H>::clear_lines(int game)
+{
+    RowMask<W> *rows = get_rows(game);
+    int8_t *tiles = &tiles_[game * H * W];
+    int count = 0;
+
+    for (int y = 0; y < H; y++) {
+        if (rows[y] == GetFullRowMask<W>())
+            continue;
+
+        if (count != y) {
+            rows[count] = rows[y];
+            std::copy_n(&tiles[y * W], W, &tiles[count * W]);
+        }
+        count++;
+    }
+
+    std::fill(&rows[count], &rows[H], 0);
+    std::fill(&tiles[count * W], &tiles[H * W], E);
+
+    cleared_line_counts_[game] = 0;
+}
+
+template <int W, int H>
+int BasicGameBatch<W, H>::cancel_garbage(int game, int attack)
+{
+    int8_t *line_counts = &garbage_line_counts_[game * GARBAGE_SIZE];
+
+    while (attack > 0 && garbage_sizes_[game] > 0) {
+        int8_t &line_count = line_counts[garbage_heads_[game]];
+        const int count = std::min<int>(attack, line_count);
+
+        line_count -= count;
+        attack -= count;
+
+        if (line_count == 0) {
+            garbage_heads_[game] = (garbage_heads_[game] + 1) % GARBAGE_SIZE;
+            garbage_sizes_[game]--;
+        }
+    }
+
+    return attack;
+}
+
+template <int W, int H>
+bool BasicGameBatch<W, H>::insert_garbage(int game)
+{
+    RowMask<W> *rows = get_rows(game);
+    int8_t *tiles = &tiles_[game * H * W];
+
+    for (; garbage_sizes_[game] > 0; garbage_sizes_[game]--) {
+        const int index = game * GARBAGE_SIZE + garbage_heads_[game];
+        const int hole_x = garbage_hole_xs_[index];
+        garbage_heads_[game] = (garbage_heads_[game] + 1) % GARBAGE_SIZE;
+
+        // Every line moves up one, and the top one overflows
+        for (int i = 0; i < garbage_line_counts_[index]; i++) {
+            if (rows[H - 1] != 0)
+                return false;
+
+            std::copy_backward(&rows[0], &rows[H - 1], &rows[H]);
+            std::copy_backward(&tiles[0], &tiles[(H - 1) * W], &tiles[H * W]);
+
+            rows[0] = GetFullRowMask<W>() & ~(RowMask<W>(1) << hole_x);
+            for (int x = 0; x < W; x++)
+                tiles[x] = x == hole_x ? E : G;
+        }
+    }
+
+    return true;
+}
+
+template <int W, int H>
+int BasicGameBatch<W, H>::detect_tspin(int game) const
+{
+    if (kinds_[game] != T)
+        return TSPIN_NONE;
+
+    if (!(last_moves_[game] & (ROT_LEFT | ROT_RIGHT)))
+        return TSPIN_NONE;
+
+    if (cleared_line_counts_[game] == 4)
+        return TSPIN_NONE;
+
+    // Detection
+    const Piece tcorners = GetTcorners(rotations_[game]);
+    int front_occluded = 0;
+    int back_occluded = 0;
+
+    for (int i = 0; i < 4; i++) {
+        const Point world = Point(xs_[game], ys_[game]) + tcorners.tiles[i];
+
+        if (is_occupied(game, world.x, world.y)) {
+            if (i == 0 || i == 1)
+                front_occluded++;
+            if (i == 2 || i == 3)
+                back_occluded++;
+        }
+    }
+
+    // Kind
+    int tspin_kind = TSPIN_NONE;
+
+    if (front_occluded == 2 && back_occluded == 1)
+        tspin_kind = TSPIN_NORMAL;
+    else if (front_occluded == 1 && back_occluded == 2)
+        tspin_kind = TSPIN_MINI;
+
+    if (tspin_kind == TSPIN_MINI && abs(last_kick_xs_[game]) == 1 && abs(last_kick_ys_[game]) == 2)
+        tspin_kind = TSPIN_NORMAL;
+
+    return tspin_kind;
+}
+
+template <int W, int H>
+void BasicGameBatch<W, H>::ReceiveGarbage(int game, int line_count, int hole_x)
+{
+    if (line_count <= 0)
+        return;
+
+    // Drops the oldest when full, like the ring of Tetris
+    if (garbage_sizes_[game] == GARBAGE_SIZE) {
+        garbage_heads_[game] = (garbage_heads_[game] + 1) % GARBAGE_SIZE;
+        garbage_sizes_[game]--;
+    }
+
+    const int index = game * GARBAGE_SIZE +
+        (garbage_heads_[game] + garbage_sizes_[game]) % GARBAGE_SIZE;
+    garbage_line_counts_[index] = std::min(line_count, H);
+    garbage_hole_xs_[index] = hole_x;
+    garbage_sizes_[game]++;
+}
+
+template <int W, int H>
+int BasicGameBatch<W, H>::GetPendingGarbage(int game) const
+{
+    int count = 0;
+
+    for (int i = 0; i < garbage_sizes_[game]; i++)
+        count += garbage_line_counts_[game * GARBAGE_SIZE + (garbage_heads_[game] + i) % GARBAGE_SIZE];
+
+    return count;
+}
+
+template <int W, int H>
+int BasicGameBatch<W, H>::PopAttack(int game)
+{
+    const int attack = attacks_[game];
+    attacks_[game] = 0;
+
+    return attack;
+}
+
+template <int W, int H>
+void BasicGameBatch<W, H>::SetFieldTileKind(int game, Point pos, int kind)
+{
+    if (pos.x < 0 || pos.x >= W || pos.y < 0 || pos.y >= H)
+        return;
+
+    RowMask<W> &row = get_rows(game)[pos.y];
+    const RowMask<W> bit = RowMask<W>(1) << pos.x;
+
+    row = IsEmptyTile(kind) ? row & ~bit : row | bit;
+    tiles_[(game * H + pos.y) * W + pos.x] = kind;
+}
+
+template <int W, int H>
+void BasicGameBatch<W, H>::SetGravity(int game, int gravity)
+{
+    gravities_[game] = gravity;
+}
+
+template <int W, int H>
+bool BasicGameBatch<W, H>::IsGameOver(int game) const
+{
+    return is_game_over_[game];
+}
+
+template <int W, int H>
+int BasicGameBatch<W, H>::GetFieldTileKind(int game, Point pos) const
+{
+    if (pos.x < 0 || pos.x >= W || pos.y < 0 || pos.y >= H)
+        return B;
+
+    return tiles_[(game * H + pos.y) * W + pos.x];
+}
+
+template <int W, int H>
+int BasicGameBatch<W, H>::GetClearedLineCount(int game) const
+{
+    return cleared_line_counts_[game];
+}
+
+template <int W, int H>
+Piece BasicGameBatch<W, H>::GetCurrentPiece(int game) const
+{
+    Piece piece = GetPiece(kinds_[game], rotations_[game]);
+
+    for (auto &pos: piece.tiles)
+        pos += Point(xs_[game], ys_[game]);
+
+    return piece;
+}
+
+template <int W, int H>
+Piece BasicGameBatch<W, H>::GetHoldPiece(int game) const
+{
+    return GetPiece(hold_kinds_[game], 0);
+}
+
+template <int W, int H>
+int BasicGameBatch<W, H>::GetNextPieceKind(int game, int index) const
+{
+    if (index < 0 || index >= bag_sizes_[game])
+        return E;
+
+    return bags_[game * BAG_SIZE + (bag_heads_[game] + index) % BAG_SIZE];
+}
+
+template <int W, int H>
+int BasicGameBatch<W, H>::GetTspinKind(int game) const
+{
+    return tspin_kinds_[game];
+}
+
+template <int W, int H>
+int BasicGameBatch<W, H>::GetScore(int game) const
+{
+    return scorers_[game].GetScore();
+}
+
+template <int W, int H>
+int BasicGameBatch<W, H>::GetTotalLineCount(int game) const
+{
+    return scorers_[game].GetLines();
+}
+
+template <int W, int H>
+int BasicGameBatch<W, H>::GetLevel(int game) const
+{
+    return scorers_[game].GetLevel();
+}
+
+template class BasicGameBatch<FIELD_WIDTH, FIELD_HEIGHT>;
+template class BasicGameBatch<FIELD_WIDTH, FIELD_BUFFER_HEIGHT>;
+template class BasicGameBatch<4, FIELD_HEIGHT>;
+template class BasicGameBatch<6, FIELD_HEIGHT>;
@@ -0,0 +1,134 @@
+#ifndef GAME_BATCH_H
+#define GAME_BATCH_H
+
+#include "tetris.h"
+#include "field.h"
+#include "scorer.h"
+#include "piece.h"
+#include "point.h"
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Many games stepped together, with the same rules as Tetris but without
+// the debug mode or ghost. Each field of the game state is
+// one contiguous array indexed by game, and the field rows are bit masks,
+// so stepping N games streams through a few small arrays instead of N
+// separate objects. Instantiated in game_batch.cc for the sizes of Field.
+template <int W, int H>
+class BasicGameBatch {
+public:
+    explicit BasicGameBatch(int game_count);
+    ~BasicGameBatch();
+
+    int GetGameCount() const;
+
+    // Game i is seeded like Tetris::SetRandomSeed(seeds[i])
+    void PlayGames(const unsigned int *seeds);
+    void PlayGame(int game, unsigned int seed);
+
+    // One move per game, as Tetris::UpdateFrame
+    void UpdateFrame(const int *moves);
+
+    // One placement per game, as Tetris::PlacePiece. results may be null.
+    void PlacePiece(const int *rotations, const int *xs, bool *results);
+
+    // Versus garbage, as the same methods of Tetris
+    void ReceiveGarbage(int game, int line_count, int hole_x);
+    int GetPendingGarbage(int game) const;
+    int PopAttack(int game);
+
+    // Sets a tile of the field, like the debug mode of Tetris
+    void SetFieldTileKind(int game, Point pos, int kind);
+
+    // As Tetris::SetGravity, until the next line clear sets it by level
+    void SetGravity(int game, int gravity);
+
+    // Per game
+    bool IsGameOver(int game) const;
+    int GetFieldTileKind(int game, Point pos) const;
+    int GetClearedLineCount(int game) const;
+    Piece GetCurrentPiece(int game) const;
+    Piece GetHoldPiece(int game) const;
+    int GetNextPieceKind(int game, int index) const;
+    int GetTspinKind(int game) const;
+    int GetScore(int game) const;
+    int GetTotalLineCount(int game) const;
+    int GetLevel(int game) const;
+
+private:
+    enum { BAG_SIZE = 14, GARBAGE_SIZE = 16 };
+
+    int game_count_ = 0;
+
+    // Field, one row mask per line plus the tile kinds for queries
+    std::vector<RowMask<W>> rows_;
+    std::vector<int8_t> tiles_;
+    std::vector<int8_t> cleared_line_counts_;
+
+    // Pieces
+    std::vector<int8_t> kinds_;
+    std::vector<int8_t> rotations_;
+    std::vector<int8_t> xs_;
+    std::vector<int8_t> ys_;
+    std::vector<int8_t> hold_kinds_;
+    std::vector<uint8_t> is_hold_available_;
+    std::vector<int8_t> bags_;
+    std::vector<uint8_t> bag_heads_;
+    std::vector<uint8_t> bag_sizes_;
+    std::vector<std::minstd_rand> rngs_;
+
+    // Timers
+    std::vector<int32_t> gravity_drops_;
+    std::vector<int32_t> gravities_;
+    std::vector<int8_t> lock_delay_timers_;
+    std::vector<int8_t> reset_counters_;
+
+    // Flags
+    std::vector<uint8_t> is_game_over_;
+    std::vector<uint8_t> need_spawn_;
+    std::vector<uint8_t> is_stepping_;
+    std::vector<uint8_t> has_landed_;
+
+    // T-spin
+    std::vector<int> last_moves_;
+    std::vector<int8_t> last_kick_xs_;
+    std::vector<int8_t> last_kick_ys_;
+    std::vector<int8_t> tspin_kinds_;
+
+    // Garbage, queued per game like the bags
+    std::vector<int8_t> garbage_line_counts_;
+    std::vector<int8_t> garbage_hole_xs_;
+    std::vector<uint8_t> garbage_heads_;
+    std::vector<uint8_t> garbage_sizes_;
+    std::vector<uint8_t> is_garbage_due_;
+    std::vector<int> attacks_;
+
+    // Scoring only runs on locks, so it keeps Scorer's own rules
+    std::vector<Scorer> scorers_;
+
+    RowMask<W> *get_rows(int game) { return &rows_[game * H]; }
+    const RowMask<W> *get_rows(int game) const { return &rows_[game * H]; }
+
+    bool can_fit(int game, int kind, int rotation, int x, int y) const;
+    bool is_occupied(int game, int x, int y) const;
+    int get_drop_distance(int game, int rotation, int x, int y) const;
+
+    bool begin_piece(int game);
+    bool spawn_piece(int game);
+    void generate_bag(int game);
+    bool is_instant_gravity(int game) const;
+    bool shift_piece(int game, int move);
+    bool rotate_piece(int game, int move);
+    void move_piece(int game, int move);
+    void hold_piece(int game);
+    void lock_piece(int game);
+    void clear_lines(int game);
+    int cancel_garbage(int game, int attack);
+    bool insert_garbage(int game);
+    int detect_tspin(int game) const;
+};
+
+using GameBatch = BasicGameBatch<FIELD_WIDTH, FIELD_BUFFER_HEIGHT>;
+
+#endif
@@ -0,0 +1,452 @@
+#include "league.h"
+#include "trace.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+static const char REPLAY_TAG[4] = {'T', 'R', 'P', 'L'};
+static const uint32_t REPLAY_VERSION = 1;
+
+// Winners and losers are stored as i8
+static const int MAX_ENTRY_COUNT = 127;
+
+static void put_varint(std::vector<uint8_t> &buf, unsigned long value)
+{
+    while (value >= 0x80) {
+        buf.push_back((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    buf.push_back(value);
+}
+
+static void put_u32(std::vector<uint8_t> &buf, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        buf.push_back(value >> (8 * i));
+}
+
+BotPlayer::BotPlayer(const BotWeights &weights, int depth, BoardEvaluator *evaluator)
+    : depth_(depth)
+{
+    bot_.SetWeights(weights);
+    bot_.SetEvaluator(evaluator);
+}
+
+BotPlayer::~BotPlayer()
+{
+}
+
+void BotPlayer::OnSpawn(const Tetris &tetris)
+{
+    // Pieces that spawn while a move is played, after a hold, are part of it
+    if (is_moving_ && move_.use_hold && tetris.GetTetrominoKind() == move_.placement.kind)
+        return;
+
+    move_ = bot_.FindMove(tetris, depth_);
+    is_moving_ = move_.input_count > 0;
+}
+
+int BotPlayer::GetMove(const Tetris &tetris)
+{
+    if (!is_moving_)
+        return 0;
+
+    const int input = bot_.GetInput(tetris, move_);
+    if (input == MOV_HARDDROP)
+        is_moving_ = false;
+
+    return input;
+}
+
+League::League()
+{
+}
+
+League::~League()
+{
+}
+
+int League::AddEntry(const char *name, PlayerFactory factory)
+{
+    if ((int) entries_.size() >= MAX_ENTRY_COUNT)
+        return -1;
+
+    entries_.push_back({name, factory});
+    return entries_.size() - 1;
+}
+
+void League::SetSeeds(const std::vector<unsigned int> &seeds)
+{
+    seeds_ = seeds;
+}
+
+void League::SetThreadCount(int count)
+{
+    thread_count_ = std::max(1, count);
+}
+
+void League::SetFrameLimit(unsigned long limit)
+{
+    frame_limit_ = limit;
+}
+
+void League::PlayRoundRobin()
+{
+    std::vector<std::pair<int, int>> pairings;
+
+    for (int i = 0; i < GetEntryCount(); i++) {
+        for (int j = i + 1; j < GetEntryCount(); j++)
+            pairings.push_back({i, j});
+    }
+
+    play_pairings(pairings);
+}
+
+void League::PlaySwiss(int round_count)
+{
+    const int count = GetEntryCount();
+
+    for (int round = 0; round < round_count; round++) {
+        // Leaders first, and the first entry in ties
+        std::vector<int> order(count);
+        for (int i = 0; i < count; i++)
+            order[i] = i;
+
+        std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+            return get_points(a) > get_points(b);
+        });
+
+        std::vector<bool> has_met(count * count, false);
+        for (const LeagueGame &game: games_) {
+            has_met[game.entries[0] * count + game.entries[1]] = true;
+            has_met[game.entries[1] * count + game.entries[0]] = true;
+        }
+
+        // Each takes the next one down it hasn't met, or just the next one.
+        // With an odd count the last one sits out.
+        std::vector<bool> is_paired(count, false);
+        std::vector<std::pair<int, int>> pairings;
+
+        for (int i = 0; i < count; i++) {
+            const int a = order[i];
+            if (is_paired[a])
+                continue;
+
+            int b = -1;
+            for (int j = i + 1; j < count; j++) {
+                const int other = order[j];
+                if (is_paired[other])
+                    continue;
+                if (b < 0)
+                    b = other;
+                if (!has_met[a * count + other]) {
+                    b = other;
+                    break;
+                }
+            }
+            if (b < 0)
+                break;
+
+            is_paired[a] = is_paired[b] = true;
+            pairings.push_back({a, b});
+        }
+
+        play_pairings(pairings);
+    }
+}
+
+void League::play_pairings(const std::vector<std::pair<int, int>> &pairings)
+{
+    TET_TRACE_SCOPE("League::play_pairings");
+
+    const size_t first = games_.size();
+
+    for (const auto &pairing: pairings) {
+        for (unsigned int seed: seeds_) {
+            for (int seat = 0; seat < 2; seat++) {
+                LeagueGame game;
+                game.entries[seat] = pairing.first;
+                game.entries[1 - seat] = pairing.second;
+                game.seed = seed;
+                games_.push_back(game);
+            }
+        }
+    }
+
+    std::atomic<size_t> next_game {first};
+
+    auto work = [&]() {
+        for (;;) {
+            const size_t index = next_game.fetch_add(1);
+            if (index >= games_.size())
+                break;
+
+            play_game(games_[index]);
+        }
+    };
+
+    GetWorkerPool().Run(thread_count_, work);
+}
+
+void League::play_game(LeagueGame &game) const
+{
+    std::unique_ptr<LeaguePlayer> players[2];
+    for (int i = 0; i < 2; i++)
+        players[i] = entries_[game.entries[i]].factory();
+
+    Match match;
+    match.Start(2, game.seed);
+
+    int moves[2] = {0};
+    unsigned long skipped = 0;
+    game.replay.clear();
+
+    while (!match.IsOver() && (frame_limit_ == 0 || match.GetFrame() < frame_limit_)) {
+        for (int i = 0; i < 2; i++)
+            moves[i] = players[i]->GetMove(match.GetPlayer(i));
+
+        if (moves[0] || moves[1]) {
+            put_varint(game.replay, skipped);
+            game.replay.push_back(moves[0]);
+            game.replay.push_back(moves[1]);
+            skipped = 0;
+        }
+        else {
+            skipped++;
+        }
+
+        match.UpdateFrame(moves);
+
+        for (int i = 0; i < 2; i++) {
+            Tetris &player = match.GetPlayer(i);
+            GameEvent event;
+
+            while (player.PollEvent(event)) {
+                if (event.kind == EVENT_SPAWN)
+                    players[i]->OnSpawn(player);
+            }
+        }
+    }
+
+    const int winner = match.GetWinner();
+    game.winner = winner >= 0 ? game.entries[winner] : -1;
+    game.frame_count = match.GetFrame();
+}
+
+bool PlayLeagueReplay(const LeagueGame &game, Match &match)
+{
+    match.Start(2, game.seed);
+
+    const int zeros[2] = {0};
+    const uint8_t *data = game.replay.data();
+    const uint8_t *end = data + game.replay.size();
+
+    while (data < end) {
+        unsigned long skipped = 0;
+        int shift = 0;
+
+        for (;;) {
+            if (data >= end || shift > 56)
+                return false;
+
+            skipped |= (unsigned long) (*data & 0x7f) << shift;
+            shift += 7;
+            if (!(*data++ & 0x80))
+                break;
+        }
+
+        if (end - data < 2)
+            return false;
+
+        const int moves[2] = {data[0], data[1]};
+        data += 2;
+
+        for (unsigned long i = 0; i < skipped; i++)
+            match.UpdateFrame(zeros);
+        match.UpdateFrame(moves);
+    }
+
+    while (match.GetFrame() < game.frame_count)
+        match.UpdateFrame(zeros);
+
+    return true;
+}
+
+int League::GetEntryCount() const
+{
+    return entries_.size();
+}
+
+const char *League::GetEntryName(int entry) const
+{
+    return entries_[entry].name.c_str();
+}
+
+const std::vector<LeagueGame> &League::GetGames() const
+{
+    return games_;
+}
+
+double League::get_points(int entry) const
+{
+    double points = 0;
+
+    for (const LeagueGame &game: games_) {
+        if (game.entries[0] != entry && game.entries[1] != entry)
+            continue;
+
+        if (game.winner == entry)
+            points += 1;
+        else if (game.winner < 0)
+            points += 0.5;
+    }
+
+    return points;
+}
+
+std::vector<LeagueStanding> League::GetStandings() const
+{
+    const int count = GetEntryCount();
+    std::vector<LeagueStanding> standings(count);
+
+    // Points and games of each entry against each other
+    std::vector<double> points(count * count, 0);
+    std::vector<int> game_counts(count * count, 0);
+
+    for (const LeagueGame &game: games_) {
+        const int a = game.entries[0];
+        const int b = game.entries[1];
+
+        game_counts[a * count + b]++;
+        game_counts[b * count + a]++;
+
+        if (game.winner < 0) {
+            standings[a].draw_count++;
+            standings[b].draw_count++;
+            points[a * count + b] += 0.5;
+            points[b * count + a] += 0.5;
+        }
+        else {
+            const int loser = game.winner == a ? b : a;
+            standings[game.winner].win_count++;
+            standings[loser].loss_count++;
+            points[game.winner * count + loser] += 1;
+        }
+    }
+
+    for (LeagueStanding &standing: standings) {
+        const double n = standing.win_count + standing.loss_count + standing.draw_count;
+        if (n == 0)
+            continue;
+
+        const double z = 1.96;
+        const double p = (standing.win_count + 0.5 * standing.draw_count) / n;
+        const double center = (p + z * z / (2 * n)) / (1 + z * z / n);
+        const double half =
+            z * std::sqrt(p * (1 - p) / n + z * z / (4 * n * n)) / (1 + z * z / n);
+
+        standing.score = p;
+        standing.score_low = center - half;
+        standing.score_high = center + half;
+    }
+
+    // Bradley-Terry strengths by minorization-maximization, with a drawn
+    // game added to every pairing so no strength runs off to 0 or infinity
+    std::vector<double> strengths(count, 1);
+
+    for (int iteration = 0; iteration < 200; iteration++) {
+        for (int i = 0; i < count; i++) {
+            double wins = 0;
+            double sum = 0;
+
+            for (int j = 0; j < count; j++) {
+                const int n = game_counts[i * count + j];
+                if (n == 0)
+                    continue;
+
+                wins += points[i * count + j] + 0.5;
+                sum += (n + 1) / (strengths[i] + strengths[j]);
+            }
+
+            if (sum > 0)
+                strengths[i] = wins / sum;
+        }
+    }
+
+    double mean = 0;
+    for (int i = 0; i < count; i++) {
+        standings[i].elo = 400 * std::log10(strengths[i]);
+        mean += standings[i].elo;
+    }
+    for (int i = 0; i < count; i++)
+        standings[i].elo -= mean / std::max(1, count);
+
+    return standings;
+}
+
+void League::PrintStandings(FILE *fp) const
+{
+    const std::vector<LeagueStanding> standings = GetStandings();
+
+    std::vector<int> order(GetEntryCount());
+    for (int i = 0; i < GetEntryCount(); i++)
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return standings[a].elo > standings[b].elo;
+    });
+
+    fprintf(fp, "%-16s %6s %6s %6s %6s %7s %17s\n",
+            "entry", "elo", "wins", "losses", "draws", "score", "95% interval");
+
+    for (int entry: order) {
+        const LeagueStanding &standing = standings[entry];
+        fprintf(fp, "%-16s %6.0f %6d %6d %6d %6.1f%% [%5.1f%%, %5.1f%%]\n",
+                GetEntryName(entry), standing.elo,
+                standing.win_count, standing.loss_count, standing.draw_count,
+                100 * standing.score, 100 * standing.score_low, 100 * standing.score_high);
+    }
+}
+
+bool League::SaveReplays(const char *filename) const
+{
+    std::vector<uint8_t> buf(REPLAY_TAG, REPLAY_TAG + sizeof(REPLAY_TAG));
+    put_u32(buf, REPLAY_VERSION);
+
+    buf.push_back(entries_.size());
+    for (const Entry &entry: entries_) {
+        const size_t length = std::min<size_t>(entry.name.size(), 255);
+        buf.push_back(length);
+        buf.insert(buf.end(), entry.name.begin(), entry.name.begin() + length);
+    }
+
+    put_u32(buf, games_.size());
+    for (const LeagueGame &game: games_) {
+        buf.push_back(game.entries[0]);
+        buf.push_back(game.entries[1]);
+        put_u32(buf, game.seed);
+        buf.push_back((uint8_t) (int8_t) game.winner);
+        put_u32(buf, game.frame_count);
+        put_u32(buf, game.replay.size());
+        buf.insert(buf.end(), game.replay.begin(), game.replay.end());
+    }
+
+    FILE *fp = fopen(filename, "wb");
+
+    if (!fp) {
+        fprintf(stderr, "can't open file: %s\n", filename);
+        return false;
+    }
+
+    const bool is_written = fwrite(buf.data(), buf.size(), 1, fp) == 1;
+
+    if (fclose(fp) != 0 || !is_written) {
+        fprintf(stderr, "can't write file: %s\n", filename);
+        return false;
+    }
+
+    return true;
+}
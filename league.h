@@ -0,0 +1,130 @@
+#ifndef LEAGUE_H
+#define LEAGUE_H
+
+#include "tetris.h"
+#include "match.h"
+#include "bot.h"
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One side of a versus game, asked for an input on every frame
+class LeaguePlayer {
+public:
+    virtual ~LeaguePlayer() {}
+
+    // A new piece of tetris is ready to plan for
+    virtual void OnSpawn(const Tetris &tetris) {}
+
+    virtual int GetMove(const Tetris &tetris) = 0;
+};
+
+// Plays the moves of a Bot searching depth pieces, steering each piece
+// with Bot::GetInput one input per frame
+class BotPlayer : public LeaguePlayer {
+public:
+    BotPlayer(const BotWeights &weights, int depth, BoardEvaluator *evaluator = nullptr);
+    ~BotPlayer();
+
+    void OnSpawn(const Tetris &tetris) override;
+    int GetMove(const Tetris &tetris) override;
+
+private:
+    Bot bot_;
+    int depth_ = 1;
+    BotMove move_;
+    bool is_moving_ = false;
+};
+
+struct LeagueGame {
+    int entries[2] = {0};
+    unsigned int seed = 0;
+
+    // Entry index of the winner, or -1 for a draw at the frame limit or
+    // when both top out on the same frame
+    int winner = -1;
+    unsigned long frame_count = 0;
+
+    // The frames either side pressed something on, as {frames skipped
+    // since the last one, varint; move of each side, u8}
+    std::vector<uint8_t> replay;
+};
+
+struct LeagueStanding {
+    int win_count = 0;
+    int loss_count = 0;
+    int draw_count = 0;
+
+    // Wins plus half the draws over games, and its 95% Wilson interval
+    double score = 0;
+    double score_low = 0;
+    double score_high = 0;
+
+    // Fitted to every game played, 0 on average
+    double elo = 0;
+};
+
+// Versus games between registered players over a fixed set of seeds. Each
+// pairing plays every seed twice, once from each seat, and the games of a
+// round are spread over threads.
+class League {
+public:
+    using PlayerFactory = std::function<std::unique_ptr<LeaguePlayer>()>;
+
+    League();
+    ~League();
+
+    // Returns the index of the entry. Factories are called from many
+    // threads at once.
+    int AddEntry(const char *name, PlayerFactory factory);
+
+    void SetSeeds(const std::vector<unsigned int> &seeds);
+    void SetThreadCount(int count);
+
+    // Games still on at this frame are draws, 0 means no limit
+    void SetFrameLimit(unsigned long limit);
+
+    // Every entry against every other one
+    void PlayRoundRobin();
+
+    // Rounds pairing entries of close scores that haven't met yet
+    void PlaySwiss(int round_count);
+
+    int GetEntryCount() const;
+    const char *GetEntryName(int entry) const;
+    std::vector<LeagueStanding> GetStandings() const;
+    const std::vector<LeagueGame> &GetGames() const;
+
+    void PrintStandings(FILE *fp) const;
+
+    // Every game so far: a "TRPL" tag, u32 version, u8 entry count and
+    // each name as u8 length and bytes, u32 game count, then each game as
+    // u8 entries[2], u32 seed, i8 winner, u32 frame count, u32 replay size
+    // and the replay. Little-endian.
+    bool SaveReplays(const char *filename) const;
+
+private:
+    struct Entry {
+        std::string name;
+        PlayerFactory factory;
+    };
+
+    std::vector<Entry> entries_;
+    std::vector<unsigned int> seeds_;
+    int thread_count_ = 1;
+    unsigned long frame_limit_ = 0;
+    std::vector<LeagueGame> games_;
+
+    void play_pairings(const std::vector<std::pair<int, int>> &pairings);
+    void play_game(LeagueGame &game) const;
+    double get_points(int entry) const;
+};
+
+// Plays a replay of LeagueGame back into match, which ends where the game
+// did. False if the replay is malformed.
+bool PlayLeagueReplay(const LeagueGame &game, Match &match);
+
+#endif
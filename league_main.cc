@@ -0,0 +1,203 @@
+#include "league.h"
+#include "mlp.h"
+#include "log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Random keys every few frames, about as fast as a person, like the royale bots
+class RandomPlayer : public LeaguePlayer {
+public:
+    explicit RandomPlayer(unsigned int seed) : rng_(seed) {}
+
+    int GetMove(const Tetris &tetris) override
+    {
+        static const int moves[] = {
+            MOV_LEFT, MOV_RIGHT, MOV_LEFT, MOV_RIGHT, ROT_LEFT, ROT_RIGHT, MOV_DOWN, MOV_HARDDROP,
+        };
+
+        return frame_++ % 8 == 0 ? moves[rng_() % 8] : 0;
+    }
+
+private:
+    std::minstd_rand rng_;
+    unsigned long frame_ = 0;
+};
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: tetris-league [-e entries] [-t format] [-r rounds] [-m seeds] [-s seed]\n"
+            "                     [-f frames] [-j threads] [-o file] [-w file]\n"
+            "  -e entries      comma separated entries (default: all but mlp)\n"
+            "                  default, lookahead, flat, random, or mlp with -w\n"
+            "  -t format       rr for round-robin or swiss (default: rr)\n"
+            "  -r rounds       rounds of a swiss league (default: 3)\n"
+            "  -m seeds        seeds each pairing plays from both seats (default: 8)\n"
+            "  -s seed         first seed, the rest follow it (default: 1)\n"
+            "  -f frames       games still on at this frame are draws (default: 36000)\n"
+            "  -j threads      threads playing games (default: all cores)\n"
+            "  -o file         replays of every game\n"
+            "  -w file         MLP weights for the mlp entry\n");
+}
+
+int main(int argc, char **argv)
+{
+    std::string entry_list = "default,lookahead,flat,random";
+    const char *format = "rr";
+    int round_count = 3;
+    int seed_count = 8;
+    unsigned int seed = 1;
+    long frame_limit = 36000;
+    int thread_count = std::max(1u, std::thread::hardware_concurrency());
+    const char *replay_file = nullptr;
+    const char *weights_file = nullptr;
+
+    // Arguments
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-e") && i + 1 < argc) {
+            entry_list = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            format = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            round_count = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            seed_count = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            seed = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+            frame_limit = atol(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            replay_file = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc) {
+            weights_file = argv[++i];
+        }
+        else {
+            fprintf(stderr, "error: unknown option: %s\n", argv[i]);
+            usage();
+            return 1;
+        }
+    }
+
+    const bool is_swiss = !strcmp(format, "swiss");
+
+    if ((!is_swiss && strcmp(format, "rr")) || round_count < 1 || seed_count < 1 ||
+        frame_limit < 0 || thread_count < 1) {
+        usage();
+        return 1;
+    }
+
+    EnableLog(false);
+
+    // Shared by every game, which its Evaluate allows
+    std::unique_ptr<MlpEvaluator> evaluator;
+    if (weights_file) {
+        std::unique_ptr<MlpWeights> weights(new MlpWeights());
+        if (!LoadMlpWeights(weights_file, *weights))
+            return 1;
+        evaluator.reset(new MlpEvaluator(*weights));
+    }
+
+    // Entries
+    League league;
+    std::minstd_rand rng(seed);
+
+    for (size_t start = 0; start <= entry_list.size(); ) {
+        size_t end = entry_list.find(',', start);
+        if (end == std::string::npos)
+            end = entry_list.size();
+
+        const std::string name = entry_list.substr(start, end - start);
+        start = end + 1;
+
+        League::PlayerFactory factory;
+
+        if (name == "default") {
+            factory = []() {
+                return std::unique_ptr<LeaguePlayer>(new BotPlayer(BotWeights(), 1));
+            };
+        }
+        else if (name == "lookahead") {
+            factory = []() {
+                return std::unique_ptr<LeaguePlayer>(new BotPlayer(BotWeights(), 2));
+            };
+        }
+        else if (name == "flat") {
+            // Keeps the stack low and even, and ignores holes
+            BotWeights weights;
+            weights.holes = 0;
+            factory = [weights]() {
+                return std::unique_ptr<LeaguePlayer>(new BotPlayer(weights, 1));
+            };
+        }
+        else if (name == "random") {
+            const unsigned int player_seed = rng();
+            factory = [player_seed]() {
+                return std::unique_ptr<LeaguePlayer>(new RandomPlayer(player_seed));
+            };
+        }
+        else if (name == "mlp" && evaluator) {
+            MlpEvaluator *shared = evaluator.get();
+            factory = [shared]() {
+                return std::unique_ptr<LeaguePlayer>(new BotPlayer(BotWeights(), 1, shared));
+            };
+        }
+        else {
+            fprintf(stderr, "error: unknown entry: %s\n", name.c_str());
+            usage();
+            return 1;
+        }
+
+        league.AddEntry(name.c_str(), factory);
+    }
+
+    if (league.GetEntryCount() < 2) {
+        usage();
+        return 1;
+    }
+
+    std::vector<unsigned int> seeds(seed_count);
+    for (int i = 0; i < seed_count; i++)
+        seeds[i] = seed + i;
+
+    league.SetSeeds(seeds);
+    league.SetThreadCount(thread_count);
+    league.SetFrameLimit(frame_limit);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    if (is_swiss)
+        league.PlaySwiss(round_count);
+    else
+        league.PlayRoundRobin();
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const size_t game_count = league.GetGames().size();
+
+    printf("%zu games, %.1f s, %.1f games/s\n", game_count, elapsed.count(),
+            elapsed.count() > 0 ? game_count / elapsed.count() : 0.);
+    league.PrintStandings(stdout);
+
+    if (replay_file && !league.SaveReplays(replay_file))
+        return 1;
+
+    return 0;
+}
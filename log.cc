@@ -1,14 +1,25 @@
 #include "log.h"
+#include "ring.h"
 
+#include <atomic>
+#include <cstdarg>
 #include <iostream>
 #include <fstream>
+#include <mutex>
 #include <string>
 #include <random>
-#include <deque>
 
 static const int MAX_LOG_COUNT = 1024;
-static std::deque<std::string> logs;
-static bool is_log_enabled = true;
+static const int MAX_LOG_LENGTH = 256;
+
+struct LogLine {
+    char str[MAX_LOG_LENGTH];
+};
+
+// Any thread may log, so the ring is only touched under the mutex
+static Ring<LogLine, MAX_LOG_COUNT> logs;
+static std::mutex logs_mutex;
+static std::atomic<bool> is_log_enabled {true};
 
 void EnableLog(bool enable)
 {
@@ -20,19 +31,14 @@ void AddLog(const char *str, ...)
     if (!is_log_enabled)
         return;
 
-    // Format
-    static char buf[1024] = {'\0'};
+    // Format straight into the ring, dropping the oldest line when full
+    std::lock_guard<std::mutex> lock(logs_mutex);
+    LogLine &line = logs.PushBack();
     va_list va;
 
     va_start(va, str);
-    vsprintf(buf, str, va);
+    vsnprintf(line.str, sizeof(line.str), str, va);
     va_end(va);
-
-    // Push
-    logs.push_back(buf);
-
-    if (logs.size() > MAX_LOG_COUNT)
-        logs.pop_front();
 }
 
 void SaveLog()
@@ -53,8 +59,9 @@ void SaveLog()
         return;
     }
 
-    for (auto log: logs)
-        ofs << log << std::endl;
+    std::lock_guard<std::mutex> lock(logs_mutex);
+    for (size_t i = 0; i < logs.Size(); i++)
+        ofs << logs[i].str << std::endl;
 }
 
 void Assert(int expr, const char *str, const char *file, int line)
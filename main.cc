@@ -1,24 +1,74 @@
 #include "tetris.h"
 #include "display.h"
+#include "bot.h"
+#include "trace.h"
 
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <chrono>
+#include <memory>
 
 int main(int argc, char **argv)
 {
     Tetris tetris;
     Display display(tetris);
 
+    const char *stats_file = nullptr;
+    const char *trace_file = nullptr;
+    int benchmark_frame_count = 0;
+    double bot_budget_msec = 0;
+
     // Arguments
-    if (argc == 2) {
-        if (!strcmp(argv[1], "-d")) {
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-d")) {
             tetris.SetDebugMode();
         }
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            stats_file = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+            benchmark_frame_count = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            trace_file = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+            bot_budget_msec = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-H")) {
+            display.SetHintEnable(true);
+        }
         else {
-            fprintf(stderr, "error: unknown option: %s\n", argv[1]);
+            fprintf(stderr, "error: unknown option: %s\n", argv[i]);
             return 1;
         }
     }
 
-    return display.Open();
+    if (trace_file) {
+        if (!IsTraceEnabled())
+            fprintf(stderr, "warning: tracing is not compiled in, build with TRACE=1\n");
+        display.SetTraceFile(trace_file);
+    }
+
+    // Autoplay
+    std::unique_ptr<Bot> bot;
+    if (bot_budget_msec > 0) {
+        bot.reset(new Bot());
+        bot->SetBudget(std::chrono::microseconds((long) (bot_budget_msec * 1000)));
+        display.SetBot(bot.get());
+    }
+
+    if (benchmark_frame_count > 0)
+        return display.Benchmark(benchmark_frame_count);
+
+    const int result = display.Open();
+
+    if (stats_file)
+        display.SaveFrameStats(stats_file);
+
+    if (trace_file)
+        ExportTrace(trace_file);
+
+    return result;
 }
@@ -0,0 +1,115 @@
+#include "match.h"
+#include <cassert>
+
+Match::Match()
+{
+}
+
+Match::~Match()
+{
+}
+
+void Match::Start(int player_count, unsigned int seed)
+{
+    assert(player_count > 0);
+
+    players_.clear();
+    players_.resize(player_count);
+    attack_sent_.assign(player_count, 0);
+    rng_.seed(seed);
+    frame_ = 0;
+
+    for (auto &player: players_) {
+        player.SetRandomSeed(seed);
+        player.PlayGame();
+    }
+}
+
+void Match::UpdateFrame(const int *moves)
+{
+    const int count = GetPlayerCount();
+
+    for (int i = 0; i < count; i++)
+        players_[i].UpdateFrame(moves[i]);
+
+    // Attacks land after every player has moved, so the order doesn't matter
+    for (int i = 0; i < count; i++) {
+        const int attack = players_[i].PopAttack();
+        const int target = get_target(i);
+
+        if (attack == 0 || target < 0)
+            continue;
+
+        // One hole column per attack
+        players_[target].ReceiveGarbage(attack, rng_() % FIELD_WIDTH);
+        attack_sent_[i] += attack;
+    }
+
+    frame_++;
+}
+
+int Match::get_target(int attacker) const
+{
+    const int count = GetPlayerCount();
+
+    for (int i = 1; i < count; i++) {
+        const int target = (attacker + i) % count;
+
+        if (!players_[target].IsGameOver())
+            return target;
+    }
+
+    return -1;
+}
+
+int Match::GetPlayerCount() const
+{
+    return players_.size();
+}
+
+Tetris &Match::GetPlayer(int index)
+{
+    return players_[index];
+}
+
+const Tetris &Match::GetPlayer(int index) const
+{
+    return players_[index];
+}
+
+int Match::GetAttackSent(int index) const
+{
+    return attack_sent_[index];
+}
+
+int Match::GetAliveCount() const
+{
+    int count = 0;
+
+    for (const auto &player: players_)
+        count += !player.IsGameOver();
+
+    return count;
+}
+
+bool Match::IsOver() const
+{
+    return GetAliveCount() <= (GetPlayerCount() > 1 ? 1 : 0);
+}
+
+int Match::GetWinner() const
+{
+    if (!IsOver())
+        return -1;
+
+    for (int i = 0; i < GetPlayerCount(); i++)
+        if (!players_[i].IsGameOver())
+            return i;
+
+    return -1;
+}
+
+unsigned long Match::GetFrame() const
+{
+    return frame_;
+}
@@ -0,0 +1,40 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+#include "tetris.h"
+#include <random>
+#include <vector>
+
+// Versus play. Ticks every player's game in lockstep and sends each
+// player's attack as garbage to the next player still alive.
+class Match {
+public:
+    Match();
+    ~Match();
+
+    // Every player gets the same piece sequence
+    void Start(int player_count, unsigned int seed);
+
+    // Takes one move per player
+    void UpdateFrame(const int *moves);
+
+    int GetPlayerCount() const;
+    Tetris &GetPlayer(int index);
+    const Tetris &GetPlayer(int index) const;
+    int GetAttackSent(int index) const;
+
+    int GetAliveCount() const;
+    bool IsOver() const;
+    int GetWinner() const;
+    unsigned long GetFrame() const;
+
+private:
+    std::vector<Tetris> players_;
+    std::vector<int> attack_sent_;
+    std::minstd_rand rng_;
+    unsigned long frame_ = 0;
+
+    int get_target(int attacker) const;
+};
+
+#endif
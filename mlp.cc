@@ -0,0 +1,281 @@
+#include "mlp.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MLP_AVX2
+#include <immintrin.h>
+#endif
+
+static const char MLP_TAG[4] = {'T', 'M', 'L', 'P'};
+static const uint32_t MLP_VERSION = 1;
+
+static const int HIDDEN_COUNT = MlpWeights::HIDDEN_COUNT;
+
+static bool is_little_endian()
+{
+    const uint16_t one = 1;
+    uint8_t first;
+    memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+bool LoadMlpWeights(const char *filename, MlpWeights &weights)
+{
+    if (!is_little_endian()) {
+        fprintf(stderr, "can't read little endian weights: %s\n", filename);
+        return false;
+    }
+
+    FILE *fp = fopen(filename, "rb");
+
+    if (!fp) {
+        fprintf(stderr, "can't open file: %s\n", filename);
+        return false;
+    }
+
+    char tag[4] = {};
+    uint32_t header[3] = {};
+    MlpWeights loaded;
+
+    bool is_valid =
+        fread(tag, sizeof(tag), 1, fp) == 1 &&
+        fread(header, sizeof(header), 1, fp) == 1 &&
+        !memcmp(tag, MLP_TAG, sizeof(tag)) &&
+        header[0] == MLP_VERSION &&
+        header[1] == MlpWeights::INPUT_COUNT &&
+        header[2] == MlpWeights::HIDDEN_COUNT;
+
+    is_valid = is_valid &&
+        fread(&loaded.input_scale, sizeof(loaded.input_scale), 1, fp) == 1 &&
+        fread(loaded.input_weights, sizeof(loaded.input_weights), 1, fp) == 1 &&
+        fread(loaded.input_biases, sizeof(loaded.input_biases), 1, fp) == 1 &&
+        fread(loaded.hidden_weights, sizeof(loaded.hidden_weights), 1, fp) == 1 &&
+        fread(loaded.hidden_biases, sizeof(loaded.hidden_biases), 1, fp) == 1 &&
+        fread(loaded.output_weights, sizeof(loaded.output_weights), 1, fp) == 1 &&
+        fread(&loaded.output_bias, sizeof(loaded.output_bias), 1, fp) == 1;
+
+    fclose(fp);
+
+    if (!is_valid) {
+        fprintf(stderr, "not weights of this network: %s\n", filename);
+        return false;
+    }
+
+    weights = loaded;
+    return true;
+}
+
+bool SaveMlpWeights(const char *filename, const MlpWeights &weights)
+{
+    if (!is_little_endian()) {
+        fprintf(stderr, "can't write little endian weights: %s\n", filename);
+        return false;
+    }
+
+    FILE *fp = fopen(filename, "wb");
+
+    if (!fp) {
+        fprintf(stderr, "can't open file: %s\n", filename);
+        return false;
+    }
+
+    const uint32_t header[3] = {MLP_VERSION, MlpWeights::INPUT_COUNT, MlpWeights::HIDDEN_COUNT};
+
+    bool is_written =
+        fwrite(MLP_TAG, sizeof(MLP_TAG), 1, fp) == 1 &&
+        fwrite(header, sizeof(header), 1, fp) == 1 &&
+        fwrite(&weights.input_scale, sizeof(weights.input_scale), 1, fp) == 1 &&
+        fwrite(weights.input_weights, sizeof(weights.input_weights), 1, fp) == 1 &&
+        fwrite(weights.input_biases, sizeof(weights.input_biases), 1, fp) == 1 &&
+        fwrite(weights.hidden_weights, sizeof(weights.hidden_weights), 1, fp) == 1 &&
+        fwrite(weights.hidden_biases, sizeof(weights.hidden_biases), 1, fp) == 1 &&
+        fwrite(weights.output_weights, sizeof(weights.output_weights), 1, fp) == 1 &&
+        fwrite(&weights.output_bias, sizeof(weights.output_bias), 1, fp) == 1;
+
+    is_written = fclose(fp) == 0 && is_written;
+
+    if (!is_written)
+        fprintf(stderr, "can't write file: %s\n", filename);
+    return is_written;
+}
+
+// Rows are read before any vector work, since calls out of the AVX2
+// kernel into code built without it stall on the upper register halves
+static void get_row_masks(const Field &field, unsigned int *masks)
+{
+    for (int y = 0; y < FIELD_HEIGHT; y++)
+        masks[y] = field.GetRowMask(y);
+}
+
+// The output layer, the same for both kernels
+static double get_output(const MlpWeights &weights, const float *hidden)
+{
+    float value = weights.output_bias;
+
+    for (int i = 0; i < HIDDEN_COUNT; i++)
+        value += std::max(hidden[i], 0.0f) * weights.output_weights[i];
+
+    return value;
+}
+
+static double evaluate_scalar(const MlpWeights &weights, const Field &field)
+{
+    // First layer, over the filled cells only
+    int sums[HIDDEN_COUNT] = {0};
+
+    unsigned int masks[FIELD_HEIGHT];
+    get_row_masks(field, masks);
+
+    for (int y = 0; y < FIELD_HEIGHT; y++) {
+        unsigned int mask = masks[y];
+
+        while (mask) {
+            const int x = __builtin_ctz(mask);
+            mask &= mask - 1;
+
+            const int8_t *row = weights.input_weights[x + y * FIELD_WIDTH];
+            for (int i = 0; i < HIDDEN_COUNT; i++)
+                sums[i] += row[i];
+        }
+    }
+
+    float inputs[HIDDEN_COUNT];
+    for (int i = 0; i < HIDDEN_COUNT; i++) {
+        const float sum = (float) sums[i] * weights.input_scale + weights.input_biases[i];
+        inputs[i] = std::max(sum, 0.0f);
+    }
+
+    // Second layer, a row of weights per input, skipping the inputs ReLU zeroed
+    float hidden[HIDDEN_COUNT];
+    std::copy_n(weights.hidden_biases, HIDDEN_COUNT, hidden);
+
+    for (int i = 0; i < HIDDEN_COUNT; i++) {
+        if (inputs[i] == 0)
+            continue;
+
+        for (int j = 0; j < HIDDEN_COUNT; j++)
+            hidden[j] += inputs[i] * weights.hidden_weights[i][j];
+    }
+
+    return get_output(weights, hidden);
+}
+
+#ifdef MLP_AVX2
+static_assert(MlpWeights::HIDDEN_COUNT == 32, "the AVX2 kernel holds 32 lanes");
+
+// Eight lanes of the first layer, from int16 sums to ReLU
+__attribute__((target("avx2")))
+static __m256 get_input_lanes(__m128i sums, __m256 scale, const float *biases)
+{
+    const __m256 sum = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(sums));
+    const __m256 value = _mm256_add_ps(_mm256_mul_ps(sum, scale), _mm256_loadu_ps(biases));
+    return _mm256_max_ps(value, _mm256_setzero_ps());
+}
+
+__attribute__((target("avx2")))
+static double evaluate_avx2(const MlpWeights &weights, const Field &field)
+{
+    // First layer as two vectors of 16 int16 sums. 200 weights of at most
+    // 127 can't overflow them.
+    __m256i sums_low = _mm256_setzero_si256();
+    __m256i sums_high = _mm256_setzero_si256();
+
+    unsigned int masks[FIELD_HEIGHT];
+    get_row_masks(field, masks);
+
+    for (int y = 0; y < FIELD_HEIGHT; y++) {
+        unsigned int mask = masks[y];
+
+        while (mask) {
+            const int x = __builtin_ctz(mask);
+            mask &= mask - 1;
+
+            const int8_t *row = weights.input_weights[x + y * FIELD_WIDTH];
+            const __m256i low = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) row));
+            const __m256i high =
+                _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (row + 16)));
+
+            sums_low = _mm256_add_epi16(sums_low, low);
+            sums_high = _mm256_add_epi16(sums_high, high);
+        }
+    }
+
+    const __m256 scale = _mm256_set1_ps(weights.input_scale);
+    float inputs[HIDDEN_COUNT];
+
+    _mm256_storeu_ps(inputs + 0, get_input_lanes(
+                _mm256_castsi256_si128(sums_low), scale, weights.input_biases + 0));
+    _mm256_storeu_ps(inputs + 8, get_input_lanes(
+                _mm256_extracti128_si256(sums_low, 1), scale, weights.input_biases + 8));
+    _mm256_storeu_ps(inputs + 16, get_input_lanes(
+                _mm256_castsi256_si128(sums_high), scale, weights.input_biases + 16));
+    _mm256_storeu_ps(inputs + 24, get_input_lanes(
+                _mm256_extracti128_si256(sums_high, 1), scale, weights.input_biases + 24));
+
+    // Second layer, in the order of evaluate_scalar
+    __m256 hidden[4];
+    for (int k = 0; k < 4; k++)
+        hidden[k] = _mm256_loadu_ps(weights.hidden_biases + 8 * k);
+
+    for (int i = 0; i < HIDDEN_COUNT; i++) {
+        if (inputs[i] == 0)
+            continue;
+
+        const __m256 input = _mm256_set1_ps(inputs[i]);
+        for (int k = 0; k < 4; k++) {
+            const __m256 weight = _mm256_loadu_ps(weights.hidden_weights[i] + 8 * k);
+            hidden[k] = _mm256_add_ps(hidden[k], _mm256_mul_ps(input, weight));
+        }
+    }
+
+    float outputs[HIDDEN_COUNT];
+    for (int k = 0; k < 4; k++)
+        _mm256_storeu_ps(outputs + 8 * k, hidden[k]);
+
+    return get_output(weights, outputs);
+}
+#endif
+
+MlpEvaluator::MlpEvaluator(const MlpWeights &weights)
+    : weights_(weights)
+{
+    SetSimdEnable(true);
+}
+
+MlpEvaluator::~MlpEvaluator()
+{
+}
+
+void MlpEvaluator::SetSimdEnable(bool enable)
+{
+#ifdef MLP_AVX2
+    is_simd_enable_ = enable && __builtin_cpu_supports("avx2");
+#else
+    is_simd_enable_ = false;
+#endif
+}
+
+bool MlpEvaluator::IsSimdEnable() const
+{
+    return is_simd_enable_;
+}
+
+void MlpEvaluator::Evaluate(const Field *fields, int count, double *values)
+{
+    TET_TRACE_SCOPE("MlpEvaluator::Evaluate");
+
+#ifdef MLP_AVX2
+    if (is_simd_enable_) {
+        for (int i = 0; i < count; i++)
+            values[i] = evaluate_avx2(weights_, fields[i]);
+        return;
+    }
+#endif
+
+    for (int i = 0; i < count; i++)
+        values[i] = evaluate_scalar(weights_, fields[i]);
+}
@@ -0,0 +1,51 @@
+#ifndef MLP_H
+#define MLP_H
+
+#include "bot.h"
+#include "field.h"
+#include <cstdint>
+
+// A network of fixed shape scoring a board: one input per cell of the
+// field, two ReLU layers and one output. The first layer only ever sees
+// 0 or 1, so its weights are int8 with one scale and a board just sums the
+// rows of its filled cells.
+struct MlpWeights {
+    static constexpr int INPUT_COUNT = FIELD_WIDTH * FIELD_HEIGHT;
+    static constexpr int HIDDEN_COUNT = 32;
+
+    // Input x + y * FIELD_WIDTH is cell (x, y)
+    float input_scale = 1;
+    int8_t input_weights[INPUT_COUNT][HIDDEN_COUNT] = {};
+    float input_biases[HIDDEN_COUNT] = {};
+
+    float hidden_weights[HIDDEN_COUNT][HIDDEN_COUNT] = {};
+    float hidden_biases[HIDDEN_COUNT] = {};
+
+    float output_weights[HIDDEN_COUNT] = {};
+    float output_bias = 0;
+};
+
+// The file is a "TMLP" tag, then version, input count and hidden count as
+// uint32, then the fields of MlpWeights in order, all little endian.
+bool LoadMlpWeights(const char *filename, MlpWeights &weights);
+bool SaveMlpWeights(const char *filename, const MlpWeights &weights);
+
+// Runs the network on AVX2 when the CPU has it and on plain C++ otherwise.
+// Both add in the same order, so they score every board the same.
+class MlpEvaluator : public BoardEvaluator {
+public:
+    explicit MlpEvaluator(const MlpWeights &weights);
+    ~MlpEvaluator();
+
+    // Off falls back to the scalar kernels
+    void SetSimdEnable(bool enable);
+    bool IsSimdEnable() const;
+
+    void Evaluate(const Field *fields, int count, double *values) override;
+
+private:
+    MlpWeights weights_;
+    bool is_simd_enable_ = false;
+};
+
+#endif
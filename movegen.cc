@@ -0,0 +1,234 @@
+#include "movegen.h"
+#include "tetris.h"
+#include "piece.h"
+#include "trace.h"
+
+#include <algorithm>
+
+// Mixed into table keys of counts made with hold
+static const uint64_t HOLD_ENABLE_KEY = 0x6a09e667f3bcc909ull;
+
+template <typename Rules>
+MoveGenerator<Rules>::MoveGenerator()
+    : visited_(STATE_COUNT), parents_(STATE_COUNT), parent_moves_(STATE_COUNT)
+{
+    static_assert(STATE_COUNT <= 0x8000, "state indices fit parents_");
+
+    queue_.reserve(STATE_COUNT);
+}
+
+template <typename Rules>
+MoveGenerator<Rules>::~MoveGenerator()
+{
+}
+
+template <typename Rules>
+int MoveGenerator<Rules>::get_state_index(const Tetromino &tet)
+{
+    // Pieces that fit have their origin within 2 cells of the field
+    return (tet.rotation * Y_COUNT + tet.pos.y + 2) * X_COUNT + tet.pos.x + 2;
+}
+
+template <typename Rules>
+uint64_t MoveGenerator<Rules>::get_cell_key(const Tetromino &tet)
+{
+    static_assert(Field::WIDTH * Field::HEIGHT <= 0x10000, "every cell fits in 16 bits");
+
+    const Piece piece = GetPiece(tet.kind, tet.rotation);
+    uint16_t cells[4];
+
+    for (int i = 0; i < 4; i++) {
+        const Point world = tet.pos + piece.tiles[i];
+        cells[i] = world.y * Field::WIDTH + world.x;
+    }
+    std::sort(cells, cells + 4);
+
+    return cells[0] | (uint64_t) cells[1] << 16 | (uint64_t) cells[2] << 32 |
+        (uint64_t) cells[3] << 48;
+}
+
+template <typename Rules>
+void MoveGenerator<Rules>::Generate(const Field &field, const Tetromino &start,
+        std::vector<Tetromino> &placements)
+{
+    placements.clear();
+    keys_.clear();
+    queue_.clear();
+
+    if (!start.CanFit(field))
+        return;
+
+    std::fill(visited_.begin(), visited_.end(), 0);
+    queue_.push_back(start);
+    visited_[get_state_index(start)] = 1;
+    parents_[get_state_index(start)] = -1;
+
+    // Breadth first over (rotation, x, y)
+    for (size_t head = 0; head < queue_.size(); head++) {
+        const Tetromino current = queue_[head];
+        const int index = get_state_index(current);
+
+        auto visit = [this, index](const Tetromino &tet, int move) {
+            const int next = get_state_index(tet);
+            if (!visited_[next]) {
+                visited_[next] = 1;
+                parents_[next] = index;
+                parent_moves_[next] = move;
+                queue_.push_back(tet);
+            }
+        };
+
+        // Turns and shifts before drops, so paths move at the top first
+        Tetromino moved;
+        for (int turn: {1, 3}) {
+            moved = current;
+            moved.rotation = (current.rotation + turn) % 4;
+            if (moved.template KickWall<Rules>(field, current.rotation))
+                visit(moved, turn == 1 ? ROT_RIGHT : ROT_LEFT);
+        }
+
+        for (int dx: {-1, 1}) {
+            moved = current;
+            moved.pos.x += dx;
+            if (moved.CanFit(field))
+                visit(moved, dx < 0 ? MOV_LEFT : MOV_RIGHT);
+        }
+
+        moved = current;
+        moved.pos.y--;
+        if (moved.CanFit(field)) {
+            visit(moved, MOV_DOWN);
+        }
+        else {
+            const uint64_t key = get_cell_key(current);
+            if (std::find(keys_.begin(), keys_.end(), key) == keys_.end()) {
+                keys_.push_back(key);
+                placements.push_back(current);
+            }
+        }
+    }
+}
+
+template <typename Rules>
+int MoveGenerator<Rules>::GetPath(const Tetromino &placement, int *moves, int max_count) const
+{
+    if (placement.rotation < 0 || placement.rotation >= 4 ||
+            placement.pos.x < -2 || placement.pos.x >= X_COUNT - 2 ||
+            placement.pos.y < -2 || placement.pos.y >= Y_COUNT - 2)
+        return -1;
+
+    const int last = get_state_index(placement);
+    if (queue_.empty() || !visited_[last])
+        return -1;
+
+    int count = 0;
+    for (int index = last; parents_[index] >= 0; index = parents_[index])
+        count++;
+
+    if (count > max_count)
+        return -1;
+
+    // Back from the placement to the start
+    int index = last;
+    for (int i = count - 1; i >= 0; i--) {
+        moves[i] = parent_moves_[index];
+        index = parents_[index];
+    }
+
+    return count;
+}
+
+template <typename Rules>
+uint64_t MoveGenerator<Rules>::Perft(const Field &field, const int *kinds, int depth)
+{
+    TET_TRACE_SCOPE("MoveGenerator::Perft");
+
+    if ((int) placements_.size() < depth)
+        placements_.resize(depth);
+
+    return perft(field, kinds, depth, E);
+}
+
+template <typename Rules>
+uint64_t MoveGenerator<Rules>::perft(const Field &field, const int *kinds, int depth, int hold_kind)
+{
+    if (depth <= 0)
+        return 1;
+
+    // Boards reached through different orders or holds share their count.
+    // Counts with hold cover more sequences, so they are keyed apart.
+    const bool use_table = table_ && depth > 1;
+    const int queue_count = is_hold_enable_ ? depth + 1 : depth;
+    const uint64_t key = use_table ?
+        field.GetHash() ^ HashQueue(kinds, queue_count, hold_kind) ^
+        (is_hold_enable_ ? HOLD_ENABLE_KEY : 0) : 0;
+    uint64_t count = 0;
+
+    if (use_table && table_->Probe(key, depth, count))
+        return count;
+
+    count = perft_piece(field, kinds[0], kinds + 1, depth, hold_kind);
+
+    // Holding places the held piece, or the next one if none is held yet.
+    // Swapping in the kind just played only repeats its sequences.
+    if (is_hold_enable_) {
+        if (hold_kind == E && kinds[1] != kinds[0])
+            count += perft_piece(field, kinds[1], kinds + 2, depth, kinds[0]);
+        else if (hold_kind != E && hold_kind != kinds[0])
+            count += perft_piece(field, hold_kind, kinds + 1, depth, kinds[0]);
+    }
+
+    if (use_table)
+        table_->Store(key, depth, count);
+
+    return count;
+}
+
+template <typename Rules>
+uint64_t MoveGenerator<Rules>::perft_piece(const Field &field, int kind,
+        const int *kinds, int depth, int hold_kind)
+{
+    // Each depth has its own list, since deeper calls reuse the others
+    std::vector<Tetromino> &placements = placements_[depth - 1];
+    Tetromino start(kind, SPAWN_POS);
+    start.rotation = Rules::SPAWN_ROTATIONS[kind];
+
+    Generate(field, start, placements);
+
+    if (depth == 1)
+        return placements.size();
+
+    uint64_t count = 0;
+
+    for (const Tetromino &placement: placements) {
+        Field next = field;
+        Piece piece = GetPiece(placement.kind, placement.rotation);
+
+        for (auto &tile: piece.tiles)
+            tile += placement.pos;
+        next.SetPiece(piece);
+
+        if (next.GetClearedLineCount() > 0)
+            next.ClearLines();
+
+        count += perft(next, kinds, depth - 1, hold_kind);
+    }
+
+    return count;
+}
+
+template <typename Rules>
+void MoveGenerator<Rules>::SetHoldEnable(bool enable)
+{
+    is_hold_enable_ = enable;
+}
+
+template <typename Rules>
+void MoveGenerator<Rules>::SetTranspositionTable(TranspositionTable *table)
+{
+    table_ = table;
+}
+
+template class MoveGenerator<SRS>;
+template class MoveGenerator<ARS>;
+template class MoveGenerator<NRS>;
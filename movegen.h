@@ -0,0 +1,65 @@
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+#include "tetromino.h"
+#include "rotation.h"
+#include "field.h"
+#include "transposition.h"
+#include <cstdint>
+#include <vector>
+
+// Finds where a piece can come to rest by the moves a player has: shifts,
+// soft drops and rotations with the kicks of Rules. Buffers are kept
+// between calls, so searching allocates only while they grow.
+// Instantiated in movegen.cc for each rotation system.
+template <typename Rules>
+class MoveGenerator {
+public:
+    MoveGenerator();
+    ~MoveGenerator();
+
+    // Every resting spot reachable from start. Spots covering the same
+    // cells, like the rotations of O, count once.
+    void Generate(const Field &field, const Tetromino &start,
+            std::vector<Tetromino> &placements);
+
+    // The moves the last Generate took to reach placement, one per frame:
+    // shifts and rotations as early as a shortest path allows, then drops.
+    // Returns how many, or -1 if it wasn't reached or takes over max_count.
+    int GetPath(const Tetromino &placement, int *moves, int max_count) const;
+
+    // Counts the sequences of depth placements, each piece spawning at
+    // SPAWN_POS after the lines of the last one are cleared. Pieces come
+    // from kinds, which needs depth + 1 entries when hold is enabled.
+    uint64_t Perft(const Field &field, const int *kinds, int depth);
+
+    // Lets Perft place the held piece, or the next one, instead
+    void SetHoldEnable(bool enable);
+
+    // Lets Perft reuse counts for boards reached in different orders.
+    // The table is not owned; null turns it off.
+    void SetTranspositionTable(TranspositionTable *table);
+
+private:
+    bool is_hold_enable_ = false;
+    TranspositionTable *table_ = nullptr;
+
+    static constexpr int X_COUNT = Field::WIDTH + 4;
+    static constexpr int Y_COUNT = Field::HEIGHT + 4;
+    static constexpr int STATE_COUNT = 4 * X_COUNT * Y_COUNT;
+
+    std::vector<uint8_t> visited_;
+    std::vector<int16_t> parents_;
+    std::vector<uint8_t> parent_moves_;
+    std::vector<Tetromino> queue_;
+    std::vector<uint64_t> keys_;
+    std::vector<std::vector<Tetromino>> placements_;
+
+    uint64_t perft(const Field &field, const int *kinds, int depth, int hold_kind);
+    uint64_t perft_piece(const Field &field, int kind, const int *kinds, int depth, int hold_kind);
+
+    static int get_state_index(const Tetromino &tet);
+    static uint64_t get_cell_key(const Tetromino &tet);
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "net.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+
+static const int LISTEN_BACKLOG = 1024;
+
+static bool make_unix_address(const char *path, sockaddr_un &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "error: socket path too long: %s\n", path);
+        return false;
+    }
+
+    strcpy(addr.sun_path, path);
+    return true;
+}
+
+static sockaddr_in make_tcp_address(int port)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    return addr;
+}
+
+static void set_no_delay(int fd)
+{
+    const int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+static int listen_on(int fd, const sockaddr *addr, socklen_t len)
+{
+    if (bind(fd, addr, len) || listen(fd, LISTEN_BACKLOG) || !SetNonBlocking(fd)) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int connect_to(int fd, const sockaddr *addr, socklen_t len)
+{
+    if (connect(fd, addr, len) || !SetNonBlocking(fd)) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int ListenUnix(const char *path)
+{
+    sockaddr_un addr;
+    if (!make_unix_address(path, addr))
+        return -1;
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    unlink(path);
+    return listen_on(fd, (const sockaddr *) &addr, sizeof(addr));
+}
+
+int ListenTcp(int port)
+{
+    const sockaddr_in addr = make_tcp_address(port);
+
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    const int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    return listen_on(fd, (const sockaddr *) &addr, sizeof(addr));
+}
+
+int ConnectUnix(const char *path)
+{
+    sockaddr_un addr;
+    if (!make_unix_address(path, addr))
+        return -1;
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    return connect_to(fd, (const sockaddr *) &addr, sizeof(addr));
+}
+
+int ConnectTcp(int port)
+{
+    const sockaddr_in addr = make_tcp_address(port);
+
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    set_no_delay(fd);
+    return connect_to(fd, (const sockaddr *) &addr, sizeof(addr));
+}
+
+int AcceptClient(int listen_fd)
+{
+    const int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0)
+        return -1;
+
+    if (!SetNonBlocking(fd)) {
+        close(fd);
+        return -1;
+    }
+
+    // Harmless on Unix domain sockets
+    set_no_delay(fd);
+    return fd;
+}
+
+bool SetNonBlocking(int fd)
+{
+    const int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
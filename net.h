@@ -0,0 +1,13 @@
+#ifndef NET_H
+#define NET_H
+
+// Non-blocking sockets. Each returns a file descriptor or -1 on error.
+int ListenUnix(const char *path);
+int ListenTcp(int port);
+int ConnectUnix(const char *path);
+int ConnectTcp(int port);
+
+int AcceptClient(int listen_fd);
+bool SetNonBlocking(int fd);
+
+#endif
@@ -0,0 +1,477 @@
+#include "pc_solver.h"
+#include "movegen.h"
+#include "piece.h"
+#include "trace.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstdlib>
+
+// Kinds I to T, one bit each
+static const int FULL_BAG = 0xfe;
+
+// Probabilities are stored in the table as fixed point
+static const double VALUE_SCALE = double(uint64_t(1) << 40);
+
+struct PcSolver::State {
+    Field field;
+
+    // Lines below limit are the ones left to clear
+    int limit = 0;
+    int hold = E;
+    bool is_hold_used = false;
+
+    // Known pieces after the current one, then draws from the bag
+    const int *queue = nullptr;
+    int queue_count = 0;
+    int bag_mask = 0;
+
+    int pieces_left = 0;
+};
+
+struct PcSolver::Move {
+    bool use_hold = false;
+
+    // Kind E when the move only holds
+    Tetromino placement;
+    State next;
+};
+
+struct PcSolver::Context {
+    MoveGenerator<SRS> generator;
+
+    // One list for each count of pieces left, since deeper calls reuse the others
+    std::vector<std::vector<Tetromino>> placements;
+};
+
+// Nothing rests above limit, so a piece starting just over it reaches the
+// same spots as one from SPAWN_POS with a much smaller search
+static Tetromino get_start(int kind, int limit)
+{
+    Tetromino start(kind, Point(SPAWN_POS.x, std::min(SPAWN_POS.y, limit + 2)));
+    start.rotation = SRS::SPAWN_ROTATIONS[kind];
+    return start;
+}
+
+PcQuery MakePcQuery(const Tetris &tetris, int height, int max_pieces)
+{
+    PcQuery query;
+    query.height = height;
+    query.max_pieces = max_pieces;
+
+    query.field = tetris.GetField();
+    if (query.field.GetClearedLineCount() > 0)
+        query.field.ClearLines();
+
+    query.current = tetris.GetTetrominoKind();
+    query.hold = tetris.GetHoldPiece().kind;
+
+    for (int i = 0; i < tetris.GetNextPieceCount(); i++) {
+        const int kind = tetris.GetPieceKindList(i);
+        if (kind == E)
+            break;
+        query.preview.push_back(kind);
+    }
+
+    // The bag holds the rest of the current 7-bag and all of the next one
+    int bag_size = 0;
+    while (tetris.GetPieceKindList(bag_size) != E)
+        bag_size++;
+
+    const int preview_count = query.preview.size();
+    const int bag_end = preview_count < bag_size - 7 ? bag_size - 7 : bag_size;
+    for (int i = preview_count; i < bag_end; i++)
+        query.bag_mask |= 1 << tetris.GetPieceKindList(i);
+
+    return query;
+}
+
+PcSolver::PcSolver()
+    : table_(new TranspositionTable(20))
+{
+}
+
+PcSolver::~PcSolver()
+{
+}
+
+void PcSolver::SetThreadCount(int count)
+{
+    thread_count_ = std::max(1, count);
+}
+
+void PcSolver::SetNodeLimit(uint64_t limit)
+{
+    node_limit_ = limit;
+}
+
+uint64_t PcSolver::GetNodeCount() const
+{
+    return node_count_.load(std::memory_order_relaxed);
+}
+
+const TranspositionTable &PcSolver::GetTable() const
+{
+    return *table_;
+}
+
+bool PcSolver::is_out_of_nodes() const
+{
+    return node_limit_ > 0 && GetNodeCount() >= node_limit_;
+}
+
+bool PcSolver::can_prune(const State &state, int current) const
+{
+    // Empty cells left to fill, and how many more are in even columns
+    int empty_count = 0;
+    int parity = 0;
+
+    for (int x = 0; x < FIELD_WIDTH; x++) {
+        if (state.field.GetColumnHeight(x) > state.limit)
+            return true;
+
+        for (int y = 0; y < state.limit; y++) {
+            if (IsEmptyTile(state.field.GetTileKind(Point(x, y)))) {
+                empty_count++;
+                parity += x % 2 ? -1 : 1;
+            }
+        }
+    }
+
+    if (empty_count % 4 != 0)
+        return true;
+
+    const int needed = empty_count / 4;
+    if (needed > state.pieces_left)
+        return true;
+
+    // Most of each kind that could still be placed, counting current, the
+    // piece about to be placed at the root
+    int counts[8] = {0};
+    int known_count = 0;
+
+    if (current != E) {
+        counts[current]++;
+        known_count++;
+    }
+
+    if (state.hold != E) {
+        counts[state.hold]++;
+        known_count++;
+    }
+    for (int i = 0; i < state.queue_count && known_count <= state.pieces_left; i++) {
+        counts[state.queue[i]]++;
+        known_count++;
+    }
+
+    const int unseen_count = state.pieces_left + 1 - known_count;
+    if (unseen_count > 0) {
+        const int mask = state.bag_mask ? state.bag_mask : FULL_BAG;
+        const int first_bag = std::bitset<8>(mask).count();
+        const int fresh_bags = (std::max(0, unseen_count - first_bag) + 6) / 7;
+
+        for (int kind = I; kind <= T; kind++)
+            counts[kind] += (mask >> kind & 1) + fresh_bags;
+    }
+
+    // Line clears keep the column parity, and only I (by 4 when upright),
+    // L and J (by 2 always) and T (by 2 when upright, 0 when flat) change it
+    const int i_count = std::min(needed, counts[I]);
+    const int tlj_count = std::min(needed, counts[T] + counts[L] + counts[J]);
+
+    if (std::abs(parity) > 4 * i_count + 2 * tlj_count)
+        return true;
+    if (parity % 4 != 0 && tlj_count == 0)
+        return true;
+
+    return false;
+}
+
+double PcSolver::get_value(Context &ctx, const State &state)
+{
+    if (state.field.IsEmpty())
+        return 1;
+    if (state.pieces_left <= 0 || is_out_of_nodes() || can_prune(state, E))
+        return 0;
+
+    // Everything the outcome depends on besides the board
+    int queue[16];
+    int count = 0;
+    const int queue_count = std::min({state.queue_count, state.pieces_left + 1, 12});
+
+    for (int i = 0; i < queue_count; i++)
+        queue[count++] = state.queue[i];
+    queue[count++] = 8 + state.bag_mask;
+    queue[count++] = 512 + state.limit;
+    queue[count++] = 1024 + state.pieces_left;
+    queue[count++] = 2048 + state.is_hold_used;
+
+    const uint64_t key = state.field.GetHash() ^ HashQueue(queue, count, state.hold);
+    uint64_t stored = 0;
+
+    if (table_->Probe(key, 0, stored))
+        return stored / VALUE_SCALE;
+
+    double value = 0;
+
+    if (state.queue_count > 0) {
+        State next = state;
+        next.queue++;
+        next.queue_count--;
+        value = get_best_move(ctx, next, state.queue[0], nullptr);
+    }
+    else {
+        // Each kind left in the bag is as likely to come next
+        const int mask = state.bag_mask ? state.bag_mask : FULL_BAG;
+        int kind_count = 0;
+
+        for (int kind = I; kind <= T; kind++) {
+            if (!(mask >> kind & 1))
+                continue;
+
+            State next = state;
+            next.bag_mask = mask & ~(1 << kind);
+            value += get_best_move(ctx, next, kind, nullptr);
+            kind_count++;
+        }
+        value /= kind_count;
+    }
+
+    // Cut off searches undercount, so they are not kept
+    if (!is_out_of_nodes())
+        table_->Store(key, state.pieces_left, uint64_t(value * VALUE_SCALE));
+
+    return value;
+}
+
+double PcSolver::get_best_move(Context &ctx, const State &state, int current, Move *best)
+{
+    double value = get_best_placement(ctx, state, current, best);
+
+    if (value >= 1 || state.is_hold_used)
+        return value;
+
+    if (state.hold == E) {
+        // Holding into an empty slot brings in the next piece
+        State held = state;
+        held.hold = current;
+        held.is_hold_used = true;
+
+        const double held_value = get_value(ctx, held);
+        if (held_value > value) {
+            value = held_value;
+            if (best) {
+                best->use_hold = true;
+                best->placement = Tetromino();
+                best->next = held;
+            }
+        }
+    }
+    else if (state.hold != current) {
+        State swapped = state;
+        swapped.hold = current;
+
+        Move move;
+        const double swapped_value =
+            get_best_placement(ctx, swapped, state.hold, best ? &move : nullptr);
+        if (swapped_value > value) {
+            value = swapped_value;
+            if (best) {
+                *best = move;
+                best->use_hold = true;
+            }
+        }
+    }
+
+    return value;
+}
+
+double PcSolver::get_best_placement(Context &ctx, const State &state, int kind, Move *best)
+{
+    node_count_.fetch_add(1, std::memory_order_relaxed);
+    if (is_out_of_nodes())
+        return 0;
+
+    std::vector<Tetromino> &placements = ctx.placements[state.pieces_left - 1];
+    ctx.generator.Generate(state.field, get_start(kind, state.limit), placements);
+
+    double best_value = 0;
+
+    for (const Tetromino &placement: placements) {
+        Piece piece = GetPiece(placement.kind, placement.rotation);
+        bool is_inside = true;
+
+        for (auto &tile: piece.tiles) {
+            tile += placement.pos;
+            if (tile.y >= state.limit)
+                is_inside = false;
+        }
+        if (!is_inside)
+            continue;
+
+        State next = state;
+        next.field.SetPiece(piece);
+        next.limit -= next.field.GetClearedLineCount();
+        if (next.field.GetClearedLineCount() > 0)
+            next.field.ClearLines();
+        next.is_hold_used = false;
+        next.pieces_left--;
+
+        const double value = get_value(ctx, next);
+        if (value > best_value) {
+            best_value = value;
+            if (best) {
+                best->use_hold = false;
+                best->placement = placement;
+                best->next = next;
+            }
+        }
+
+        if (best_value >= 1)
+            break;
+    }
+
+    return best_value;
+}
+
+void PcSolver::follow_plan(Context &ctx, State state, std::vector<Tetromino> &plan)
+{
+    // Stops where the next piece is up to the bag
+    while (!state.field.IsEmpty() && state.queue_count > 0 && state.pieces_left > 0) {
+        const int kind = state.queue[0];
+        state.queue++;
+        state.queue_count--;
+
+        Move move;
+        if (get_best_move(ctx, state, kind, &move) <= 0)
+            break;
+
+        if (move.placement.kind != E)
+            plan.push_back(move.placement);
+        state = move.next;
+    }
+}
+
+std::vector<PcSolution> PcSolver::Solve(const PcQuery &query)
+{
+    TET_TRACE_SCOPE("PcSolver::Solve");
+
+    node_count_ = 0;
+    table_->NewGeneration();
+
+    State root;
+    root.field = query.field;
+    root.limit = query.height;
+    root.hold = query.hold;
+    root.queue = query.preview.data();
+    root.queue_count = query.preview.size();
+    root.bag_mask = query.bag_mask;
+    root.pieces_left = query.max_pieces;
+
+    std::vector<PcSolution> solutions;
+
+    if (query.current == E || root.pieces_left <= 0 || can_prune(root, query.current))
+        return solutions;
+
+    // First moves: every placement of the current piece, of the one
+    // swapped in from hold, or holding and waiting for the next one
+    struct RootMove {
+        bool use_hold;
+        int kind;
+        State state;
+    };
+    std::vector<RootMove> moves;
+    moves.push_back({false, query.current, root});
+
+    State held = root;
+    held.hold = query.current;
+    if (query.hold == E) {
+        held.is_hold_used = true;
+        moves.push_back({true, E, held});
+    }
+    else if (query.hold != query.current) {
+        moves.push_back({true, query.hold, held});
+    }
+
+    struct Task {
+        bool use_hold;
+        Tetromino placement;
+        State state;
+    };
+    std::vector<Task> tasks;
+    MoveGenerator<SRS> generator;
+    std::vector<Tetromino> placements;
+
+    for (const RootMove &move: moves) {
+        if (move.kind == E) {
+            tasks.push_back({move.use_hold, Tetromino(), move.state});
+            continue;
+        }
+
+        generator.Generate(root.field, get_start(move.kind, root.limit), placements);
+
+        for (const Tetromino &placement: placements)
+            tasks.push_back({move.use_hold, placement, move.state});
+    }
+
+    // Threads take first moves in turn and share the table
+    std::vector<PcSolution> results(tasks.size());
+    std::atomic<size_t> next_task {0};
+
+    auto work = [&]() {
+        Context ctx;
+        ctx.placements.resize(query.max_pieces);
+
+        for (;;) {
+            const size_t index = next_task.fetch_add(1);
+            if (index >= tasks.size())
+                break;
+
+            const Task &task = tasks[index];
+            PcSolution &result = results[index];
+            State next = task.state;
+
+            result.use_hold = task.use_hold;
+
+            if (task.placement.kind != E) {
+                Piece piece = GetPiece(task.placement.kind, task.placement.rotation);
+                bool is_inside = true;
+
+                for (auto &tile: piece.tiles) {
+                    tile += task.placement.pos;
+                    if (tile.y >= next.limit)
+                        is_inside = false;
+                }
+                if (!is_inside)
+                    continue;
+
+                next.field.SetPiece(piece);
+                next.limit -= next.field.GetClearedLineCount();
+                if (next.field.GetClearedLineCount() > 0)
+                    next.field.ClearLines();
+                next.is_hold_used = false;
+                next.pieces_left--;
+
+                result.placements.push_back(task.placement);
+            }
+
+            result.probability = get_value(ctx, next);
+            if (result.probability > 0)
+                follow_plan(ctx, next, result.placements);
+        }
+    };
+
+    GetWorkerPool().Run(thread_count_, work);
+
+    for (auto &result: results) {
+        if (result.probability > 0)
+            solutions.push_back(result);
+    }
+    std::stable_sort(solutions.begin(), solutions.end(),
+            [](const PcSolution &a, const PcSolution &b) {
+                return a.probability > b.probability;
+            });
+
+    return solutions;
+}
@@ -0,0 +1,83 @@
+#ifndef PC_SOLVER_H
+#define PC_SOLVER_H
+
+#include "tetris.h"
+#include "tetromino.h"
+#include "transposition.h"
+#include "field.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// What a player knows when looking for a perfect clear
+struct PcQuery {
+    Field field;
+    int current = E;
+    int hold = E;
+    std::vector<int> preview;
+
+    // Kinds (bit 1 << kind) still to come from the bag of the last preview
+    // piece. 0 means the next unseen piece starts a new bag.
+    int bag_mask = 0;
+
+    // Lines to clear, and pieces to do it with
+    int height = 4;
+    int max_pieces = 10;
+};
+
+// Builds a query from the field, pieces and bag a player of tetris can see
+PcQuery MakePcQuery(const Tetris &tetris, int height, int max_pieces);
+
+struct PcSolution {
+    // The first move places the held piece, or holds and places the next one
+    bool use_hold = false;
+
+    // The plan while pieces are known, first placement first
+    std::vector<Tetromino> placements;
+
+    // Chance of clearing the field over every order the 7-bag may deal
+    // the unseen pieces in, playing the best move as each one shows up
+    double probability = 0;
+};
+
+// Searches perfect clears with the SRS move generator. Placements that
+// lead to the same board, hold and queue are solved once through a shared
+// transposition table, and first moves are spread over the threads of
+// the shared WorkerPool.
+class PcSolver {
+public:
+    PcSolver();
+    ~PcSolver();
+
+    void SetThreadCount(int count);
+
+    // Stops searching after this many nodes, so answers fit a time budget.
+    // Cut off branches count as failures. 0 means no limit.
+    void SetNodeLimit(uint64_t limit);
+
+    // Solutions best first, without the ones that never clear
+    std::vector<PcSolution> Solve(const PcQuery &query);
+
+    uint64_t GetNodeCount() const;
+    const TranspositionTable &GetTable() const;
+
+private:
+    struct State;
+    struct Move;
+    struct Context;
+
+    int thread_count_ = 1;
+    uint64_t node_limit_ = 0;
+    std::atomic<uint64_t> node_count_ {0};
+    std::unique_ptr<TranspositionTable> table_;
+
+    bool is_out_of_nodes() const;
+    bool can_prune(const State &state, int current) const;
+    double get_value(Context &ctx, const State &state);
+    double get_best_move(Context &ctx, const State &state, int current, Move *best);
+    double get_best_placement(Context &ctx, const State &state, int kind, Move *best);
+    void follow_plan(Context &ctx, State state, std::vector<Tetromino> &plan);
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "movegen.h"
+#include "tetris.h"
+#include "log.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: tetris-perft [-d depth] [-s seed] [-g lines] [-r rules] [-t bits] [-H]\n"
+            "  -d depth        pieces to place (default: 3)\n"
+            "  -s seed         random seed for the bag and garbage (default: 1)\n"
+            "  -g lines        garbage lines on the board (default: 0)\n"
+            "  -r rules        srs, ars or nrs (default: srs)\n"
+            "  -t bits         transposition table of 2^bits entries (default: off)\n"
+            "  -H              allow hold\n");
+}
+
+template <typename Rules>
+static void run(const Field &field, const int *kinds, int depth, bool use_hold,
+        TranspositionTable *table)
+{
+    MoveGenerator<Rules> generator;
+    generator.SetHoldEnable(use_hold);
+    generator.SetTranspositionTable(table);
+
+    for (int d = 1; d <= depth; d++) {
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t count = generator.Perft(field, kinds, d);
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        printf("depth %d: %llu placements, %.3f s, %.0f nodes/s\n",
+                d, (unsigned long long) count, elapsed.count(),
+                elapsed.count() > 0 ? count / elapsed.count() : 0.);
+    }
+
+    if (table)
+        table->PrintStats(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    int depth = 3;
+    unsigned int seed = 1;
+    int garbage_count = 0;
+    const char *rules = "srs";
+    int table_bits = 0;
+    bool use_hold = false;
+
+    // Arguments
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            depth = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            seed = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "-g") && i + 1 < argc) {
+            garbage_count = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            rules = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            table_bits = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-H")) {
+            use_hold = true;
+        }
+        else {
+            fprintf(stderr, "error: unknown option: %s\n", argv[i]);
+            usage();
+            return 1;
+        }
+    }
+
+    if (depth < 1 || depth > 8 || garbage_count < 0 || garbage_count >= FIELD_HEIGHT ||
+        table_bits < 0 || table_bits > 30) {
+        usage();
+        return 1;
+    }
+
+    EnableLog(false);
+
+    // The pieces a seeded game deals
+    Tetris tetris;
+    tetris.SetRandomSeed(seed);
+    tetris.PlayGame();
+    tetris.UpdateFrame(0);
+
+    std::vector<int> kinds = {tetris.GetTetrominoKind()};
+    for (int i = 0; i < depth; i++)
+        kinds.push_back(tetris.GetPieceKindList(i));
+
+    // Board
+    Field field;
+
+    std::minstd_rand rng(seed);
+    std::uniform_int_distribution<int> hole_x(0, FIELD_WIDTH - 1);
+    for (int i = 0; i < garbage_count; i++)
+        field.InsertGarbageLine(hole_x(rng));
+
+    std::unique_ptr<TranspositionTable> table;
+    if (table_bits > 0)
+        table.reset(new TranspositionTable(table_bits));
+
+    printf("seed: %u, garbage: %d, rules: %s, hold: %s, pieces:",
+            seed, garbage_count, rules, use_hold ? "on" : "off");
+    for (int i = 0; i < depth + use_hold; i++)
+        printf(" %c", "EIOSZJLT"[kinds[i]]);
+    printf("\n");
+
+    if (!strcmp(rules, "srs")) {
+        run<SRS>(field, kinds.data(), depth, use_hold, table.get());
+    }
+    else if (!strcmp(rules, "ars")) {
+        run<ARS>(field, kinds.data(), depth, use_hold, table.get());
+    }
+    else if (!strcmp(rules, "nrs")) {
+        run<NRS>(field, kinds.data(), depth, use_hold, table.get());
+    }
+    else {
+        usage();
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,4 +1,6 @@
 #include "piece.h"
+#include <cassert>
+#include <mutex>
 
 static const char piece_data[9][4][4] =
 {
@@ -99,7 +101,7 @@ static void init_piece(int kind, int rotation)
     }
 };
 
-void InitializePieces()
+static void init_all_pieces()
 {
     // loop over all tetrominoes
     for (int kind = E; kind < T_CORNERS; kind++)
@@ -112,9 +114,16 @@ void InitializePieces()
         init_piece(T_CORNERS, rot);
 }
 
+void InitializePieces()
+{
+    // Games on different threads may start at the same time
+    static std::once_flag once;
+    std::call_once(once, init_all_pieces);
+}
+
 Piece GetPiece(int kind, int rotation)
 {
-    assert(IsValidTile(kind));
+    assert(IsEmptyTile(kind) || IsSolidTile(kind));
     assert(rotation >= 0 && rotation < 4);
 
     return piece_states[kind][rotation];
@@ -137,7 +146,12 @@ bool IsSolidTile(int kind)
     return kind > E && kind < T_CORNERS;
 }
 
+bool IsGarbageTile(int kind)
+{
+    return kind == G;
+}
+
 bool IsValidTile(int kind)
 {
-    return IsEmptyTile(kind) || IsSolidTile(kind);
+    return IsEmptyTile(kind) || IsSolidTile(kind) || IsGarbageTile(kind);
 }
@@ -9,6 +9,7 @@ enum TileKind {
     E = 0, // empty
     I, O, S, Z, J, L, T,
     T_CORNERS,
+    G, // garbage
 };
 
 struct Piece {
@@ -19,6 +20,7 @@ struct Piece {
 // Tile kind
 bool IsEmptyTile(int kind);
 bool IsSolidTile(int kind);
+bool IsGarbageTile(int kind);
 bool IsValidTile(int kind);
 
 // Piece
@@ -4,8 +4,8 @@
 struct Point {
     int x, y;
 
-    Point() : x(0), y(0) {}
-    Point(int xx, int yy) : x(xx), y(yy) {}
+    constexpr Point() : x(0), y(0) {}
+    constexpr Point(int xx, int yy) : x(xx), y(yy) {}
 
     const Point &operator+=(Point a)
     {
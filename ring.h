@@ -0,0 +1,103 @@
+#ifndef RING_H
+#define RING_H
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+
+// Fixed capacity double-ended queue that never allocates.
+// Pushing to a full ring drops the oldest element.
+template <typename T, size_t N>
+class Ring {
+public:
+    void Clear()
+    {
+        head_ = 0;
+        size_ = 0;
+    }
+
+    size_t Size() const { return size_; }
+    bool IsEmpty() const { return size_ == 0; }
+    bool IsFull() const { return size_ == N; }
+
+    T &PushBack()
+    {
+        if (IsFull())
+            PopFront();
+
+        size_++;
+        return (*this)[size_ - 1];
+    }
+
+    void PushBack(const T &value)
+    {
+        PushBack() = value;
+    }
+
+    void PopFront()
+    {
+        head_ = (head_ + 1) % N;
+        size_--;
+    }
+
+    T &Front() { return (*this)[0]; }
+    const T &Front() const { return (*this)[0]; }
+
+    T &operator[](size_t i) { return elems_[(head_ + i) % N]; }
+    const T &operator[](size_t i) const { return elems_[(head_ + i) % N]; }
+
+private:
+    std::array<T, N> elems_ {};
+    size_t head_ = 0;
+    size_t size_ = 0;
+};
+
+// Lock-free queue for one producer thread and one consumer thread.
+// N must be a power of two.
+template <typename T, size_t N>
+class SpscRing {
+public:
+    static_assert((N & (N - 1)) == 0, "N must be a power of two");
+
+    SpscRing() {}
+    ~SpscRing() {}
+
+    bool Push(const T &value)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+
+        if (tail - head == N)
+            return false;
+
+        elems_[tail & (N - 1)] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T &value)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+
+        if (head == tail)
+            return false;
+
+        value = elems_[head & (N - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool IsEmpty() const
+    {
+        return head_.load(std::memory_order_acquire) ==
+               tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, N> elems_;
+    std::atomic<size_t> head_ {0};
+    std::atomic<size_t> tail_ {0};
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include "rollout.h"
+#include "trace.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+// Seeds far apart for neighboring futures
+static unsigned int get_future_seed(unsigned int seed, int index)
+{
+    uint32_t x = seed + 0x9e3779b9u * (uint32_t) (index + 1);
+    x = (x ^ (x >> 16)) * 0x85ebca6bu;
+    x = (x ^ (x >> 13)) * 0xc2b2ae35u;
+    return x ^ (x >> 16);
+}
+
+static RolloutStat get_stat(const double *values, int count)
+{
+    RolloutStat stat;
+
+    for (int i = 0; i < count; i++)
+        stat.mean += values[i];
+    stat.mean /= count;
+
+    if (count < 2)
+        return stat;
+
+    for (int i = 0; i < count; i++)
+        stat.variance += (values[i] - stat.mean) * (values[i] - stat.mean);
+    stat.variance /= count - 1;
+
+    return stat;
+}
+
+RolloutEvaluator::RolloutEvaluator()
+{
+}
+
+RolloutEvaluator::~RolloutEvaluator()
+{
+}
+
+void RolloutEvaluator::SetThreadCount(int count)
+{
+    thread_count_ = std::max(1, count);
+}
+
+void RolloutEvaluator::SetWeights(const BotWeights &weights)
+{
+    weights_ = weights;
+}
+
+void RolloutEvaluator::SetRolloutCount(int count)
+{
+    rollout_count_ = std::max(1, count);
+}
+
+void RolloutEvaluator::SetPieceLimit(int count)
+{
+    piece_limit_ = std::max(0, count);
+}
+
+void RolloutEvaluator::SetRandomSeed(unsigned int seed)
+{
+    seed_ = seed;
+}
+
+void RolloutEvaluator::Evaluate(const Tetris &tetris, const BotMove *moves, int count,
+        std::vector<RolloutResult> &results)
+{
+    TET_TRACE_SCOPE("RolloutEvaluator::Evaluate");
+
+    results.assign(count, RolloutResult());
+    if (count <= 0)
+        return;
+
+    // Every future of a candidate starts from a copy of the game it left,
+    // which keeps its imagined frames out of the crash log
+    std::vector<Tetris> starts(count, tetris);
+    for (int i = 0; i < count; i++) {
+        starts[i].EnableLog(false);
+        PlaceBotMove(starts[i], moves[i]);
+    }
+
+    const int task_count = count * rollout_count_;
+    std::vector<double> scores(task_count);
+    std::vector<double> lines(task_count);
+    std::vector<double> survivals(task_count);
+    std::atomic<int> next_task {0};
+
+    auto work = [&]() {
+        Tetris game;
+        Bot policy;
+        policy.SetWeights(weights_);
+
+        for (;;) {
+            const int index = next_task.fetch_add(1);
+            if (index >= task_count)
+                break;
+
+            const int candidate = index / rollout_count_;
+            game = starts[candidate];
+            game.ShuffleHiddenPieces(get_future_seed(seed_, index % rollout_count_));
+
+            int piece_count = game.IsGameOver() ? 0 : 1;
+            while (piece_count > 0 && piece_count <= piece_limit_ && PlayBotMove(policy, game, 1))
+                piece_count++;
+
+            // Scores the clear of the last piece
+            if (!game.IsGameOver())
+                game.UpdateFrame(0);
+
+            scores[index] = game.GetScore() - tetris.GetScore();
+            lines[index] = game.GetTotalLineCount() - tetris.GetTotalLineCount();
+            survivals[index] = piece_count;
+        }
+    };
+
+    GetWorkerPool().Run(thread_count_, work);
+
+    for (int i = 0; i < count; i++) {
+        const int offset = i * rollout_count_;
+        results[i].score = get_stat(&scores[offset], rollout_count_);
+        results[i].lines = get_stat(&lines[offset], rollout_count_);
+        results[i].survival = get_stat(&survivals[offset], rollout_count_);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+#include "tetris.h"
+#include "bot.h"
+#include <vector>
+
+struct RolloutStat {
+    double mean = 0;
+    double variance = 0;
+};
+
+// What the futures after one candidate came to, each measured from the
+// position the candidate was played in
+struct RolloutResult {
+    RolloutStat score;
+    RolloutStat lines;
+
+    // Pieces placed before topping out, the candidate included, up to the
+    // piece limit plus one
+    RolloutStat survival;
+};
+
+// Scores candidate moves by playing many random futures after each. A
+// future is a copy of the game with the pieces past the preview reshuffled
+// under its own seed, played by a Bot searching one piece deep.
+// Future k gets the same seed for every candidate, so differences between
+// candidates aren't drowned in the luck of the bags.
+class RolloutEvaluator {
+public:
+    RolloutEvaluator();
+    ~RolloutEvaluator();
+
+    void SetThreadCount(int count);
+    void SetWeights(const BotWeights &weights);
+
+    // Futures per candidate, 32 by default
+    void SetRolloutCount(int count);
+
+    // Pieces each future plays after the candidate, 50 by default
+    void SetPieceLimit(int count);
+
+    void SetRandomSeed(unsigned int seed);
+
+    // Plays each move from where tetris stands, with its piece at spawn as
+    // Bot expects, then rolls out its futures. One result per move.
+    void Evaluate(const Tetris &tetris, const BotMove *moves, int count,
+            std::vector<RolloutResult> &results);
+
+private:
+    int thread_count_ = 1;
+    BotWeights weights_;
+    int rollout_count_ = 32;
+    int piece_limit_ = 50;
+    unsigned int seed_ = 0;
+};
+
+#endif
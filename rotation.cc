@@ -0,0 +1,13 @@
+#include "rotation.h"
+
+// Out-of-class definitions for the tables used at run time
+constexpr int SRS::SPAWN_ROTATIONS[];
+constexpr int SRS::TABLES[];
+constexpr Point SRS::OFFSETS[][4][SRS::KICK_COUNT];
+
+constexpr int ARS::SPAWN_ROTATIONS[];
+constexpr Point ARS::STATES[][4];
+constexpr Point ARS::KICKS[][ARS::KICK_COUNT];
+
+constexpr int NRS::SPAWN_ROTATIONS[];
+constexpr Point NRS::STATES[][4];
@@ -0,0 +1,123 @@
+#ifndef ROTATION_H
+#define ROTATION_H
+
+#include "point.h"
+#include "piece.h"
+
+// Rotation systems for BasicTetris. Each one bundles the orientation pieces
+// spawn in, the kick offsets tried when rotating and whether T-spins count.
+//
+// GetPiece rotates pieces about the tile at their origin. Test i of a
+// rotation from old_rotation to new_rotation moves the piece by
+// GetKickOffset(kind, old_rotation, new_rotation, i), so every kind reads
+// its own table row and nothing branches on kind or rotation.
+
+// TTC's super rotation system.
+// https://tetris.wiki/Super_Rotation_System
+struct SRS {
+    static constexpr int KICK_COUNT = 5;
+    static constexpr bool HAS_TSPIN = true;
+
+    static constexpr int SPAWN_ROTATIONS[T_CORNERS] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+    // Offset table each kind uses
+    static constexpr int TABLES[T_CORNERS] = {0, 1, 2, 0, 0, 0, 0, 0};
+
+    static constexpr Point OFFSETS[3][4][KICK_COUNT] = {
+        // S Z J L T
+        {
+            {{ 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}},
+            {{ 0, 0}, {+1, 0}, {+1,-1}, { 0,+2}, {+1,+2}},
+            {{ 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}},
+            {{ 0, 0}, {-1, 0}, {-1,-1}, { 0,+2}, {-1,+2}},
+        },
+        // I
+        {
+            {{ 0, 0}, {-1, 0}, {+2, 0}, {-1, 0}, {+2, 0}},
+            {{-1, 0}, { 0, 0}, { 0, 0}, { 0,+1}, { 0,-2}},
+            {{-1,+1}, {+1,+1}, {-2,+1}, {+1, 0}, {-2, 0}},
+            {{ 0,+1}, { 0,+1}, { 0,+1}, { 0,-1}, { 0,+2}},
+        },
+        // O
+        {
+            {{ 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}},
+            {{ 0,-1}, { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}},
+            {{-1,-1}, { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}},
+            {{-1, 0}, { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}},
+        },
+    };
+
+    static Point GetKickOffset(int kind, int old_rotation, int new_rotation, int test)
+    {
+        const int table = TABLES[kind];
+        return OFFSETS[table][old_rotation][test] - OFFSETS[table][new_rotation][test];
+    }
+};
+
+// Arika's rotation system from the TGM series. Pieces rest on the bottom of
+// their box, T, J and L spawn flat side up, and I, S and Z have two states.
+// A blocked rotation tries one cell right, then one left, except for I.
+// There are no T-spins.
+// https://tetris.wiki/Arika_Rotation_System
+struct ARS {
+    static constexpr int KICK_COUNT = 3;
+    static constexpr bool HAS_TSPIN = false;
+
+    static constexpr int SPAWN_ROTATIONS[T_CORNERS] = {0, 0, 0, 0, 0, 2, 2, 2};
+
+    // Where each rotation sits relative to the one GetPiece gives
+    static constexpr Point STATES[T_CORNERS][4] = {
+        {},                                         // E
+        {{ 0, 0}, {+1, 0}, {+1, 0}, {+1,-1}},       // I
+        {{ 0, 0}, { 0,+1}, {+1,+1}, {+1, 0}},       // O
+        {{ 0,-1}, {-1, 0}, { 0, 0}, { 0, 0}},       // S
+        {{ 0,-1}, {-1, 0}, { 0, 0}, { 0, 0}},       // Z
+        {{ 0,-1}, { 0, 0}, { 0, 0}, { 0, 0}},       // J
+        {{ 0,-1}, { 0, 0}, { 0, 0}, { 0, 0}},       // L
+        {{ 0,-1}, { 0, 0}, { 0, 0}, { 0, 0}},       // T
+    };
+
+    static constexpr Point KICKS[T_CORNERS][KICK_COUNT] = {
+        {},                                         // E
+        {{ 0, 0}, { 0, 0}, { 0, 0}},                // I
+        {{ 0, 0}, {+1, 0}, {-1, 0}},                // O
+        {{ 0, 0}, {+1, 0}, {-1, 0}},                // S
+        {{ 0, 0}, {+1, 0}, {-1, 0}},                // Z
+        {{ 0, 0}, {+1, 0}, {-1, 0}},                // J
+        {{ 0, 0}, {+1, 0}, {-1, 0}},                // L
+        {{ 0, 0}, {+1, 0}, {-1, 0}},                // T
+    };
+
+    static Point GetKickOffset(int kind, int old_rotation, int new_rotation, int test)
+    {
+        return STATES[kind][new_rotation] - STATES[kind][old_rotation] + KICKS[kind][test];
+    }
+};
+
+// Nintendo's rotation system from the NES game. Like ARS, but S and Z turn
+// right of center and a blocked rotation simply fails.
+// https://tetris.wiki/Nintendo_Rotation_System
+struct NRS {
+    static constexpr int KICK_COUNT = 1;
+    static constexpr bool HAS_TSPIN = false;
+
+    static constexpr int SPAWN_ROTATIONS[T_CORNERS] = {0, 0, 0, 0, 0, 2, 2, 2};
+
+    static constexpr Point STATES[T_CORNERS][4] = {
+        {},                                         // E
+        {{ 0, 0}, {+1, 0}, {+1, 0}, {+1,-1}},       // I
+        {{ 0, 0}, { 0,+1}, {+1,+1}, {+1, 0}},       // O
+        {{ 0,-1}, { 0, 0}, { 0, 0}, {+1, 0}},       // S
+        {{ 0,-1}, { 0, 0}, { 0, 0}, {+1, 0}},       // Z
+        {},                                         // J
+        {},                                         // L
+        {},                                         // T
+    };
+
+    static Point GetKickOffset(int kind, int old_rotation, int new_rotation, int)
+    {
+        return STATES[kind][new_rotation] - STATES[kind][old_rotation];
+    }
+};
+
+#endif
@@ -0,0 +1,304 @@
+#include "royale.h"
+#include <algorithm>
+#include <cassert>
+
+static const int64_t FRAME_BUDGET_NANOSEC = 1000000000 / 60;
+
+// Targets are picked again once a second, or when a target is knocked out
+static const int RETARGET_FRAME_COUNT = 60;
+
+static int get_stack_height(const GameBatch &boards, int player)
+{
+    for (int y = FIELD_HEIGHT - 1; y >= 0; y--)
+        for (int x = 0; x < FIELD_WIDTH; x++)
+            if (!IsEmptyTile(boards.GetFieldTileKind(player, Point(x, y))))
+                return y + 1;
+
+    return 0;
+}
+
+// Attack bonus in quarters for the attacker's KOs
+static int get_badge_bonus(int ko_count)
+{
+    static const int ko_counts[] = {2, 6, 14, 30};
+    int bonus = 0;
+
+    for (auto count: ko_counts)
+        bonus += ko_count >= count;
+
+    return bonus;
+}
+
+Royale::Royale()
+{
+}
+
+Royale::~Royale()
+{
+}
+
+void Royale::Start(int player_count, unsigned int seed)
+{
+    assert(player_count > 0);
+
+    rng_.seed(seed);
+    boards_.reset(new GameBatch(player_count));
+
+    for (int i = 0; i < player_count; i++)
+        boards_->PlayGame(i, rng_());
+
+    is_alive_.assign(player_count, 1);
+    strategies_.assign(player_count, TARGET_RANDOM);
+    targets_.assign(player_count, -1);
+    danger_.assign(player_count, 0);
+    last_attackers_.assign(player_count, -1);
+    ko_counts_.assign(player_count, 0);
+    attack_sent_.assign(player_count, 0);
+    places_.assign(player_count, 0);
+
+    alive_count_ = player_count;
+    frame_ = 0;
+
+    tick_times_.Reset();
+    board_times_.Reset();
+    routing_times_.Reset();
+}
+
+void Royale::SetStrategy(int player, int strategy)
+{
+    assert(strategy >= 0 && strategy < TARGET_STRATEGY_COUNT);
+    strategies_[player] = strategy;
+}
+
+void Royale::UpdateFrame(const int *moves)
+{
+    const int count = GetPlayerCount();
+    PhaseTimer timer;
+
+    // Boards, where the knocked out ones are over and stay put
+    boards_->UpdateFrame(moves);
+
+    const int64_t board_time = timer.Lap();
+
+    // Knock-outs
+    for (int i = 0; i < count; i++)
+        if (is_alive_[i] && boards_->IsGameOver(i))
+            knock_out(i);
+
+    // Targets
+    if (frame_ % RETARGET_FRAME_COUNT == 0) {
+        update_danger();
+        update_targets();
+    }
+    else {
+        for (int i = 0; i < count; i++)
+            if (is_alive_[i] && (targets_[i] < 0 || !is_alive_[targets_[i]]))
+                targets_[i] = pick_target(i);
+    }
+
+    // Attacks
+    for (int i = 0; i < count; i++) {
+        if (!is_alive_[i])
+            continue;
+
+        const int attack = boards_->PopAttack(i);
+        if (attack > 0)
+            send_attack(i, attack);
+    }
+
+    const int64_t routing_time = timer.Lap();
+
+    board_times_.Add(board_time);
+    routing_times_.Add(routing_time);
+    tick_times_.Add(board_time + routing_time);
+
+    frame_++;
+}
+
+void Royale::update_danger()
+{
+    for (int i = 0; i < GetPlayerCount(); i++) {
+        if (is_alive_[i])
+            danger_[i] = get_stack_height(*boards_, i) + boards_->GetPendingGarbage(i);
+    }
+}
+
+void Royale::update_targets()
+{
+    for (int i = 0; i < GetPlayerCount(); i++) {
+        if (is_alive_[i])
+            targets_[i] = pick_target(i);
+    }
+}
+
+int Royale::pick_target(int player)
+{
+    const int count = GetPlayerCount();
+    int target = -1;
+
+    switch (strategies_[player]) {
+    case TARGET_ATTACKERS: {
+        int attacker_count = 0;
+
+        for (int i = 0; i < count; i++)
+            attacker_count += is_alive_[i] && targets_[i] == player;
+
+        if (attacker_count == 0)
+            break;
+
+        int nth = rng_() % attacker_count;
+
+        for (int i = 0; i < count && target < 0; i++) {
+            if (is_alive_[i] && targets_[i] == player && nth-- == 0)
+                target = i;
+        }
+        break;
+    }
+
+    case TARGET_KOS:
+        for (int i = 0; i < count; i++) {
+            if (i != player && is_alive_[i] && (target < 0 || danger_[i] > danger_[target]))
+                target = i;
+        }
+        break;
+
+    case TARGET_BADGES:
+        for (int i = 0; i < count; i++) {
+            if (i != player && is_alive_[i] && ko_counts_[i] > 0 &&
+                    (target < 0 || ko_counts_[i] > ko_counts_[target]))
+                target = i;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return target >= 0 ? target : pick_random_target(player);
+}
+
+int Royale::pick_random_target(int player)
+{
+    const int other_count = alive_count_ - (is_alive_[player] ? 1 : 0);
+
+    if (other_count <= 0)
+        return -1;
+
+    int nth = rng_() % other_count;
+
+    for (int i = 0; i < GetPlayerCount(); i++) {
+        if (i != player && is_alive_[i] && nth-- == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+void Royale::send_attack(int attacker, int attack)
+{
+    const int target = targets_[attacker];
+
+    if (target < 0 || !is_alive_[target])
+        return;
+
+    attack += attack * get_badge_bonus(ko_counts_[attacker]) / 4;
+
+    // One hole column per attack
+    boards_->ReceiveGarbage(target, attack, rng_() % FIELD_WIDTH);
+    last_attackers_[target] = attacker;
+    attack_sent_[attacker] += attack;
+}
+
+void Royale::knock_out(int player)
+{
+    is_alive_[player] = 0;
+    places_[player] = alive_count_--;
+
+    const int attacker = last_attackers_[player];
+    if (attacker >= 0 && is_alive_[attacker])
+        ko_counts_[attacker]++;
+
+    if (alive_count_ == 1)
+        places_[GetWinner()] = 1;
+}
+
+int Royale::GetPlayerCount() const
+{
+    return boards_ ? boards_->GetGameCount() : 0;
+}
+
+GameBatch &Royale::GetBoards()
+{
+    return *boards_;
+}
+
+const GameBatch &Royale::GetBoards() const
+{
+    return *boards_;
+}
+
+int Royale::GetTarget(int index) const
+{
+    return targets_[index];
+}
+
+int Royale::GetKoCount(int index) const
+{
+    return ko_counts_[index];
+}
+
+int Royale::GetAttackSent(int index) const
+{
+    return attack_sent_[index];
+}
+
+int Royale::GetPlace(int index) const
+{
+    return places_[index];
+}
+
+int Royale::GetAliveCount() const
+{
+    return alive_count_;
+}
+
+bool Royale::IsOver() const
+{
+    return alive_count_ <= (GetPlayerCount() > 1 ? 1 : 0);
+}
+
+int Royale::GetWinner() const
+{
+    if (!IsOver())
+        return -1;
+
+    for (int i = 0; i < GetPlayerCount(); i++)
+        if (is_alive_[i])
+            return i;
+
+    return -1;
+}
+
+unsigned long Royale::GetFrame() const
+{
+    return frame_;
+}
+
+const Histogram &Royale::GetTickTimes() const
+{
+    return tick_times_;
+}
+
+void Royale::PrintStats(FILE *fp) const
+{
+    fprintf(fp, "players: %d, alive: %d, frames: %lu\n",
+            GetPlayerCount(), alive_count_, frame_);
+    fprintf(fp, "tick p50: %lld ns, p99: %lld ns, max: %lld ns, over budget: %lld\n",
+            (long long) tick_times_.GetPercentile(50),
+            (long long) tick_times_.GetPercentile(99),
+            (long long) tick_times_.GetMax(),
+            (long long) tick_times_.GetCountAbove(FRAME_BUDGET_NANOSEC));
+    fprintf(fp, "  boards p99: %lld ns, routing p99: %lld ns\n",
+            (long long) board_times_.GetPercentile(99),
+            (long long) routing_times_.GetPercentile(99));
+}
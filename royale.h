@@ -0,0 +1,84 @@
+#ifndef ROYALE_H
+#define ROYALE_H
+
+#include "game_batch.h"
+#include "stats.h"
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+enum TargetStrategy {
+    TARGET_RANDOM,
+    TARGET_ATTACKERS, // whoever is targeting this player
+    TARGET_KOS,       // the player closest to topping out
+    TARGET_BADGES,    // the player with the most KOs
+    TARGET_STRATEGY_COUNT,
+};
+
+// Large lobby of versus games ticked in lockstep. Attacks go to a target
+// picked by each player's strategy, grow with the attacker's KOs, and a KO
+// is credited to whoever last sent garbage to the player who topped out.
+//
+// The boards are one GameBatch, and per-player routing state is kept the
+// same way, in one array per field, so the once per tick passes over every
+// player stay in contiguous memory.
+class Royale {
+public:
+    Royale();
+    ~Royale();
+
+    void Start(int player_count, unsigned int seed);
+    void SetStrategy(int player, int strategy);
+
+    // Takes one move per player
+    void UpdateFrame(const int *moves);
+
+    int GetPlayerCount() const;
+    GameBatch &GetBoards();
+    const GameBatch &GetBoards() const;
+    int GetTarget(int index) const;
+    int GetKoCount(int index) const;
+    int GetAttackSent(int index) const;
+    int GetPlace(int index) const;
+
+    int GetAliveCount() const;
+    bool IsOver() const;
+    int GetWinner() const;
+    unsigned long GetFrame() const;
+
+    const Histogram &GetTickTimes() const;
+    void PrintStats(FILE *fp) const;
+
+private:
+    std::unique_ptr<GameBatch> boards_;
+
+    // Per player
+    std::vector<uint8_t> is_alive_;
+    std::vector<uint8_t> strategies_;
+    std::vector<int> targets_;
+    std::vector<int> danger_;
+    std::vector<int> last_attackers_;
+    std::vector<int> ko_counts_;
+    std::vector<int> attack_sent_;
+    std::vector<int> places_;
+
+    int alive_count_ = 0;
+    unsigned long frame_ = 0;
+    std::minstd_rand rng_;
+
+    // Cost of each tick
+    Histogram tick_times_;
+    Histogram board_times_;
+    Histogram routing_times_;
+
+    void update_danger();
+    void update_targets();
+    int pick_target(int player);
+    int pick_random_target(int player);
+    void send_attack(int attacker, int attack);
+    void knock_out(int player);
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "royale.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Bots press a key every few frames, about as fast as a person
+static const int BOT_KEY_INTERVAL = 8;
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: tetris-royale [-n players] [-f frames] [-s seed] [-t strategy]\n"
+            "  -n players      boards in the lobby (default: 100)\n"
+            "  -f frames       stop after this many frames (default: when one is left)\n"
+            "  -s seed         random seed for pieces, garbage and bots\n"
+            "  -t strategy     random, attackers, kos, badges or mixed (default)\n");
+}
+
+static int parse_strategy(const char *name)
+{
+    static const char *names[TARGET_STRATEGY_COUNT] = {
+        "random", "attackers", "kos", "badges",
+    };
+
+    for (int i = 0; i < TARGET_STRATEGY_COUNT; i++)
+        if (!strcmp(name, names[i]))
+            return i;
+
+    return !strcmp(name, "mixed") ? TARGET_STRATEGY_COUNT : -1;
+}
+
+int main(int argc, char **argv)
+{
+    int player_count = 100;
+    long frame_count = 0;
+    unsigned int seed = 1;
+    int strategy = TARGET_STRATEGY_COUNT;
+
+    // Arguments
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            player_count = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+            frame_count = atol(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            seed = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            strategy = parse_strategy(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "error: unknown option: %s\n", argv[i]);
+            usage();
+            return 1;
+        }
+    }
+
+    if (player_count < 1 || strategy < 0) {
+        usage();
+        return 1;
+    }
+
+    Royale royale;
+    royale.Start(player_count, seed);
+
+    for (int i = 0; i < player_count; i++)
+        royale.SetStrategy(i, strategy < TARGET_STRATEGY_COUNT ? strategy : i % TARGET_STRATEGY_COUNT);
+
+    static const int bot_moves[] = {
+        MOV_LEFT, MOV_RIGHT, MOV_LEFT, MOV_RIGHT, ROT_LEFT, ROT_RIGHT, MOV_DOWN, MOV_HARDDROP,
+    };
+    std::minstd_rand rng(seed);
+    std::vector<int> moves(player_count);
+
+    while (!royale.IsOver() && (frame_count == 0 || (long) royale.GetFrame() < frame_count)) {
+        for (int i = 0; i < player_count; i++) {
+            const bool is_pressing = (royale.GetFrame() + i) % BOT_KEY_INTERVAL == 0;
+            moves[i] = is_pressing ? bot_moves[rng() % 8] : 0;
+        }
+
+        royale.UpdateFrame(moves.data());
+    }
+
+    royale.PrintStats(stdout);
+
+    // Leaders
+    std::vector<int> order(player_count);
+    for (int i = 0; i < player_count; i++)
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return royale.GetKoCount(a) > royale.GetKoCount(b);
+    });
+
+    printf("winner: %d\n", royale.GetWinner());
+    for (int i = 0; i < std::min(5, player_count); i++) {
+        const int player = order[i];
+        printf("player %d: KOs: %d, attack sent: %d, place: %d\n", player,
+                royale.GetKoCount(player), royale.GetAttackSent(player), royale.GetPlace(player));
+    }
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "scorer.h"
+#include "trace.h"
 #include <algorithm>
 #include <cassert>
 #include <cstdlib>
@@ -28,10 +29,13 @@ void Scorer::Start()
     clear_count_ = 0;
     clear_points_ = 0;
     combo_points_ = 0;
+    attack_ = 0;
 }
 
 void Scorer::Commit()
 {
+    TET_TRACE_SCOPE("Scorer::Commit");
+
     // Lines
     lines_ += clear_count_;
 
@@ -108,6 +112,25 @@ void Scorer::AddLineClear(int count, int tspin_kind, bool perfect_clear)
     // Back to Back Tetris perfect clear
     if (perfect_clear && last_clear_count_ == 4 && clear_count_ == 4)
         clear_points_ = 3200;
+
+    // Attack
+    static const int attack_table[][5] = {
+        //  0  1  2  3  4
+        {   0, 0, 1, 2, 4}, // normal
+        {   0, 2, 4, 6, 0}, // T-spin
+        {   0, 0, 1, 0, 0}  // T-Spin Mini
+    };
+    attack_ = attack_table[tspin_kind][clear_count_];
+
+    if (clear_count_ > 0) {
+        attack_ += get_combo_count();
+
+        if (diffcult_counter_ > 0)
+            attack_ += 1;
+    }
+
+    if (perfect_clear)
+        attack_ = 10;
 }
 
 void Scorer::AddSoftDrop()
@@ -154,3 +177,8 @@ int Scorer::GetBackToBackCounter() const
 {
     return diffcult_counter_;
 }
+
+int Scorer::GetAttack() const
+{
+    return attack_;
+}
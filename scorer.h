@@ -30,6 +30,9 @@ public:
     int GetComboPoints() const;
     int GetBackToBackCounter() const;
 
+    // Garbage lines the last clear sends to an opponent
+    int GetAttack() const;
+
 private:
     int score_ = 0;
     int lines_ = 0;
@@ -42,6 +45,7 @@ private:
     int combo_counter_ = -1;
     int combo_points_ = 0;
     int diffcult_counter_ = -1;
+    int attack_ = 0;
 
     int get_combo_count() const;
 };
@@ -0,0 +1,759 @@
+#include "server.h"
+#include "tetris.h"
+#include "frame.h"
+#include "stats.h"
+#include "ring.h"
+#include "net.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+static const long FRAME_NANOSEC = 1000000000L / 60;
+static const int MAX_EVENT_COUNT = 256;
+
+// Ticks a worker may run at once to catch up before it starts dropping them
+static const int MAX_CATCH_UP_TICKS = 4;
+
+// Frames a viewer may have queued before it is resynced with a key frame
+static const int MAX_QUEUED_FRAMES = 64;
+
+// Distinguishes the worker's own descriptors from connections in epoll data
+static char listen_tag, timer_tag, wake_tag, stop_tag;
+
+// Handed over with a new connection. No game has it, since the top byte of
+// an id is the index of its worker, which is under 255.
+static const uint32_t NO_GAME_ID = 0xFFFFFFFF;
+
+enum ConnectionState {
+    CONN_HANDSHAKE,
+    CONN_PLAYER,
+    CONN_SPECTATOR,
+};
+
+// One encoded message shared by every viewer it is queued on.
+// Only ever touched by the worker that owns the game.
+struct Server::SharedFrame {
+    int refs = 0;
+    int size = 0;
+    uint8_t data[MAX_FRAME_MESSAGE_SIZE];
+};
+
+struct Server::Connection {
+    int fd = -1;
+    bool is_closed = false;
+    int state = CONN_HANDSHAKE;
+    Game *game = nullptr;
+
+    // 'P', or 'W' followed by a game id
+    uint8_t hello[5];
+    int hello_size = 0;
+
+    // The front frame may be partly written
+    Ring<SharedFrame *, MAX_QUEUED_FRAMES> queue;
+    int offset = 0;
+    bool needs_key_frame = false;
+};
+
+struct Server::Game {
+    uint32_t id = 0;
+    bool is_over = false;
+
+    Tetris tetris;
+    Ring<char, 16> keys;
+
+    Connection *player = nullptr;
+    std::vector<Connection *> viewers;
+
+    // Last broadcast frame and its key frame, encoded on demand
+    Frame frame;
+    bool has_frame = false;
+    SharedFrame *key_frame = nullptr;
+};
+
+struct Server::Worker {
+    int index = 0;
+    int epoll_fd = -1;
+    int timer_fd = -1;
+    int wake_fd = -1;
+    uint32_t frame = 0;
+    uint32_t game_count = 0;
+
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::vector<std::unique_ptr<Game>> games;
+    std::unordered_map<uint32_t, Game *> game_ids;
+    Frame scratch;
+
+    // Pooled so broadcasting doesn't allocate
+    std::vector<std::unique_ptr<SharedFrame>> frame_pool;
+    std::vector<SharedFrame *> free_frames;
+
+    // Connections handed over by other workers: {fd, game id}, for new
+    // ones NO_GAME_ID
+    std::mutex handoff_mutex;
+    std::vector<std::pair<int, uint32_t>> handoffs;
+
+    std::thread thread;
+
+    // Stats, read from other threads
+    Histogram tick_times;
+    std::atomic<long> games_running {0};
+    std::atomic<long> viewers {0};
+    std::atomic<long> frames_encoded {0};
+    std::atomic<long> frames_queued {0};
+    std::atomic<long> bytes_sent {0};
+    std::atomic<long> resyncs {0};
+    std::atomic<long> dropped_ticks {0};
+
+    SharedFrame *Acquire()
+    {
+        if (free_frames.empty()) {
+            frame_pool.emplace_back(new SharedFrame);
+            free_frames.push_back(frame_pool.back().get());
+        }
+
+        SharedFrame *frame = free_frames.back();
+        free_frames.pop_back();
+        frame->refs = 1;
+
+        return frame;
+    }
+
+    void Release(SharedFrame *frame)
+    {
+        if (frame && --frame->refs == 0)
+            free_frames.push_back(frame);
+    }
+};
+
+static int key_to_move(int key)
+{
+    switch (key) {
+    case 'z': return ROT_LEFT;
+    case 'x': return ROT_RIGHT;
+    case 'h': return MOV_LEFT;
+    case 'l': return MOV_RIGHT;
+    case 'k': return MOV_UP;
+    case 'j': return MOV_DOWN;
+    case ' ': return MOV_HARDDROP;
+    case 'c': return HOLD_PIECE;
+    default:  return 0;
+    }
+}
+
+static bool add_to_epoll(int epoll_fd, int fd, uint32_t events, void *ptr)
+{
+    epoll_event event = {};
+    event.events = events;
+    event.data.ptr = ptr;
+
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+Server::Server()
+{
+}
+
+Server::~Server()
+{
+    Stop();
+}
+
+bool Server::Start(int listen_fd, int thread_count)
+{
+    if (listen_fd < 0 || thread_count < 1 || thread_count > 255)
+        return false;
+
+    listen_fd_ = listen_fd;
+    stop_fd_ = eventfd(0, EFD_NONBLOCK);
+    if (stop_fd_ < 0)
+        return false;
+
+    // Every worker's timer counts from the same instant
+    clock_gettime(CLOCK_MONOTONIC, &start_time_);
+
+    for (int i = 0; i < thread_count; i++) {
+        std::unique_ptr<Worker> worker(new Worker);
+
+        worker->index = i;
+        worker->epoll_fd = epoll_create1(0);
+        worker->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        worker->wake_fd = eventfd(0, EFD_NONBLOCK);
+
+        itimerspec spec = {};
+        spec.it_value = start_time_;
+        spec.it_interval.tv_nsec = FRAME_NANOSEC;
+
+        const bool ok = worker->epoll_fd >= 0 && worker->timer_fd >= 0 && worker->wake_fd >= 0 &&
+            !timerfd_settime(worker->timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) &&
+            add_to_epoll(worker->epoll_fd, listen_fd_, EPOLLIN | EPOLLEXCLUSIVE, &listen_tag) &&
+            add_to_epoll(worker->epoll_fd, worker->timer_fd, EPOLLIN, &timer_tag) &&
+            add_to_epoll(worker->epoll_fd, worker->wake_fd, EPOLLIN, &wake_tag) &&
+            add_to_epoll(worker->epoll_fd, stop_fd_, EPOLLIN, &stop_tag);
+
+        workers_.push_back(std::move(worker));
+
+        if (!ok) {
+            perror("worker");
+            Stop();
+            return false;
+        }
+    }
+
+    for (auto &worker: workers_)
+        worker->thread = std::thread(&Server::run_worker, this, std::ref(*worker));
+
+    return true;
+}
+
+void Server::Stop()
+{
+    if (stop_fd_ < 0)
+        return;
+
+    const uint64_t one = 1;
+    const ssize_t written = write(stop_fd_, &one, sizeof(one));
+    (void) written;
+
+    for (auto &worker: workers_) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+
+    for (auto &worker: workers_) {
+        for (auto &conn: worker->connections)
+            if (conn->fd >= 0)
+                close(conn->fd);
+
+        for (auto &handoff: worker->handoffs)
+            close(handoff.first);
+
+        for (int fd: {worker->epoll_fd, worker->timer_fd, worker->wake_fd})
+            if (fd >= 0)
+                close(fd);
+    }
+
+    workers_.clear();
+    close(stop_fd_);
+    close(listen_fd_);
+    stop_fd_ = listen_fd_ = -1;
+}
+
+long Server::GetGameCount() const
+{
+    long count = 0;
+
+    for (const auto &worker: workers_)
+        count += worker->games_running.load(std::memory_order_relaxed);
+
+    return count;
+}
+
+void Server::PrintStats(FILE *fp) const
+{
+    for (const auto &worker: workers_) {
+        fprintf(fp, "worker %d: games: %ld, viewers: %ld, frames encoded: %ld, "
+                "frames queued: %ld, bytes sent: %ld, resyncs: %ld, dropped ticks: %ld\n",
+                worker->index,
+                worker->games_running.load(std::memory_order_relaxed),
+                worker->viewers.load(std::memory_order_relaxed),
+                worker->frames_encoded.load(std::memory_order_relaxed),
+                worker->frames_queued.load(std::memory_order_relaxed),
+                worker->bytes_sent.load(std::memory_order_relaxed),
+                worker->resyncs.load(std::memory_order_relaxed),
+                worker->dropped_ticks.load(std::memory_order_relaxed));
+        fprintf(fp, "  tick p50: %lld ns, p99: %lld ns, max: %lld ns\n",
+                (long long) worker->tick_times.GetPercentile(50),
+                (long long) worker->tick_times.GetPercentile(99),
+                (long long) worker->tick_times.GetMax());
+    }
+}
+
+void Server::run_worker(Worker &worker)
+{
+    epoll_event events[MAX_EVENT_COUNT];
+
+    for (;;) {
+        const int count = epoll_wait(worker.epoll_fd, events, MAX_EVENT_COUNT, -1);
+
+        if (count < 0 && errno != EINTR)
+            return;
+
+        bool has_ticked = false;
+
+        for (int i = 0; i < count; i++) {
+            const epoll_event &event = events[i];
+
+            if (event.data.ptr == &stop_tag) {
+                return;
+            }
+            else if (event.data.ptr == &listen_tag) {
+                accept_connections(worker);
+            }
+            else if (event.data.ptr == &wake_tag) {
+                adopt_connections(worker);
+            }
+            else if (event.data.ptr == &timer_tag) {
+                uint64_t expirations = 0;
+                if (read(worker.timer_fd, &expirations, sizeof(expirations)) > 0) {
+                    const int tick_count = std::min<uint64_t>(expirations, MAX_CATCH_UP_TICKS);
+                    worker.dropped_ticks.fetch_add(expirations - tick_count,
+                            std::memory_order_relaxed);
+                    tick(worker, tick_count);
+                    has_ticked = true;
+                }
+            }
+            else {
+                Connection &conn = *static_cast<Connection *>(event.data.ptr);
+
+                if (conn.is_closed)
+                    continue;
+
+                if (event.events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)) {
+                    close_connection(worker, conn);
+                    continue;
+                }
+                if (event.events & EPOLLIN)
+                    read_input(worker, conn);
+                if ((event.events & EPOLLOUT) && !conn.is_closed)
+                    flush(worker, conn);
+            }
+        }
+
+        // Once a tick, and only after the batch, since later events of it
+        // can still point at what closed earlier in it
+        if (has_ticked)
+            remove_closed(worker);
+    }
+}
+
+void Server::accept_connections(Worker &worker)
+{
+    // The one worker EPOLLEXCLUSIVE wakes takes a whole burst, so it deals
+    // the connections out to every worker in turn
+    for (;;) {
+        const int fd = AcceptClient(listen_fd_);
+        if (fd < 0)
+            return;
+
+        const int index = next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+
+        if (index == worker.index)
+            add_connection(worker, fd);
+        else
+            hand_off(*workers_[index], fd, NO_GAME_ID);
+    }
+}
+
+Server::Connection *Server::add_connection(Worker &worker, int fd)
+{
+    std::unique_ptr<Connection> conn(new Connection);
+    conn->fd = fd;
+
+    if (!add_to_epoll(worker.epoll_fd, fd,
+                EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP, conn.get())) {
+        close(fd);
+        return nullptr;
+    }
+
+    worker.connections.push_back(std::move(conn));
+    return worker.connections.back().get();
+}
+
+void Server::hand_off(Worker &other, int fd, uint32_t game_id)
+{
+    {
+        std::lock_guard<std::mutex> lock(other.handoff_mutex);
+        other.handoffs.push_back({fd, game_id});
+    }
+
+    const uint64_t one = 1;
+    const ssize_t written = write(other.wake_fd, &one, sizeof(one));
+    (void) written;
+}
+
+void Server::adopt_connections(Worker &worker)
+{
+    uint64_t count = 0;
+    const ssize_t size = read(worker.wake_fd, &count, sizeof(count));
+    (void) size;
+
+    std::vector<std::pair<int, uint32_t>> handoffs;
+    {
+        std::lock_guard<std::mutex> lock(worker.handoff_mutex);
+        handoffs.swap(worker.handoffs);
+    }
+
+    for (auto &handoff: handoffs) {
+        Connection *conn = add_connection(worker, handoff.first);
+
+        if (conn && handoff.second != NO_GAME_ID)
+            watch_game(worker, *conn, handoff.second);
+    }
+}
+
+void Server::read_input(Worker &worker, Connection &conn)
+{
+    uint8_t buf[64];
+
+    for (;;) {
+        const ssize_t size = recv(conn.fd, buf, sizeof(buf), 0);
+
+        // Closed connections are reported by EPOLLRDHUP
+        if (size <= 0)
+            return;
+
+        for (int i = 0; i < size; i++) {
+            const uint8_t byte = buf[i];
+
+            switch (conn.state) {
+            case CONN_HANDSHAKE:
+                conn.hello[conn.hello_size++] = byte;
+
+                if (conn.hello[0] == 'P') {
+                    start_game(worker, conn);
+                }
+                else if (conn.hello[0] != 'W') {
+                    close_connection(worker, conn);
+                }
+                else if (conn.hello_size == 5) {
+                    watch_game(worker, conn, get_u32(conn.hello + 1));
+                }
+                break;
+
+            case CONN_PLAYER:
+                conn.game->keys.PushBack(byte);
+                break;
+
+            case CONN_SPECTATOR:
+                if (byte == 'q')
+                    close_connection(worker, conn);
+                break;
+            }
+
+            // Closed or handed over to another worker
+            if (conn.is_closed)
+                return;
+        }
+    }
+}
+
+void Server::start_game(Worker &worker, Connection &conn)
+{
+    std::unique_ptr<Game> game(new Game);
+
+    game->id = (worker.index << 24) | (++worker.game_count & 0xFFFFFF);
+
+    // Every game of every worker would share the one crash log
+    game->tetris.EnableLog(false);
+    game->tetris.PlayGame();
+    game->player = &conn;
+    game->viewers.push_back(&conn);
+
+    conn.state = CONN_PLAYER;
+    conn.game = game.get();
+    conn.needs_key_frame = true;
+
+    SharedFrame *hello = worker.Acquire();
+    hello->size = EncodeHello(game->id, hello->data);
+    push_frame(worker, *game, conn, hello);
+    worker.Release(hello);
+
+    worker.game_ids[game->id] = game.get();
+    worker.games.push_back(std::move(game));
+}
+
+void Server::watch_game(Worker &worker, Connection &conn, uint32_t game_id)
+{
+    const int owner = game_id >> 24;
+
+    if (owner >= (int) workers_.size()) {
+        close_connection(worker, conn);
+        return;
+    }
+
+    // Viewers must live on the worker that ticks the game
+    if (owner != worker.index) {
+        Worker &other = *workers_[owner];
+
+        epoll_ctl(worker.epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+        hand_off(other, conn.fd, game_id);
+
+        conn.fd = -1;
+        conn.is_closed = true;
+        return;
+    }
+
+    auto found = worker.game_ids.find(game_id);
+    if (found == worker.game_ids.end() || found->second->is_over) {
+        close_connection(worker, conn);
+        return;
+    }
+
+    Game &game = *found->second;
+
+    conn.state = CONN_SPECTATOR;
+    conn.game = &game;
+    conn.needs_key_frame = true;
+    game.viewers.push_back(&conn);
+}
+
+void Server::tick(Worker &worker, int tick_count)
+{
+    PhaseTimer timer;
+
+    for (int i = 0; i < tick_count; i++) {
+        for (auto &game: worker.games)
+            if (!game->is_over)
+                step_game(*game);
+
+        worker.frame++;
+    }
+
+    for (auto &game: worker.games)
+        if (!game->is_over)
+            broadcast(worker, *game);
+
+    worker.tick_times.Add(timer.Lap());
+}
+
+void Server::step_game(Game &game)
+{
+    Tetris &tetris = game.tetris;
+    char key = 0;
+    int move = 0;
+
+    if (!game.keys.IsEmpty()) {
+        key = game.keys.Front();
+        game.keys.PopFront();
+    }
+
+    switch (key) {
+    case 'p':
+        if (!tetris.IsGameOver())
+            tetris.PauseGame();
+        break;
+
+    case 'r':
+        tetris.PlayGame();
+        break;
+
+    case 'q':
+        game.is_over = true;
+        return;
+
+    default:
+        move = key_to_move(key);
+        break;
+    }
+
+    tetris.UpdateFrame(move);
+}
+
+void Server::broadcast(Worker &worker, Game &game)
+{
+    Frame &next = worker.scratch;
+    ComposeFrame(game.tetris, worker.frame, next);
+
+    // Rendered once, whatever the number of viewers
+    SharedFrame *diff = nullptr;
+
+    if (!game.has_frame || HasFrameChanged(game.frame, next)) {
+        if (game.has_frame) {
+            diff = worker.Acquire();
+            diff->size = EncodeFrame(&game.frame, next, diff->data);
+            worker.frames_encoded.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        game.frame = next;
+        game.has_frame = true;
+        worker.Release(game.key_frame);
+        game.key_frame = nullptr;
+    }
+
+    for (Connection *conn: game.viewers) {
+        if (conn->is_closed)
+            continue;
+
+        if (conn->needs_key_frame) {
+            conn->needs_key_frame = false;
+            push_frame(worker, game, *conn, get_key_frame(worker, game));
+        }
+        else if (diff) {
+            push_frame(worker, game, *conn, diff);
+        }
+
+        flush(worker, *conn);
+    }
+
+    worker.Release(diff);
+}
+
+Server::SharedFrame *Server::get_key_frame(Worker &worker, Game &game)
+{
+    if (!game.key_frame) {
+        game.key_frame = worker.Acquire();
+        game.key_frame->size = EncodeFrame(nullptr, game.frame, game.key_frame->data);
+        worker.frames_encoded.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return game.key_frame;
+}
+
+void Server::push_frame(Worker &worker, Game &game, Connection &conn, SharedFrame *frame)
+{
+    if (conn.queue.IsFull()) {
+        // Too far behind. Drop everything not yet started and resync.
+        SharedFrame *partial = conn.offset > 0 ? conn.queue.Front() : nullptr;
+
+        if (partial)
+            conn.queue.PopFront();
+
+        while (!conn.queue.IsEmpty()) {
+            worker.Release(conn.queue.Front());
+            conn.queue.PopFront();
+        }
+
+        if (partial)
+            conn.queue.PushBack(partial);
+
+        frame = get_key_frame(worker, game);
+        worker.resyncs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    frame->refs++;
+    conn.queue.PushBack(frame);
+    worker.frames_queued.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Server::flush(Worker &worker, Connection &conn)
+{
+    while (!conn.queue.IsEmpty()) {
+        iovec iov[MAX_QUEUED_FRAMES];
+        const int count = conn.queue.Size();
+
+        for (int i = 0; i < count; i++) {
+            const SharedFrame *frame = conn.queue[i];
+            const int skip = i == 0 ? conn.offset : 0;
+
+            iov[i].iov_base = const_cast<uint8_t *>(frame->data) + skip;
+            iov[i].iov_len = frame->size - skip;
+        }
+
+        msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+
+        ssize_t size = sendmsg(conn.fd, &msg, MSG_NOSIGNAL);
+
+        if (size < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                close_connection(worker, conn);
+            return;
+        }
+
+        worker.bytes_sent.fetch_add(size, std::memory_order_relaxed);
+
+        // Release what went out completely
+        while (size > 0) {
+            SharedFrame *frame = conn.queue.Front();
+            const int remaining = frame->size - conn.offset;
+
+            if (size < remaining) {
+                conn.offset += size;
+                break;
+            }
+
+            size -= remaining;
+            conn.offset = 0;
+            conn.queue.PopFront();
+            worker.Release(frame);
+        }
+    }
+}
+
+void Server::remove_closed(Worker &worker)
+{
+    // Games lose closed viewers, and end with their player
+    for (auto &game: worker.games) {
+        if (game->player->is_closed)
+            game->is_over = true;
+
+        if (game->is_over)
+            for (Connection *conn: game->viewers)
+                close_connection(worker, *conn);
+
+        auto &viewers = game->viewers;
+        viewers.erase(
+                std::remove_if(
+                    viewers.begin(),
+                    viewers.end(),
+                    [](const Connection *conn) { return conn->is_closed; }),
+                viewers.end());
+    }
+
+    // Connections and games are freed here, once no event of the batch is left
+    for (auto &conn: worker.connections) {
+        if (!conn->is_closed)
+            continue;
+
+        while (!conn->queue.IsEmpty()) {
+            worker.Release(conn->queue.Front());
+            conn->queue.PopFront();
+        }
+    }
+
+    auto &connections = worker.connections;
+    connections.erase(
+            std::remove_if(
+                connections.begin(),
+                connections.end(),
+                [](const std::unique_ptr<Connection> &conn) { return conn->is_closed; }),
+            connections.end());
+
+    long viewer_count = 0;
+
+    for (auto &game: worker.games) {
+        viewer_count += game->viewers.size();
+
+        if (game->is_over) {
+            worker.Release(game->key_frame);
+            worker.game_ids.erase(game->id);
+        }
+    }
+
+    auto &games = worker.games;
+    games.erase(
+            std::remove_if(
+                games.begin(),
+                games.end(),
+                [](const std::unique_ptr<Game> &game) { return game->is_over; }),
+            games.end());
+
+    worker.games_running.store(games.size(), std::memory_order_relaxed);
+    worker.viewers.store(viewer_count, std::memory_order_relaxed);
+}
+
+void Server::close_connection(Worker &worker, Connection &conn)
+{
+    if (conn.is_closed)
+        return;
+
+    conn.is_closed = true;
+    close(conn.fd);
+    conn.fd = -1;
+}
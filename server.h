@@ -0,0 +1,66 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+
+// Hosts many games in one process. Each worker thread runs an epoll loop
+// over its own games and ticks all of them on a 60 Hz clock shared by
+// every worker. Clients send key bytes and receive frame diffs (frame.h).
+//
+// A connection starts with 'P' to play a new game, answered by a hello
+// message carrying the game id, or with 'W' and a u32 game id to watch.
+// Player keys: h l j k = left right down up, space = hard drop,
+// z x = rotate, c = hold, p = pause, r = reset, q = quit.
+//
+// Each game encodes its frame diff once per tick into a shared buffer that
+// every viewer's socket is handed with sendmsg. Viewers that join late or
+// fall too far behind get a key frame and continue from there.
+class Server {
+public:
+    Server();
+    ~Server();
+
+    // Takes ownership of a listening socket from net.h
+    bool Start(int listen_fd, int thread_count);
+    void Stop();
+
+    long GetGameCount() const;
+    void PrintStats(FILE *fp) const;
+
+private:
+    struct SharedFrame;
+    struct Connection;
+    struct Game;
+    struct Worker;
+
+    int listen_fd_ = -1;
+    int stop_fd_ = -1;
+    timespec start_time_ = {};
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<unsigned int> next_worker_ {0};
+
+    void run_worker(Worker &worker);
+    void accept_connections(Worker &worker);
+    void adopt_connections(Worker &worker);
+    Connection *add_connection(Worker &worker, int fd);
+    void hand_off(Worker &other, int fd, uint32_t game_id);
+    void read_input(Worker &worker, Connection &conn);
+    void start_game(Worker &worker, Connection &conn);
+    void watch_game(Worker &worker, Connection &conn, uint32_t game_id);
+
+    void tick(Worker &worker, int tick_count);
+    void step_game(Game &game);
+    void broadcast(Worker &worker, Game &game);
+    SharedFrame *get_key_frame(Worker &worker, Game &game);
+    void push_frame(Worker &worker, Game &game, Connection &conn, SharedFrame *frame);
+    void flush(Worker &worker, Connection &conn);
+    void remove_closed(Worker &worker);
+    void close_connection(Worker &worker, Connection &conn);
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "server.h"
+#include "client.h"
+#include "net.h"
+
+#include <sys/resource.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+
+static volatile sig_atomic_t is_interrupted = 0;
+
+static void handle_signal(int)
+{
+    is_interrupted = 1;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: tetris-server [-u path | -p port] [-j threads] [-c clients] [-w spectators] [-n seconds]\n"
+            "  -u path         listen on a Unix domain socket (default: /tmp/tetris.sock)\n"
+            "  -p port         listen on TCP localhost instead\n"
+            "  -j threads      worker threads (default: one per core)\n"
+            "  -c clients      connect local stand-in clients and report what they receive\n"
+            "  -w spectators   also connect spectators watching the local clients' games\n"
+            "  -n seconds      stop after this many seconds\n");
+}
+
+static void raise_file_limit()
+{
+    // Each local client costs two descriptors
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = "/tmp/tetris.sock";
+    int port = 0;
+    int thread_count = std::max(1u, std::thread::hardware_concurrency());
+    int client_count = 0;
+    int spectator_count = 0;
+    double seconds = 0;
+
+    // Arguments
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-u") && i + 1 < argc) {
+            path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+            client_count = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc) {
+            spectator_count = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "error: unknown option: %s\n", argv[i]);
+            usage();
+            return 1;
+        }
+    }
+
+    raise_file_limit();
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    const int listen_fd = port ? ListenTcp(port) : ListenUnix(path);
+    Server server;
+
+    if (!server.Start(listen_fd, thread_count)) {
+        fprintf(stderr, "error: can't start server\n");
+        return 1;
+    }
+
+    ClientPool clients;
+    int result = 0;
+
+    if (client_count > 0) {
+        const bool connected = port ?
+            clients.ConnectTcp(port, client_count) :
+            clients.ConnectUnix(path, client_count);
+
+        if (!connected) {
+            fprintf(stderr, "error: can't connect clients\n");
+            return 1;
+        }
+
+        clients.SetSpectatorCount(spectator_count);
+        clients.Run(seconds > 0 ? seconds : 10);
+        clients.PrintStats(stdout);
+        result = clients.GetDecodeErrorCount() > 0 || clients.GetMismatchCount() > 0 ? 1 : 0;
+    }
+    else {
+        const auto start = std::chrono::steady_clock::now();
+        const std::chrono::duration<double> limit(seconds);
+
+        while (!is_interrupted) {
+            if (seconds > 0 && std::chrono::steady_clock::now() - start > limit)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    server.PrintStats(stdout);
+    server.Stop();
+
+    if (!port)
+        unlink(path);
+
+    return result;
+}
@@ -0,0 +1,111 @@
+#include "stats.h"
+#include <algorithm>
+#include <cmath>
+
+static int bucket_index(int64_t nanosec)
+{
+    if (nanosec < 8)
+        return std::max<int64_t>(nanosec, 0);
+
+    // 8 sub-buckets for each power of two
+    const int msb = 63 - __builtin_clzll(nanosec);
+    const int shift = msb - 3;
+    const int sub = (nanosec >> shift) & 7;
+
+    return (shift + 1) * 8 + sub;
+}
+
+static int64_t bucket_upper_bound(int index)
+{
+    if (index < 8)
+        return index;
+
+    const int shift = index / 8 - 1;
+    const int sub = index % 8;
+
+    return ((int64_t(8 + sub + 1)) << shift) - 1;
+}
+
+Histogram::Histogram()
+{
+    Reset();
+}
+
+Histogram::~Histogram()
+{
+}
+
+void Histogram::Add(int64_t nanosec)
+{
+    const int index = std::min<int>(bucket_index(nanosec), BUCKET_COUNT - 1);
+
+    buckets_[index].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+
+    if (nanosec > max_.load(std::memory_order_relaxed))
+        max_.store(nanosec, std::memory_order_relaxed);
+}
+
+void Histogram::Reset()
+{
+    for (auto &bucket: buckets_)
+        bucket.store(0, std::memory_order_relaxed);
+
+    count_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+int64_t Histogram::GetCount() const
+{
+    return count_.load(std::memory_order_relaxed);
+}
+
+int64_t Histogram::GetMax() const
+{
+    return max_.load(std::memory_order_relaxed);
+}
+
+int64_t Histogram::GetPercentile(double percent) const
+{
+    const int64_t count = GetCount();
+    if (count == 0)
+        return 0;
+
+    const int64_t target = std::max<int64_t>(1, std::ceil(count * percent / 100.));
+    int64_t sum = 0;
+
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        sum += buckets_[i].load(std::memory_order_relaxed);
+
+        if (sum >= target)
+            return std::min(bucket_upper_bound(i), GetMax());
+    }
+
+    return GetMax();
+}
+
+int64_t Histogram::GetCountAbove(int64_t nanosec) const
+{
+    int64_t sum = 0;
+
+    for (int i = bucket_index(nanosec) + 1; i < BUCKET_COUNT; i++)
+        sum += buckets_[i].load(std::memory_order_relaxed);
+
+    return sum;
+}
+
+void Histogram::Print(FILE *fp) const
+{
+    fprintf(fp, "count: %lld, p50: %lld ns, p99: %lld ns, max: %lld ns\n",
+            (long long) GetCount(),
+            (long long) GetPercentile(50),
+            (long long) GetPercentile(99),
+            (long long) GetMax());
+
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        const uint32_t n = buckets_[i].load(std::memory_order_relaxed);
+
+        if (n > 0)
+            fprintf(fp, "  <= %12lld ns: %u\n", (long long) bucket_upper_bound(i), n);
+    }
+}
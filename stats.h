@@ -0,0 +1,52 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// Fixed-bucket latency histogram in nanoseconds. Buckets are log-linear:
+// 8 sub-buckets per power of two, so relative error stays below 12.5%.
+// One thread adds samples, any thread may read them.
+class Histogram {
+public:
+    Histogram();
+    ~Histogram();
+
+    void Add(int64_t nanosec);
+    void Reset();
+
+    int64_t GetCount() const;
+    int64_t GetMax() const;
+    int64_t GetPercentile(double percent) const;
+    int64_t GetCountAbove(int64_t nanosec) const;
+
+    void Print(FILE *fp) const;
+
+private:
+    enum { BUCKET_COUNT = 320 };
+
+    std::array<std::atomic<uint32_t>, BUCKET_COUNT> buckets_;
+    std::atomic<int64_t> count_ {0};
+    std::atomic<int64_t> max_ {0};
+};
+
+class PhaseTimer {
+public:
+    PhaseTimer() : start_(std::chrono::steady_clock::now()) {}
+
+    int64_t Lap()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_);
+        start_ = now;
+        return ns.count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif
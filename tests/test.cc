@@ -1,4 +1,30 @@
 #include "tetris.h"
+#include "triple_buffer.h"
+#include "stats.h"
+#include "alloc.h"
+#include "frame.h"
+#include "game_batch.h"
+#include "match.h"
+#include "royale.h"
+#include "movegen.h"
+#include "pc_solver.h"
+#include "tspin.h"
+#include "bot.h"
+#include "rollout.h"
+#include "mlp.h"
+#include "league.h"
+#include "log.h"
+#include "worker_pool.h"
+#include <chrono>
+#include <thread>
+#include "scorer.h"
+#include <algorithm>
+#include <bitset>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
 #include <vector>
 #include <array>
 
@@ -88,6 +114,20 @@ void setup_field(Tetris &tetris, const Grid &grid)
     tetris.SetTetrominoPos(pos);
 }
 
+// Sets a debug game up on grid, with its piece back at spawn, and returns
+// the move bot finds for it one piece deep
+BotMove find_bot_move(Bot &bot, Tetris &tetris, const Grid &grid)
+{
+    tetris.SetDebugMode();
+    tetris.PlayGame();
+    tetris.UpdateFrame(0);
+    setup_field(tetris, grid);
+    tetris.SetTetrominoRotation(0);
+    tetris.SetTetrominoPos(SPAWN_POS);
+
+    return bot.FindMove(tetris, 1);
+}
+
 void update_frame_ntimes(Tetris &tetris, int operation, int times)
 {
     for (int i = 0; i < times; i++)
@@ -568,6 +608,20 @@ void test()
 
         ASSERT_EQ(4, tetris.GetClearedLineCount());
         ASSERT_EQ(800, tetris.GetClearPoints());
+
+        // Events
+        GameEvent event;
+        ASSERT_EQ(1, tetris.PollEvent(event));
+        ASSERT_EQ(EVENT_SPAWN, event.kind);
+        ASSERT_EQ(1, tetris.PollEvent(event));
+        ASSERT_EQ(EVENT_LOCK, event.kind);
+        ASSERT_EQ(I, event.piece);
+        ASSERT_EQ(1, tetris.PollEvent(event));
+        ASSERT_EQ(EVENT_CLEAR, event.kind);
+        ASSERT_EQ(4, event.line_count);
+        ASSERT_EQ(3, event.cleared_lines[3]);
+        ASSERT_EQ(800, event.clear_points);
+        ASSERT_EQ(0, tetris.PollEvent(event));
     }
     // Perfect clear ===========================================
     {
@@ -663,8 +717,8 @@ void test()
         ASSERT_EQ(3, tetris.GetTetrominoRotation());
         ASSERT_EQ(Point(9, 6), tetris.GetTetrominoPos());
 
-        tetris.SetGravityDrop(-0.8186);
-        tetris.SetGravity(0.2598);
+        tetris.SetGravityDrop(GRAVITY_UNIT * 8186 / 10000);
+        tetris.SetGravity(GetLevelGravity(10));
         tetris.UpdateFrame(ROT_RIGHT);
 
         ASSERT_EQ(0, tetris.GetTetrominoRotation());
@@ -691,12 +745,1024 @@ void test()
         ASSERT_EQ(1, tetris.GetTetrominoRotation());
         ASSERT_EQ(Point(4, 3), tetris.GetTetrominoPos());
 
-        tetris.SetGravityDrop(-0.8186);
-        tetris.SetGravity(0.2598);
+        tetris.SetGravityDrop(GRAVITY_UNIT * 8186 / 10000);
+        tetris.SetGravity(GetLevelGravity(10));
         tetris.UpdateFrame(MOV_RIGHT);
 
         ASSERT_EQ(5, tetris.GetTetrominoKind());
         ASSERT_EQ(1, tetris.GetTetrominoRotation());
         ASSERT_EQ(Point(4, 2), tetris.GetTetrominoPos());
     }
+    // Tick rate ===========================================
+    {
+        // Fixed-point gravity falls the same distance at 60 and 120 Hz
+        Tetris tetris60;
+        Tetris tetris120;
+        tetris60.SetRandomSeed(3);
+        tetris120.SetRandomSeed(3);
+        tetris120.SetTickRate(120);
+        tetris60.PlayGame();
+        tetris120.PlayGame();
+
+        ASSERT_EQ(GetLevelGravity(1) / 2, tetris120.GetGravity());
+        tetris60.SetGravity(GetLevelGravity(10, 60));
+        tetris120.SetGravity(GetLevelGravity(10, 120));
+
+        update_frame_ntimes(tetris60, 0, 30);
+        update_frame_ntimes(tetris120, 0, 60);
+
+        ASSERT_EQ(tetris60.GetTetrominoKind(), tetris120.GetTetrominoKind());
+        ASSERT_EQ(tetris60.GetTetrominoPos(), tetris120.GetTetrominoPos());
+        ASSERT_EQ(Point(4, 19 - 7), tetris60.GetTetrominoPos());
+    }
+    // 20G ===========================================
+    {
+        Tetris tetris;
+        tetris.SetRandomSeed(5);
+        tetris.PlayGame();
+        tetris.SetGravity(GetLevelGravity(20));
+
+        // Spawns straight onto the floor
+        tetris.UpdateFrame(0);
+        Piece piece = tetris.GetCurrentPiece();
+        int bottom = FIELD_HEIGHT;
+        for (auto tile: piece.tiles)
+            bottom = std::min(bottom, tile.y);
+        ASSERT_EQ(0, bottom);
+        ASSERT_EQ(E, tetris.GetGhostPiece().kind);
+
+        // Down locks at once
+        tetris.UpdateFrame(MOV_DOWN);
+        for (auto tile: piece.tiles)
+            ASSERT_EQ(piece.kind, tetris.GetFieldTileKind(tile));
+
+        // The next piece slides along the stack
+        tetris.UpdateFrame(MOV_LEFT);
+        tetris.UpdateFrame(MOV_LEFT);
+        tetris.UpdateFrame(MOV_LEFT);
+        tetris.UpdateFrame(MOV_LEFT);
+        piece = tetris.GetCurrentPiece();
+        for (auto tile: piece.tiles)
+            ASSERT_EQ(1, tile.y < 3);
+    }
+    // Buffer zone ===========================================
+    {
+        Tetris tetris;
+        tetris.SetDebugMode();
+        tetris.SetRandomSeed(3);
+        tetris.PlayGame();
+        tetris.UpdateFrame(0);
+
+        // Rows above the visible ones are part of the field
+        ASSERT_EQ(E, tetris.GetFieldTileKind(Point(0, FIELD_HEIGHT)));
+        ASSERT_EQ(B, tetris.GetFieldTileKind(Point(0, FIELD_BUFFER_HEIGHT)));
+
+        // A piece locking wholly above them ends the game, and stays there
+        for (int x = 0; x < FIELD_WIDTH - 1; x++)
+            tetris.SetFieldTileKind(Point(x, FIELD_HEIGHT + 2), G);
+        tetris.SetTetrominoKind(O);
+        tetris.SetTetrominoPos(Point(4, FIELD_HEIGHT + 6));
+        ASSERT_EQ(Point(4, FIELD_HEIGHT + 6), tetris.GetTetrominoPos());
+
+        tetris.UpdateFrame(MOV_HARDDROP);
+        ASSERT_EQ(1, tetris.IsGameOver());
+        for (auto tile: tetris.GetCurrentPiece().tiles)
+            ASSERT_EQ(O, tetris.GetFieldTileKind(tile));
+    }
+    // Triple buffer ===========================================
+    {
+        TripleBuffer<int> buffer;
+        ASSERT_EQ(0, buffer.Fetch());
+
+        buffer.GetBack() = 1;
+        buffer.Publish();
+        buffer.GetBack() = 2;
+        buffer.Publish();
+
+        // Reader only sees the latest
+        ASSERT_EQ(1, buffer.Fetch());
+        ASSERT_EQ(2, buffer.GetFront());
+        ASSERT_EQ(0, buffer.Fetch());
+        ASSERT_EQ(2, buffer.GetFront());
+    }
+    // Worker pool ===========================================
+    {
+        WorkerPool pool;
+        std::atomic<int> next_task {0};
+        std::vector<int> done(100);
+
+        auto work = [&]() {
+            for (int i; (i = next_task.fetch_add(1)) < 100;) {
+                // Runs started from inside a run stay on their thread
+                std::atomic<int> inner {0};
+                pool.Run(4, [&]() { inner++; });
+                done[i] = inner;
+            }
+        };
+
+        // The same workers take later runs, with fewer or more threads
+        for (int thread_count: {4, 2, 6}) {
+            next_task = 0;
+            std::fill(done.begin(), done.end(), 0);
+            pool.Run(thread_count, work);
+            ASSERT_EQ(100, (int) std::count(done.begin(), done.end(), 1));
+        }
+    }
+    // Histogram ===========================================
+    {
+        Histogram histogram;
+        for (int i = 1; i <= 100; i++)
+            histogram.Add(i * 1000);
+
+        ASSERT_EQ(100, histogram.GetCount());
+        ASSERT_EQ(100000, histogram.GetMax());
+        ASSERT_EQ(1, histogram.GetPercentile(50) >= 50000);
+        ASSERT_EQ(1, histogram.GetPercentile(50) < 50000 * 1.125);
+        ASSERT_EQ(1, histogram.GetPercentile(99) >= 99000);
+        ASSERT_EQ(100000, histogram.GetPercentile(100));
+    }
+    // Random seed ===========================================
+    {
+        Tetris tetris1, tetris2;
+        tetris1.SetRandomSeed(42);
+        tetris2.SetRandomSeed(42);
+        tetris1.PlayGame();
+        tetris2.PlayGame();
+
+        for (int i = 0; i < 14; i++)
+            ASSERT_EQ(tetris1.GetPieceKindList(i), tetris2.GetPieceKindList(i));
+
+        // And the same bags on every standard library
+        static const int bags[14] = {L, S, Z, J, O, I, T, T, S, J, Z, O, L, I};
+        Tetris tetris3;
+        tetris3.SetRandomSeed(1);
+        tetris3.PlayGame();
+
+        for (int i = 0; i < 14; i++)
+            ASSERT_EQ(bags[i], tetris3.GetPieceKindList(i));
+    }
+    // Allocation-free frames ===========================================
+    {
+        const long old_count = GetAllocationCount();
+        delete new int;
+        ASSERT_EQ(1, GetAllocationCount() - old_count);
+        free(malloc(16));
+        ASSERT_EQ(2, GetAllocationCount() - old_count);
+
+        const int moves[] = {
+            MOV_LEFT, 0, ROT_LEFT, MOV_DOWN, MOV_RIGHT, ROT_RIGHT, 0, MOV_HARDDROP,
+            HOLD_PIECE, MOV_RIGHT, MOV_RIGHT, ROT_RIGHT, 0, 0, MOV_HARDDROP, 0,
+        };
+
+        Tetris tetris;
+        tetris.SetRandomSeed(1);
+        tetris.PlayGame();
+
+        for (int frame = 0; frame < 10000; frame++) {
+            const long count = GetAllocationCount();
+
+            if (tetris.IsGameOver())
+                tetris.PlayGame();
+            tetris.UpdateFrame(moves[frame % 16]);
+
+            ASSERT_EQ(0, GetAllocationCount() - count);
+        }
+    }
+    // Frame diff ===========================================
+    {
+        Tetris tetris;
+        tetris.SetRandomSeed(7);
+        tetris.PlayGame();
+
+        Frame sent, received;
+        uint8_t buf[MAX_FRAME_MESSAGE_SIZE];
+
+        tetris.UpdateFrame(0);
+        ComposeFrame(tetris, 1, sent);
+        int size = EncodeFrame(nullptr, sent, buf);
+        ASSERT_EQ(size, DecodeFrame(buf, size, received));
+        ASSERT_EQ(0, HasFrameChanged(sent, received));
+
+        for (int i = 0; i < 100; i++) {
+            const Frame prev = sent;
+            tetris.UpdateFrame(i % 10 == 0 ? MOV_HARDDROP : MOV_LEFT);
+            ComposeFrame(tetris, i + 2, sent);
+
+            size = EncodeFrame(&prev, sent, buf);
+            ASSERT_EQ(0, DecodeFrame(buf, size - 1, received));
+            ASSERT_EQ(size, DecodeFrame(buf, size, received));
+            ASSERT_EQ(0, HasFrameChanged(sent, received));
+        }
+
+        size = EncodeHello(0x01000002, buf);
+        ASSERT_EQ(FRAME_HELLO_SIZE, DecodeFrame(buf, size, received));
+        ASSERT_EQ(0x01000002u, received.game_id);
+    }
+    // Versus ===========================================
+    {
+        const Grid grid = {
+            {0,0,0,0,0,0,0,0,0,I},
+            {0,0,0,0,0,0,0,0,0,I},
+            {0,0,0,0,O,O,0,0,0,I},
+            {O,O,O,O,O,O,O,O,O,I},
+            {O,O,O,O,O,O,O,O,O,0},
+            {O,O,O,O,O,O,O,O,O,0},
+            {O,O,O,O,O,O,O,O,O,0},
+        };
+
+        Tetris tetris;
+        tetris.SetDebugMode();
+        tetris.PlayGame();
+        tetris.UpdateFrame(0);
+
+        setup_field(tetris, grid);
+        tetris.ReceiveGarbage(3, 0);
+        ASSERT_EQ(3, tetris.GetPendingGarbage());
+
+        // Tetris sends 4, 3 of which cancel the pending garbage
+        tetris.UpdateFrame(MOV_HARDDROP);
+        ASSERT_EQ(1, tetris.PopAttack());
+        ASSERT_EQ(0, tetris.GetPendingGarbage());
+        ASSERT_EQ(0, tetris.PopAttack());
+
+        // Garbage comes in after a lock without clears
+        tetris.ReceiveGarbage(2, 9);
+        tetris.UpdateFrame(0);
+        tetris.UpdateFrame(MOV_HARDDROP);
+        ASSERT_EQ(2, tetris.GetPendingGarbage());
+        tetris.UpdateFrame(0);
+        ASSERT_EQ(0, tetris.GetPendingGarbage());
+        ASSERT_EQ(G, tetris.GetFieldTileKind(Point(0, 0)));
+        ASSERT_EQ(E, tetris.GetFieldTileKind(Point(9, 0)));
+        ASSERT_EQ(G, tetris.GetFieldTileKind(Point(8, 1)));
+        ASSERT_EQ(E, tetris.GetFieldTileKind(Point(9, 1)));
+        ASSERT_EQ(I, tetris.GetFieldTileKind(Point(4, 2)));
+    }
+    {
+        // The player dropping twice as fast tops out first
+        Match match;
+        match.Start(2, 3);
+
+        for (int i = 0; i < 10000 && !match.IsOver(); i++) {
+            const int moves[2] = {i % 2 ? MOV_HARDDROP : 0, MOV_HARDDROP};
+            match.UpdateFrame(moves);
+        }
+
+        ASSERT_EQ(1, match.IsOver());
+        ASSERT_EQ(0, match.GetWinner());
+    }
+    // Battle royale ===========================================
+    {
+        Royale royale;
+        royale.Start(3, 5);
+        GameBatch &boards = royale.GetBoards();
+
+        int moves[3] = {0, 0, 0};
+        royale.UpdateFrame(moves);
+
+        // Any piece clears four lines
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < FIELD_WIDTH; x++)
+                boards.SetFieldTileKind(0, Point(x, y), G);
+        }
+
+        moves[0] = MOV_HARDDROP;
+        royale.UpdateFrame(moves);
+
+        const int target = royale.GetTarget(0);
+        ASSERT_EQ(1, target != 0);
+        ASSERT_EQ(4, royale.GetAttackSent(0));
+        ASSERT_EQ(4, boards.GetPendingGarbage(target));
+
+        // Topping out after the attack is a KO for player 0
+        moves[0] = 0;
+        moves[target] = MOV_HARDDROP;
+        for (int i = 0; i < 2; i++)
+            royale.UpdateFrame(moves);
+
+        // The garbage rises under the next piece, with one hole per line
+        int garbage_count = 0;
+        for (int x = 0; x < FIELD_WIDTH; x++)
+            garbage_count += boards.GetFieldTileKind(target, Point(x, 0)) == G;
+        ASSERT_EQ(0, boards.GetPendingGarbage(target));
+        ASSERT_EQ(FIELD_WIDTH - 1, garbage_count);
+
+        while (!boards.IsGameOver(target))
+            royale.UpdateFrame(moves);
+        royale.UpdateFrame(moves);
+
+        ASSERT_EQ(1, royale.GetKoCount(0));
+        ASSERT_EQ(3, royale.GetPlace(target));
+        ASSERT_EQ(2, royale.GetAliveCount());
+    }
+    // Game batch ===========================================
+    {
+        const int GAME_COUNT = 8;
+        static const int moves[] = {
+            MOV_LEFT, MOV_RIGHT, MOV_DOWN, ROT_LEFT, ROT_RIGHT, HOLD_PIECE,
+            MOV_LEFT | ROT_RIGHT, MOV_RIGHT | MOV_DOWN, MOV_HARDDROP, 0, 0, 0,
+        };
+
+        std::vector<Tetris> games(GAME_COUNT);
+        GameBatch batch(GAME_COUNT);
+        std::vector<unsigned int> seeds(GAME_COUNT);
+        std::vector<int> batch_moves(GAME_COUNT);
+
+        for (int i = 0; i < GAME_COUNT; i++) {
+            seeds[i] = i + 1;
+            games[i].EnableLog(false);
+            games[i].SetRandomSeed(seeds[i]);
+            games[i].PlayGame();
+        }
+        batch.PlayGames(seeds.data());
+
+        std::minstd_rand rng(1);
+
+        for (int frame = 0; frame < 3000; frame++) {
+            for (int i = 0; i < GAME_COUNT; i++) {
+                batch_moves[i] = moves[rng() % 12];
+                games[i].UpdateFrame(batch_moves[i]);
+            }
+            batch.UpdateFrame(batch_moves.data());
+
+            for (int i = 0; i < GAME_COUNT; i++) {
+                ASSERT_EQ(games[i].IsGameOver(), batch.IsGameOver(i));
+                ASSERT_EQ(games[i].GetScore(), batch.GetScore(i));
+                ASSERT_EQ(games[i].GetTotalLineCount(), batch.GetTotalLineCount(i));
+                ASSERT_EQ(games[i].GetTspinKind(), batch.GetTspinKind(i));
+                ASSERT_EQ(games[i].GetCurrentPiece().tiles[0], batch.GetCurrentPiece(i).tiles[0]);
+                ASSERT_EQ(games[i].GetCurrentPiece().tiles[3], batch.GetCurrentPiece(i).tiles[3]);
+            }
+        }
+
+        // The same at 20G, set again every frame as line clears reset it
+        for (int i = 0; i < GAME_COUNT; i++) {
+            games[i].PlayGame();
+            batch.PlayGame(i, seeds[i]);
+        }
+
+        int instant_lock_count = 0;
+        for (int frame = 0; frame < 3000; frame++) {
+            for (int i = 0; i < GAME_COUNT; i++) {
+                batch_moves[i] = moves[rng() % 12];
+                games[i].SetGravity(GetLevelGravity(20));
+                batch.SetGravity(i, GetLevelGravity(20));
+                games[i].UpdateFrame(batch_moves[i]);
+
+                GameEvent event;
+                while (games[i].PollEvent(event))
+                    instant_lock_count += event.kind == EVENT_LOCK;
+            }
+            batch.UpdateFrame(batch_moves.data());
+
+            for (int i = 0; i < GAME_COUNT; i++) {
+                ASSERT_EQ(games[i].IsGameOver(), batch.IsGameOver(i));
+                ASSERT_EQ(games[i].GetScore(), batch.GetScore(i));
+                ASSERT_EQ(games[i].GetTspinKind(), batch.GetTspinKind(i));
+                ASSERT_EQ(games[i].GetCurrentPiece().tiles[0], batch.GetCurrentPiece(i).tiles[0]);
+                ASSERT_EQ(games[i].GetCurrentPiece().tiles[3], batch.GetCurrentPiece(i).tiles[3]);
+            }
+        }
+        ASSERT_EQ(1, instant_lock_count > 100);
+
+        // Placements
+        std::vector<int> rotations(GAME_COUNT), xs(GAME_COUNT);
+        std::vector<char> results(GAME_COUNT);
+        bool batch_results[GAME_COUNT];
+
+        for (int i = 0; i < GAME_COUNT; i++) {
+            games[i].PlayGame();
+            batch.PlayGame(i, seeds[i]);
+        }
+
+        for (int n = 0; n < 300; n++) {
+            for (int i = 0; i < GAME_COUNT; i++) {
+                rotations[i] = rng() % 4;
+                xs[i] = rng() % FIELD_WIDTH;
+                results[i] = games[i].PlacePiece(rotations[i], xs[i]);
+            }
+            batch.PlacePiece(rotations.data(), xs.data(), batch_results);
+
+            // Garbage now and then, which attacks cancel
+            if (n % 8 == 0) {
+                const int hole_x = rng() % FIELD_WIDTH;
+                for (int i = 0; i < GAME_COUNT; i++) {
+                    games[i].ReceiveGarbage(2, hole_x);
+                    batch.ReceiveGarbage(i, 2, hole_x);
+                }
+            }
+
+            for (int i = 0; i < GAME_COUNT; i++) {
+                ASSERT_EQ(results[i], batch_results[i]);
+                ASSERT_EQ(games[i].GetScore(), batch.GetScore(i));
+                ASSERT_EQ(games[i].GetPendingGarbage(), batch.GetPendingGarbage(i));
+                ASSERT_EQ(games[i].PopAttack(), batch.PopAttack(i));
+            }
+        }
+
+        for (int i = 0; i < GAME_COUNT; i++)
+            for (int y = 0; y < FIELD_HEIGHT; y++)
+                for (int x = 0; x < FIELD_WIDTH; x++)
+                    ASSERT_EQ(games[i].GetFieldTileKind(Point(x, y)),
+                            batch.GetFieldTileKind(i, Point(x, y)));
+    }
+    // Field sizes ===========================================
+    {
+        static_assert(sizeof(RowMask<4>) == 1, "");
+        static_assert(sizeof(RowMask<10>) == 2, "");
+        static_assert(sizeof(RowMask<20>) == 4, "");
+
+        BasicField<6, FIELD_HEIGHT> field;
+
+        for (int x = 0; x < 6; x++)
+            field.SetTileKind(Point(x, 0), x == 5 ? I : O);
+        field.SetTileKind(Point(2, 1), T);
+
+        ASSERT_EQ(1, field.GetClearedLineCount());
+        ASSERT_EQ(B, field.GetTileKind(Point(6, 0)));
+        field.ClearLines();
+        ASSERT_EQ(T, field.GetTileKind(Point(2, 0)));
+        ASSERT_EQ(E, field.GetTileKind(Point(5, 0)));
+
+        // Narrow and tall batches play until they top out
+        BasicGameBatch<4, FIELD_HEIGHT> narrow(2);
+        BasicGameBatch<FIELD_WIDTH, 2 * FIELD_HEIGHT> tall(2);
+        const unsigned int seeds[2] = {1, 2};
+        const int rotations[2] = {0, 0};
+        const int narrow_xs[2] = {1, 1};
+        const int tall_xs[2] = {4, 4};
+
+        narrow.PlayGames(seeds);
+        tall.PlayGames(seeds);
+
+        for (int i = 0; i < 200; i++) {
+            narrow.PlacePiece(rotations, narrow_xs, nullptr);
+            tall.PlacePiece(rotations, tall_xs, nullptr);
+        }
+
+        ASSERT_EQ(1, narrow.IsGameOver(0) && narrow.IsGameOver(1));
+        ASSERT_EQ(1, tall.IsGameOver(0) && tall.IsGameOver(1));
+        ASSERT_EQ(1, tall.GetFieldTileKind(0, Point(4, 2 * FIELD_HEIGHT - 2)) == E);
+    }
+    // Rotation systems ===========================================
+    {
+        // Cells a piece covers after turning right from spawn position
+        auto get_cells = [](int kind, int turns, bool ars) {
+            Point pos = {4, 10};
+            std::array<Point, 4> cells;
+
+            for (int r = 0; r < turns; r++)
+                pos += ars ? ARS::GetKickOffset(kind, r, r + 1, 0) :
+                    NRS::GetKickOffset(kind, r, r + 1, 0);
+
+            const Piece piece = GetPiece(kind, turns);
+            for (int i = 0; i < 4; i++)
+                cells[i] = pos + piece.tiles[i];
+            std::sort(cells.begin(), cells.end(), [](Point a, Point b) {
+                return a.y != b.y ? a.y < b.y : a.x < b.x;
+            });
+            return cells;
+        };
+
+        // I, S and Z have two states
+        for (int kind: {I, S, Z}) {
+            for (bool ars: {true, false}) {
+                for (int i = 0; i < 4; i++) {
+                    ASSERT_EQ(get_cells(kind, 0, ars)[i], get_cells(kind, 2, ars)[i]);
+                    ASSERT_EQ(get_cells(kind, 1, ars)[i], get_cells(kind, 3, ars)[i]);
+                }
+            }
+        }
+
+        // O never moves
+        for (int i = 0; i < 4; i++)
+            ASSERT_EQ(get_cells(O, 0, true)[i], get_cells(O, 3, true)[i]);
+
+        // T, J and L spawn flat side up
+        BasicTetris<ARS> ars;
+        ars.SetDebugMode();
+        ars.PlayGame();
+        ars.UpdateFrame(0);
+        ASSERT_EQ(ARS::SPAWN_ROTATIONS[ars.GetTetrominoKind()], ars.GetTetrominoRotation());
+
+        // Only ARS kicks off the wall
+        ars.SetTetrominoKind(T);
+        ars.SetTetrominoRotation(1);
+        ars.SetTetrominoPos(Point(0, 10));
+        ars.UpdateFrame(ROT_LEFT);
+        ASSERT_EQ(0, ars.GetTetrominoRotation());
+        ASSERT_EQ(Point(1, 9), ars.GetTetrominoPos());
+
+        BasicTetris<NRS> nrs;
+        nrs.SetDebugMode();
+        nrs.PlayGame();
+        nrs.UpdateFrame(0);
+        nrs.SetTetrominoKind(T);
+        nrs.SetTetrominoRotation(1);
+        nrs.SetTetrominoPos(Point(0, 10));
+        nrs.UpdateFrame(ROT_LEFT);
+        ASSERT_EQ(1, nrs.GetTetrominoRotation());
+    }
+    // Perft ===========================================
+    {
+        Field field;
+        MoveGenerator<SRS> generator;
+
+        // Distinct placements on an empty board
+        const int kinds[] = {I, O, S, Z, J, L, T};
+        const int counts[] = {17, 9, 17, 17, 34, 34, 34};
+        for (int i = 0; i < 7; i++)
+            ASSERT_EQ(counts[i], (int) generator.Perft(field, &kinds[i], 1));
+
+        // Regression counts through the real kicks and line clears
+        const int sequence[] = {Z, J, O};
+        ASSERT_EQ(591, (int) generator.Perft(field, sequence, 2));
+        ASSERT_EQ(5511, (int) generator.Perft(field, sequence, 3));
+
+        // Swapped placements of the same kind reach the same board
+        const int squares[] = {O, O, O, O, O};
+        const uint64_t square_count = generator.Perft(field, squares, 4);
+        TranspositionTable table(12);
+        generator.SetTranspositionTable(&table);
+        ASSERT_EQ((int) square_count, (int) generator.Perft(field, squares, 4));
+        ASSERT_EQ(1, table.GetHitCount() > 0);
+
+        // With hold, the held and the next piece may go first. Counts the
+        // table has for the same pieces without hold aren't reused.
+        ASSERT_EQ(5511, (int) generator.Perft(field, sequence, 3));
+        generator.SetHoldEnable(true);
+        generator.SetTranspositionTable(nullptr);
+        const uint64_t hold_count = generator.Perft(field, sequence, 2);
+        generator.SetTranspositionTable(&table);
+        ASSERT_EQ((int) hold_count, (int) generator.Perft(field, sequence, 2));
+        ASSERT_EQ(17 + 34, (int) generator.Perft(field, sequence, 1));
+
+        // Holding an O for an O gives no new sequences
+        generator.SetTranspositionTable(nullptr);
+        ASSERT_EQ(9, (int) generator.Perft(field, squares, 1));
+        ASSERT_EQ((int) square_count, (int) generator.Perft(field, squares, 4));
+    }
+
+    // Perfect clear solver ===========================
+    {
+        // Two lines with a 2x2 gap on the left
+        PcQuery query;
+        for (int y = 0; y < 2; y++) {
+            for (int x = 2; x < FIELD_WIDTH; x++)
+                query.field.SetTileKind(Point(x, y), J);
+        }
+        query.height = 2;
+        query.max_pieces = 2;
+        query.current = O;
+
+        PcSolver solver;
+        std::vector<PcSolution> solutions = solver.Solve(query);
+        ASSERT_EQ(2, (int) solutions.size());
+        ASSERT_EQ(1, solutions[0].probability == 1);
+        ASSERT_EQ(0, (int) solutions[0].use_hold);
+        ASSERT_EQ(1, (int) solutions[0].placements.size());
+        ASSERT_EQ(0, solutions[0].placements[0].pos.x + bbox_min(GetPiece(O, 0)).x);
+
+        // Holding it leaves a 1 in 7 chance the next bag starts with an O
+        ASSERT_EQ(1, (int) solutions[1].use_hold);
+        ASSERT_EQ(1, std::abs(solutions[1].probability - 1. / 7) < 1e-9);
+
+        // The same on a thread per first move, with the crash log on
+        EnableLog(true);
+        solver.SetThreadCount(3);
+        const std::vector<PcSolution> threaded = solver.Solve(query);
+        ASSERT_EQ(2, (int) threaded.size());
+        ASSERT_EQ(1, std::abs(threaded[1].probability - 1. / 7) < 1e-9);
+        solver.SetThreadCount(1);
+
+        // An I does not fit, so hold it and hope for the O of the last two
+        query.current = I;
+        query.bag_mask = 1 << O | 1 << T;
+        solutions = solver.Solve(query);
+        ASSERT_EQ(1, (int) solutions.size());
+        ASSERT_EQ(1, solutions[0].probability == 0.5);
+        ASSERT_EQ(1, (int) solutions[0].use_hold);
+
+        // The parity of a single column gap cannot be fixed by O, S or Z
+        query.field.Clear();
+        for (int y = 0; y < 4; y++) {
+            for (int x = 1; x < FIELD_WIDTH; x++)
+                query.field.SetTileKind(Point(x, y), J);
+        }
+        query.height = 4;
+        query.current = O;
+        query.preview = {S, Z};
+        query.bag_mask = 1 << O;
+        ASSERT_EQ(0, (int) solver.Solve(query).size());
+        ASSERT_EQ(0, (int) solver.GetNodeCount());
+
+        query.preview = {I};
+        solutions = solver.Solve(query);
+        ASSERT_EQ(1, (int) solutions.size());
+        ASSERT_EQ(1, (int) solutions[0].use_hold);
+
+        // Only the current J fixes the parity of a J gap and an O gap
+        query.field.Clear();
+        for (int y = 0; y < 3; y++) {
+            for (int x = 0; x < FIELD_WIDTH; x++) {
+                const bool is_j_gap = x == 0 || (x == 1 && y == 2);
+                const bool is_o_gap = (x == 4 || x == 5) && y > 0;
+                if (!is_j_gap && !is_o_gap)
+                    query.field.SetTileKind(Point(x, y), G);
+            }
+        }
+        query.height = 3;
+        query.current = J;
+        query.preview = {O, S, Z, I, L};
+        query.bag_mask = 1 << T;
+        for (int max_pieces = 2; max_pieces <= 3; max_pieces++) {
+            query.max_pieces = max_pieces;
+            solutions = solver.Solve(query);
+            ASSERT_EQ(1, (int) solutions.size() > 0);
+            ASSERT_EQ(1, solutions[0].probability == 1);
+            ASSERT_EQ(0, (int) solutions[0].use_hold);
+        }
+
+        // A new game has the rest of its first bag after the preview
+        Tetris tetris;
+        tetris.PlayGame();
+        tetris.UpdateFrame(0);
+        query = MakePcQuery(tetris, 4, 10);
+        ASSERT_EQ(tetris.GetTetrominoKind(), query.current);
+        ASSERT_EQ(tetris.GetNextPieceCount(), (int) query.preview.size());
+        ASSERT_EQ(7 - 1 - tetris.GetNextPieceCount(),
+                (int) std::bitset<8>(query.bag_mask).count());
+    }
+
+    // T-spin slots ===================================
+    {
+        Field field;
+        ASSERT_EQ(0, (int) HasTspinCorners(field));
+
+        // A T-spin double slot under a roof at x = 3
+        for (int x = 0; x < FIELD_WIDTH; x++) {
+            if (x != 4)
+                field.SetTileKind(Point(x, 0), G);
+            if (x < 3 || x > 5)
+                field.SetTileKind(Point(x, 1), G);
+            if (x < 4)
+                field.SetTileKind(Point(x, 2), G);
+        }
+        ASSERT_EQ(1 << 4, (int) GetTspinCornerMask(field, 1));
+
+        TspinFinder finder;
+        std::vector<TspinSlot> slots;
+        finder.Find(field, slots);
+
+        const TspinSlot *tsd = nullptr;
+        for (const auto &slot: slots) {
+            if (slot.tspin == TSPIN_NORMAL && slot.line_count == 2)
+                tsd = &slot;
+        }
+        ASSERT_EQ(1, tsd != nullptr);
+
+        // The path replays from spawn into the slot, ending with a rotation
+        Tetromino tet(T, SPAWN_POS);
+        for (int move: tsd->path) {
+            if (move & (ROT_LEFT | ROT_RIGHT)) {
+                const int old_rotation = tet.rotation;
+                tet.rotation = (tet.rotation + (move == ROT_RIGHT ? 1 : 3)) % 4;
+                ASSERT_EQ(1, tet.KickWall<SRS>(field, old_rotation));
+            }
+            else {
+                tet.pos += move == MOV_LEFT ? Point(-1, 0) :
+                    move == MOV_RIGHT ? Point(1, 0) : Point(0, -1);
+                ASSERT_EQ(1, tet.CanFit(field));
+            }
+        }
+        ASSERT_EQ(1, (tsd->path.back() & (ROT_LEFT | ROT_RIGHT)) != 0);
+        ASSERT_EQ(tsd->placement.pos, tet.pos);
+        ASSERT_EQ(tsd->placement.rotation, tet.rotation);
+
+        // Boards without the corners are skipped
+        Field fields[2];
+        fields[1] = field;
+        std::vector<std::vector<TspinSlot>> batch;
+        ASSERT_EQ(1, finder.FindBatch(fields, 2, batch));
+        ASSERT_EQ(0, (int) batch[0].size());
+        ASSERT_EQ((int) slots.size(), (int) batch[1].size());
+    }
+
+    // Bot ============================================
+    {
+        const Grid grid = {
+            {0,0,0,0,I,0,0,0,0,0},
+            {0,0,0,0,I,0,0,0,0,0},
+            {0,0,0,0,I,0,0,0,0,0},
+            {0,0,0,0,I,0,0,0,0,0},
+            {0,0,0,0,0,0,0,0,0,0},
+            {0,0,0,0,0,0,0,0,0,0},
+            {O,O,O,O,O,O,O,O,O,0},
+            {O,O,O,O,O,O,O,O,O,0},
+            {O,O,O,O,O,O,O,O,O,0},
+            {O,O,O,O,O,O,O,O,O,0},
+        };
+
+        // An I fills the well for a tetris
+        Tetris tetris;
+        Bot bot;
+        const BotMove move = find_bot_move(bot, tetris, grid);
+        ASSERT_EQ(0, (int) move.use_hold);
+
+        // Where it lands, as a hint would draw it
+        Piece landing = GetPiece(move.placement.kind, move.placement.rotation);
+        for (auto &tile: landing.tiles) {
+            tile += move.placement.pos;
+            ASSERT_EQ(9, tile.x);
+            ASSERT_EQ(1, tile.y < 4);
+        }
+
+        // The search thread finds the same move without blocking the caller
+        bot.SetBudget(std::chrono::microseconds(0));
+        bot.StartSearch(tetris);
+        ASSERT_EQ(1, bot.IsDue());
+
+        BotMove async_move;
+        int depth = 0;
+        for (int i = 0; i < 10000 && !(bot.GetBestMove(async_move, &depth) && depth >= 1); i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ASSERT_EQ(1, depth >= 1);
+        bot.StopSearch();
+        ASSERT_EQ(0, (int) bot.GetBestMove(async_move));
+
+        for (int i = 0; i < move.input_count; i++)
+            tetris.UpdateFrame(move.inputs[i]);
+        ASSERT_EQ(MOV_HARDDROP, move.inputs[move.input_count - 1]);
+        ASSERT_EQ(4, tetris.GetClearedLineCount());
+
+        // Only a tuck under the roof fills the holes, and its inputs get there
+        const Grid roof = {
+            {0,0,0,0,0,0,0,0,0,I},
+            {0,0,0,0,0,0,0,0,0,I},
+            {0,0,0,0,0,0,0,0,0,I},
+            {0,0,0,0,0,0,0,0,0,I},
+            {O,O,0,0,0,0,0,0,0,0},
+            {0,0,0,0,O,O,O,O,O,O},
+            {0,0,0,0,O,O,O,O,O,O},
+        };
+
+        Tetris tucking;
+        tucking.SetDebugMode();
+        tucking.SetHoldEnable(false);
+        tucking.PlayGame();
+        tucking.UpdateFrame(0);
+        setup_field(tucking, roof);
+        tucking.SetTetrominoRotation(0);
+        tucking.SetTetrominoPos(SPAWN_POS);
+        tucking.SetTetrominoKind(O);
+
+        const BotMove tuck = bot.FindMove(tucking, 1);
+        Tetris placing = tucking;
+        for (int i = 0; i < tuck.input_count; i++)
+            tucking.UpdateFrame(tuck.inputs[i]);
+
+        // Placed headless, the tuck lands in the same spot
+        ASSERT_EQ(1, (int) placing.PlacePiece(tuck.placement));
+
+        for (int y = 0; y < 2; y++) {
+            for (int x = 0; x < 2; x++) {
+                ASSERT_EQ(O, tucking.GetFieldTileKind(Point(x, y)));
+                ASSERT_EQ(O, placing.GetFieldTileKind(Point(x, y)));
+            }
+        }
+
+        // Steered a frame at a time, pieces lock where the bot placed them
+        // even when gravity pulls them down faster than they shift
+        Tetris falling;
+        falling.SetRandomSeed(11);
+        falling.PlayGame();
+
+        BotMove next;
+        bool is_moving = false;
+        int locked = 0;
+
+        for (int frame = 0; frame < 5000 && locked < 50 && !falling.IsGameOver(); frame++) {
+            falling.SetGravity(GetLevelGravity(15, falling.GetTickRate()));
+            falling.UpdateFrame(is_moving ? bot.GetInput(falling, next) : 0);
+
+            GameEvent event;
+            while (falling.PollEvent(event)) {
+                if (event.kind == EVENT_SPAWN && !(is_moving && next.use_hold &&
+                        falling.GetTetrominoKind() == next.placement.kind)) {
+                    next = bot.FindMove(falling, 1);
+                    is_moving = true;
+                }
+                else if (event.kind == EVENT_LOCK) {
+                    Piece piece = GetPiece(next.placement.kind, next.placement.rotation);
+                    for (auto &tile: piece.tiles)
+                        ASSERT_EQ(next.placement.kind, falling.GetFieldTileKind(tile + next.placement.pos));
+                    is_moving = false;
+                    locked++;
+                }
+            }
+        }
+        ASSERT_EQ(50, locked);
+
+        // Headless games place each move at once, so they last
+        Tetris headless;
+        headless.SetRandomSeed(11);
+        headless.PlayGame();
+
+        int played = 0;
+        while (played < 200 && PlayBotMove(bot, headless, 1))
+            played++;
+        ASSERT_EQ(200, played);
+    }
+
+    // Rollout evaluator ==============================
+    {
+        // An O fills a two wide gap for a double
+        const Grid grid = {
+            {0,0,0,0,I,I,0,0,0,0},
+            {0,0,0,0,I,I,0,0,0,0},
+            {0,0,0,0,0,0,0,0,0,0},
+            {0,0,0,0,0,0,0,0,0,0},
+            {O,O,O,O,O,O,O,O,0,0},
+            {O,O,O,O,O,O,O,O,0,0},
+        };
+
+        // The gap, and a flat drop over the middle
+        Tetris tetris;
+        tetris.SetRandomSeed(7);
+        BotMove moves[2];
+        Bot bot;
+        moves[0] = find_bot_move(bot, tetris, grid);
+        moves[1].placement = Tetromino(tetris.GetTetrominoKind(), SPAWN_POS);
+        moves[1].placement.rotation = tetris.GetTetrominoRotation();
+        moves[1].inputs[moves[1].input_count++] = MOV_HARDDROP;
+
+        // Only pieces past the preview move, and only within their bag
+        Tetris shuffled = tetris;
+        shuffled.ShuffleHiddenPieces(1);
+        for (int i = 0; i < 3; i++)
+            ASSERT_EQ(tetris.GetPieceKindList(i), shuffled.GetPieceKindList(i));
+
+        for (auto range: {std::make_pair(0, 6), std::make_pair(6, 13)}) {
+            std::vector<int> a, b;
+            for (int i = range.first; i < range.second; i++) {
+                a.push_back(tetris.GetPieceKindList(i));
+                b.push_back(shuffled.GetPieceKindList(i));
+            }
+            std::sort(a.begin(), a.end());
+            std::sort(b.begin(), b.end());
+            ASSERT_EQ(1, a == b);
+        }
+
+
+        RolloutEvaluator evaluator;
+        evaluator.SetRolloutCount(8);
+        evaluator.SetPieceLimit(0);
+
+        std::vector<RolloutResult> results;
+        evaluator.Evaluate(tetris, moves, 2, results);
+        ASSERT_EQ(2, (int) results.size());
+        ASSERT_EQ(1, results[0].lines.mean == 2);
+        ASSERT_EQ(1, results[0].lines.variance == 0);
+        ASSERT_EQ(1, results[0].score.mean > results[1].score.mean);
+        ASSERT_EQ(1, results[1].lines.mean == 0);
+        ASSERT_EQ(1, results[0].survival.mean == 1);
+
+        // Futures depend on the seed, not on the threads that play them,
+        // even with the crash log on
+        EnableLog(true);
+        tetris.EnableLog(true);
+        std::vector<RolloutResult> other;
+        evaluator.SetPieceLimit(20);
+        evaluator.Evaluate(tetris, moves, 2, results);
+        evaluator.SetThreadCount(3);
+        evaluator.Evaluate(tetris, moves, 2, other);
+
+        for (int i = 0; i < 2; i++) {
+            ASSERT_EQ(1, results[i].score.mean == other[i].score.mean);
+            ASSERT_EQ(1, results[i].score.variance == other[i].score.variance);
+            ASSERT_EQ(1, results[i].survival.mean == other[i].survival.mean);
+            ASSERT_EQ(1, results[i].survival.mean > 1 && results[i].survival.mean <= 21);
+        }
+        ASSERT_EQ(1, results[0].lines.mean >= 2);
+    }
+
+    // MLP evaluator ==================================
+    {
+        // Minus the count of filled cells, through one path of the network
+        std::unique_ptr<MlpWeights> weights(new MlpWeights());
+        for (int i = 0; i < MlpWeights::INPUT_COUNT; i++)
+            weights->input_weights[i][0] = 2;
+        weights->input_scale = 0.5;
+        weights->hidden_weights[0][0] = 1;
+        weights->output_weights[0] = -1;
+
+        ASSERT_EQ(1, SaveMlpWeights("mlp_test.bin", *weights));
+        std::unique_ptr<MlpWeights> loaded(new MlpWeights());
+        ASSERT_EQ(1, LoadMlpWeights("mlp_test.bin", *loaded));
+        remove("mlp_test.bin");
+        ASSERT_EQ(0, memcmp(weights.get(), loaded.get(), sizeof(MlpWeights)));
+
+        Field fields[2];
+        fields[1].SetTileKind(Point(0, 0), I);
+        fields[1].SetTileKind(Point(9, 19), I);
+
+        MlpEvaluator evaluator(*loaded);
+        double values[2];
+        evaluator.Evaluate(fields, 2, values);
+        ASSERT_EQ(1, values[0] == 0);
+        ASSERT_EQ(1, values[1] == -2);
+
+        // Both kernels add in the same order
+        std::minstd_rand rng(5);
+        std::uniform_real_distribution<float> real(-1, 1);
+        weights->input_scale = 1.0f / 64;
+        for (int i = 0; i < MlpWeights::HIDDEN_COUNT; i++) {
+            for (int j = 0; j < MlpWeights::INPUT_COUNT; j++)
+                weights->input_weights[j][i] = (int) (real(rng) * 127);
+            for (int j = 0; j < MlpWeights::HIDDEN_COUNT; j++)
+                weights->hidden_weights[j][i] = real(rng);
+            weights->input_biases[i] = real(rng);
+            weights->hidden_biases[i] = real(rng);
+            weights->output_weights[i] = real(rng);
+        }
+
+        Field boards[8];
+        for (int i = 0; i < 8; i++) {
+            for (int y = 0; y < FIELD_HEIGHT / 2; y++) {
+                for (int x = 0; x < FIELD_WIDTH; x++) {
+                    if (rng() % 3)
+                        boards[i].SetTileKind(Point(x, y), G);
+                }
+            }
+        }
+
+        MlpEvaluator random_evaluator(*weights);
+        double simd_values[8];
+        double scalar_values[8];
+        random_evaluator.Evaluate(boards, 8, simd_values);
+        random_evaluator.SetSimdEnable(false);
+        ASSERT_EQ(0, (int) random_evaluator.IsSimdEnable());
+        random_evaluator.Evaluate(boards, 8, scalar_values);
+        for (int i = 0; i < 8; i++)
+            ASSERT_EQ(1, simd_values[i] == scalar_values[i]);
+
+        // A bot scoring boards with it turns a T into a notch for a double
+        const Grid grid = {
+            {0,0,0,0,I,0,0,0,0,0},
+            {0,0,0,I,I,I,0,0,0,0},
+            {0,0,0,0,0,0,0,0,0,0},
+            {0,0,0,0,0,0,0,0,0,0},
+            {O,O,O,O,O,O,O,O,0,0},
+            {O,O,O,O,O,O,O,O,O,0},
+        };
+
+        Tetris tetris;
+        Bot bot;
+        bot.SetEvaluator(&evaluator);
+        const BotMove move = find_bot_move(bot, tetris, grid);
+        ASSERT_EQ(1, (int) PlaceBotMove(tetris, move));
+        ASSERT_EQ(2, tetris.GetClearedLineCount());
+    }
+
+    // League =========================================
+    {
+        // A bot against one that drops every piece in the middle
+        class DropPlayer : public LeaguePlayer {
+        public:
+            int GetMove(const Tetris &tetris) override { return MOV_HARDDROP; }
+        };
+
+        League league;
+        ASSERT_EQ(0, league.AddEntry("bot", []() {
+            return std::unique_ptr<LeaguePlayer>(new BotPlayer(BotWeights(), 1));
+        }));
+        ASSERT_EQ(1, league.AddEntry("drop", []() {
+            return std::unique_ptr<LeaguePlayer>(new DropPlayer());
+        }));
+        league.SetSeeds({3});
+        league.SetThreadCount(2);
+        league.SetFrameLimit(20000);
+        league.PlayRoundRobin();
+
+        // One seed from both seats
+        const std::vector<LeagueGame> &games = league.GetGames();
+        ASSERT_EQ(2, (int) games.size());
+        ASSERT_EQ(0, games[0].entries[0]);
+        ASSERT_EQ(1, games[1].entries[0]);
+
+        const std::vector<LeagueStanding> standings = league.GetStandings();
+        ASSERT_EQ(2, standings[0].win_count);
+        ASSERT_EQ(2, standings[1].loss_count);
+        ASSERT_EQ(1, standings[0].score == 1 && standings[0].score_low > 0.3);
+        ASSERT_EQ(1, standings[0].elo > 0 && standings[0].elo == -standings[1].elo);
+
+        // Replays end the same way
+        for (const LeagueGame &game: games) {
+            Match match;
+            ASSERT_EQ(1, PlayLeagueReplay(game, match));
+            ASSERT_EQ(1, match.IsOver());
+            ASSERT_EQ(1, match.GetFrame() == game.frame_count);
+            ASSERT_EQ(game.winner, game.entries[match.GetWinner()]);
+        }
+    }
 }
@@ -1,60 +1,79 @@
 #include "tetris.h"
 #include "log.h"
+#include "tspin.h"
+#include "trace.h"
 #include <algorithm>
 #include <iostream>
 #include <cassert>
 #include <random>
 #include <array>
 
-static float get_gravity(int level)
+int GetLevelGravity(int level, int tick_rate)
 {
-    static const float gravity_table[21] = {
-        // level 0 - 20
-        0.0, 0.01667, 0.021017, 0.026977, 0.035256, 0.04693, 0.06361, 0.0879, 0.1236,
-        0.1775, 0.2598, 0.388, 0.59, 0.92, 1.46, 2.36, 3.91, 6.61, 11.43, 20,
+    static const int gravity_table[21] = {
+        // level 0 - 20, in subcells per frame at 60 Hz
+        0, 1092, 1377, 1768, 2311, 3076, 4169, 5761, 8100, 11633, 17026,
+        25428, 38666, 60293, 95683, 154665, 256246, 433193, 749076, 1310720, 1310720,
     };
 
-    if (level < 0)
-        return gravity_table[0];
-    else if (level > 20)
-        return gravity_table[20];
-    else
-        return gravity_table[level];
+    level = std::max(0, std::min(level, 20));
+    return gravity_table[level] * 60 / tick_rate;
 }
 
-static const Point SPAWN_POS = {4, 19};
+void ShufflePieces(int *kinds, int count, std::minstd_rand &rng)
+{
+    for (int i = count - 1; i > 0; i--)
+        std::swap(kinds[i], kinds[rng() % (i + 1)]);
+}
 
-Tetris::Tetris()
+template <typename Rules>
+BasicTetris<Rules>::BasicTetris()
 {
 }
 
-Tetris::~Tetris()
+template <typename Rules>
+BasicTetris<Rules>::~BasicTetris()
 {
 }
 
-void Tetris::PlayGame()
+template <typename Rules>
+void BasicTetris<Rules>::PlayGame()
 {
     // Pieces
     InitializePieces();
 
     // Bags
-    bag_.clear();
+    if (has_random_seed_) {
+        rng_.seed(random_seed_);
+    }
+    else {
+        std::random_device rd;
+        rng_.seed(rd());
+    }
+
+    bag_.Clear();
     for (int i = 0; i < 2; i++)
         generate_bag();
 
     // Field
     field_.Clear();
-    field_.SetTopHole(2, 7);
 
     // Game
     is_playing_ = true;
     is_game_over_ = false;
     frame_ = 1;
-    gravity_ = get_gravity(1);
+    gravity_ = GetLevelGravity(1, tick_rate_);
 
     // Score
     scorer_.Reset();
 
+    // Versus
+    garbage_.Clear();
+    is_garbage_due_ = false;
+    attack_ = 0;
+
+    events_.Clear();
+
     // Start
     ghost_ = Tetromino();
     hold_ = Tetromino();
@@ -62,13 +81,15 @@ void Tetris::PlayGame()
     need_spawn_ = true;
 }
 
-void Tetris::start_lock_delay_timer()
+template <typename Rules>
+void BasicTetris<Rules>::start_lock_delay_timer()
 {
     if (lock_delay_timer_ == -1)
-        lock_delay_timer_ = playing_fps_ / 2;
+        lock_delay_timer_ = tick_rate_ / 2;
 }
 
-void Tetris::reset_lock_delay_timer()
+template <typename Rules>
+void BasicTetris<Rules>::reset_lock_delay_timer()
 {
     if (lock_delay_timer_ > 0 && reset_counter_ < 16) {
         lock_delay_timer_ = -1;
@@ -76,80 +97,116 @@ void Tetris::reset_lock_delay_timer()
     }
 }
 
-void Tetris::tick_lock_delay_timer()
+template <typename Rules>
+void BasicTetris<Rules>::tick_lock_delay_timer()
 {
     if (lock_delay_timer_ > 0)
         lock_delay_timer_--;
 }
 
-void Tetris::reset_all_timers()
+template <typename Rules>
+void BasicTetris<Rules>::reset_all_timers()
 {
     lock_delay_timer_ = -1;
     reset_counter_ = 0;
 }
 
-bool Tetris::spawn_tetromino()
+template <typename Rules>
+bool BasicTetris<Rules>::spawn_tetromino()
 {
     // Bag
-    if (bag_.size() == 7)
+    if (bag_.Size() == 7)
         generate_bag();
 
-    const int kind = bag_.front();
-    bag_.pop_front();
+    const int kind = bag_.Front();
+    bag_.PopFront();
 
     // Tetromino
     tetromino_ = Tetromino(kind, SPAWN_POS);
+    tetromino_.rotation = Rules::SPAWN_ROTATIONS[kind];
 
     need_spawn_ = false;
     return tetromino_.CanFit(field_);
 }
 
-void Tetris::generate_bag()
+template <typename Rules>
+void BasicTetris<Rules>::generate_bag()
 {
     std::array<int, 7> kinds = {I, O, S, Z, J, L, T};
-    std::random_device rd;
-    std::mt19937 rng(rd());
-    std::shuffle(kinds.begin(), kinds.end(), rng);
+    ShufflePieces(kinds.data(), kinds.size(), rng_);
 
     for (auto kind: kinds)
-        bag_.push_back(kind);
+        bag_.PushBack(kind);
 }
 
-bool Tetris::hard_drop(Tetromino &tet)
+template <typename Rules>
+bool BasicTetris<Rules>::hard_drop(Tetromino &tet)
 {
-    Tetromino &current = tet;
+    TET_TRACE_SCOPE("Tetris::hard_drop");
+
+    const int distance = get_drop_distance(tet);
+    tet.pos.y -= distance;
+
+    return distance > 0;
+}
+
+template <typename Rules>
+int BasicTetris<Rules>::get_drop_distance(const Tetromino &tet) const
+{
+    const Piece piece = GetPiece(tet.kind, tet.rotation);
+    int distance = Field::HEIGHT;
+
+    // Above the stack, the column heights give the landing row directly
+    for (auto tile: piece.tiles) {
+        const Point world = tet.pos + tile;
+        const int height = field_.GetColumnHeight(world.x);
+
+        if (world.y < height) {
+            distance = -1;
+            break;
+        }
+        distance = std::min(distance, world.y - height);
+    }
+
+    if (distance >= 0)
+        return distance;
+
+    // Under an overhang, step down a cell at a time
     Tetromino moved = tet;
-    bool has_moved = false;
+    distance = 0;
 
-    do {
-        moved.pos.y--;
-    } while (moved.CanFit(field_));
+    for (moved.pos.y--; moved.CanFit(field_); moved.pos.y--)
+        distance++;
 
-    has_moved = ++moved.pos.y != current.pos.y;
-    if (has_moved)
-        current = moved;
+    return distance;
+}
 
-    return has_moved;
+template <typename Rules>
+bool BasicTetris<Rules>::is_instant_gravity() const
+{
+    return !IsDebugMode() && gravity_ >= GetLevelGravity(20, tick_rate_);
 }
 
-bool Tetris::drop_piece(int move)
+template <typename Rules>
+bool BasicTetris<Rules>::drop_piece(int move)
 {
     Tetromino &current = tetromino_;
     Tetromino moved = tetromino_;
 
     // Gravity drop
     if (!IsDebugMode())
-        gravity_drop_ -= gravity_;
+        gravity_drop_ += gravity_;
 
     if ((move & MOV_UP) && IsDebugMode())
         moved.pos.y++;
 
+    // Soft drop falls a cell per 60 Hz frame
     if (move & MOV_DOWN)
-        gravity_drop_ -= 60./60;
+        gravity_drop_ += GRAVITY_UNIT * 60 / tick_rate_;
 
-    while (gravity_drop_ <= -1) {
+    while (gravity_drop_ >= GRAVITY_UNIT) {
         moved.pos.y--;
-        gravity_drop_ += 1;
+        gravity_drop_ -= GRAVITY_UNIT;
         if (!moved.CanFit(field_)) {
             moved.pos.y++;
             break;
@@ -166,7 +223,8 @@ bool Tetris::drop_piece(int move)
     return can_move;
 }
 
-bool Tetris::shift_piece(int move)
+template <typename Rules>
+bool BasicTetris<Rules>::shift_piece(int move)
 {
     Tetromino &current = tetromino_;
     Tetromino moved = tetromino_;
@@ -186,7 +244,8 @@ bool Tetris::shift_piece(int move)
     return can_move;
 }
 
-bool Tetris::rotate_piece(int move)
+template <typename Rules>
+bool BasicTetris<Rules>::rotate_piece(int move)
 {
     Tetromino &current = tetromino_;
     Tetromino moved = tetromino_;
@@ -200,7 +259,7 @@ bool Tetris::rotate_piece(int move)
         return false;
 
     const Point old_pos = moved.pos;
-    const bool can_move = moved.KickWall(field_, current.rotation);
+    const bool can_move = moved.template KickWall<Rules>(field_, current.rotation);
     last_kick_ = old_pos - moved.pos;
 
     if (can_move)
@@ -209,8 +268,11 @@ bool Tetris::rotate_piece(int move)
     return can_move;
 }
 
-bool Tetris::move_piece(int move)
+template <typename Rules>
+bool BasicTetris<Rules>::move_piece(int move)
 {
+    TET_TRACE_SCOPE("Tetris::move_piece");
+
     const bool has_dropped = drop_piece(move);
     const bool has_shifted = shift_piece(move);
     const bool has_rotated = rotate_piece(move);
@@ -218,7 +280,8 @@ bool Tetris::move_piece(int move)
     return has_dropped || has_shifted || has_rotated;
 }
 
-bool Tetris::has_piece_landed() const
+template <typename Rules>
+bool BasicTetris<Rules>::has_piece_landed() const
 {
     Tetromino moved = tetromino_;
     moved.pos.y--;
@@ -226,7 +289,8 @@ bool Tetris::has_piece_landed() const
     return moved.CanFit(field_) == false;
 }
 
-void Tetris::hold_piece()
+template <typename Rules>
+void BasicTetris<Rules>::hold_piece()
 {
     if (!IsHoldEnable())
         return;
@@ -234,19 +298,30 @@ void Tetris::hold_piece()
     if (IsEmptyTile(hold_.kind)) {
         hold_ = Tetromino(tetromino_.kind, Point());
         need_spawn_ = true;
+        push_event(EVENT_HOLD).piece = hold_.kind;
     }
     else if (IsHoldAvailable()) {
         std::swap(tetromino_.kind, hold_.kind);
         tetromino_ = Tetromino(tetromino_.kind, SPAWN_POS);
+        tetromino_.rotation = Rules::SPAWN_ROTATIONS[tetromino_.kind];
         hold_ = Tetromino(hold_.kind, Point());
         reset_all_timers();
+
+        push_event(EVENT_HOLD).piece = hold_.kind;
+
+        // Blocked out, like a spawn
+        if (!tetromino_.CanFit(field_))
+            end_game();
     }
 
     is_hold_available_ = false;
 }
 
-void Tetris::update_ghost()
+template <typename Rules>
+void BasicTetris<Rules>::update_ghost()
 {
+    TET_TRACE_SCOPE("Tetris::update_ghost");
+
     if (!IsGhostEnable()) {
         ghost_.kind = E;
         return;
@@ -258,34 +333,18 @@ void Tetris::update_ghost()
         ghost_.kind = E;
 }
 
-void Tetris::UpdateFrame(int move)
+template <typename Rules>
+void BasicTetris<Rules>::UpdateFrame(int move)
 {
+    TET_TRACE_SCOPE("Tetris::UpdateFrame");
+
     if (IsGameOver() || IsPaused())
         return;
 
     add_log(move);
 
-    // Clears lines
-    if (GetClearedLineCount() > 0 || GetTspinKind() > 0) {
-        scorer_.Commit();
-        field_.ClearLines();
-        gravity_ = get_gravity(GetLevel());
-    }
-
-    // Spawn
-    if (need_spawn_) {
-        if (spawn_tetromino()) {
-            scorer_.Start();
-            reset_all_timers();
-            is_hold_available_ = true;
-            last_kick_ = Point();
-            tspin_kind_ = 0;
-        }
-        else {
-            is_game_over_ = true;
-            return;
-        }
-    }
+    if (!begin_piece())
+        return;
 
     // Moves
     if (move & HOLD_PIECE) {
@@ -299,6 +358,19 @@ void Tetris::UpdateFrame(int move)
 
         scorer_.AddHardDrop(old_y - tetromino_.pos.y);
     }
+    else if (is_instant_gravity()) {
+        // 20G as in TGM: the piece stays on the stack, only reaching a lower
+        // row restarts lock delay, and down locks at once
+        const int old_y = tetromino_.pos.y;
+        shift_piece(move);
+        rotate_piece(move);
+        hard_drop(tetromino_);
+
+        if (tetromino_.pos.y < old_y)
+            lock_delay_timer_ = -1;
+        if (move & MOV_DOWN)
+            lock_delay_timer_ = 0;
+    }
     else {
         const bool has_moved = move_piece(move);
         if (has_moved)
@@ -312,7 +384,7 @@ void Tetris::UpdateFrame(int move)
 
     const bool has_landed = has_piece_landed();
     if (has_landed) {
-        gravity_drop_ = 0.;
+        gravity_drop_ = 0;
         start_lock_delay_timer();
     }
 
@@ -320,25 +392,191 @@ void Tetris::UpdateFrame(int move)
     update_ghost();
 
     // Locking
-    if (lock_delay_timer_ == 0 && has_landed) {
-        field_.SetPiece(GetCurrentPiece());
+    if (lock_delay_timer_ == 0 && has_landed)
+        lock_piece();
+    else
+        tick_lock_delay_timer();
 
-        // T-Spin and line clear
-        tspin_kind_ = detect_tspin();
-        scorer_.AddLineClear(GetClearedLineCount(), tspin_kind_, IsPerfectClear());
+    frame_++;
+}
 
-        need_spawn_ = true;
+template <typename Rules>
+bool BasicTetris<Rules>::PlacePiece(int rotation, int x)
+{
+    if (IsGameOver() || IsPaused())
+        return false;
+
+    if (rotation < 0 || rotation >= 4 || !begin_piece())
+        return false;
+
+    Tetromino placed = tetromino_;
+    placed.rotation = rotation;
+    placed.pos.x = x;
+
+    if (!placed.CanFit(field_))
+        return false;
+
+    const int old_y = placed.pos.y;
+    hard_drop(placed);
+    tetromino_ = placed;
+    last_move_ = MOV_HARDDROP;
+
+    scorer_.AddHardDrop(old_y - tetromino_.pos.y);
+    update_ghost();
+    lock_piece();
+
+    frame_++;
+    return true;
+}
+
+template <typename Rules>
+bool BasicTetris<Rules>::PlacePiece(const Tetromino &placement)
+{
+    if (IsGameOver() || IsPaused())
+        return false;
+
+    if (!begin_piece() || placement.kind != tetromino_.kind || !placement.CanFit(field_))
+        return false;
+
+    Tetromino placed = placement;
+    hard_drop(placed);
+    tetromino_ = placed;
+    last_move_ = MOV_HARDDROP;
+
+    scorer_.AddHardDrop(placement.pos.y - tetromino_.pos.y);
+    update_ghost();
+    lock_piece();
+
+    frame_++;
+    return true;
+}
+
+template <typename Rules>
+bool BasicTetris<Rules>::begin_piece()
+{
+    // Clears lines
+    if (GetClearedLineCount() > 0 || GetTspinKind() > 0) {
+        const int old_level = GetLevel();
+
+        scorer_.Commit();
+        field_.ClearLines();
+        gravity_ = GetLevelGravity(GetLevel(), tick_rate_);
+
+        if (GetLevel() != old_level)
+            push_event(EVENT_LEVEL_UP).level = GetLevel();
     }
-    else {
-        tick_lock_delay_timer();
+
+    // Spawn
+    if (need_spawn_) {
+        if (is_garbage_due_ && !insert_garbage()) {
+            end_game();
+            return false;
+        }
+        is_garbage_due_ = false;
+
+        if (spawn_tetromino()) {
+            scorer_.Start();
+            reset_all_timers();
+            is_hold_available_ = true;
+            last_kick_ = Point();
+            tspin_kind_ = 0;
+            push_event(EVENT_SPAWN).piece = tetromino_.kind;
+        }
+        else {
+            end_game();
+            return false;
+        }
     }
 
-    frame_++;
+    return true;
+}
+
+template <typename Rules>
+void BasicTetris<Rules>::lock_piece()
+{
+    if (is_log_enabled_) {
+        AddLog("Tetris::lock_piece(): kind: %d, rotation: %d, pos: (%d, %d)",
+                tetromino_.kind, tetromino_.rotation, tetromino_.pos.x, tetromino_.pos.y);
+    }
+
+    field_.SetPiece(GetCurrentPiece());
+    push_event(EVENT_LOCK).piece = tetromino_.kind;
+
+    // T-Spin and line clear
+    const int line_count = GetClearedLineCount();
+    const bool is_perfect_clear = IsPerfectClear();
+
+    tspin_kind_ = detect_tspin();
+    scorer_.AddLineClear(line_count, tspin_kind_, is_perfect_clear);
+
+    if (line_count > 0 || tspin_kind_ != TSPIN_NONE) {
+        GameEvent event;
+        event.frame = frame_;
+        event.piece = tetromino_.kind;
+        event.line_count = line_count;
+        GetClearedLines(event.cleared_lines);
+        event.tspin = tspin_kind_;
+        event.is_perfect_clear = is_perfect_clear;
+        event.clear_points = scorer_.GetClearPoints();
+        event.combo_counter = scorer_.GetComboCounter();
+        event.combo_points = scorer_.GetComboPoints();
+        event.back_to_back = scorer_.GetBackToBackCounter();
+
+        if (tspin_kind_ != TSPIN_NONE) {
+            event.kind = EVENT_TSPIN;
+            events_.PushBack(event);
+        }
+        if (line_count > 0) {
+            event.kind = EVENT_CLEAR;
+            events_.PushBack(event);
+        }
+    }
+
+    // Attack offsets pending garbage first
+    attack_ += cancel_garbage(scorer_.GetAttack());
+    is_garbage_due_ = GetClearedLineCount() == 0;
+
+    need_spawn_ = true;
+
+    // Locked out, with every tile in the buffer zone above the visible rows
+    const Piece piece = GetCurrentPiece();
+    if (std::all_of(piece.tiles.begin(), piece.tiles.end(),
+                [](Point pos) { return pos.y >= FIELD_HEIGHT; }))
+        end_game();
+}
+
+template <typename Rules>
+void BasicTetris<Rules>::end_game()
+{
+    is_game_over_ = true;
+    push_event(EVENT_GAME_OVER);
+}
+
+template <typename Rules>
+GameEvent &BasicTetris<Rules>::push_event(int kind)
+{
+    GameEvent &event = events_.PushBack();
+    event = GameEvent();
+    event.kind = kind;
+    event.frame = frame_;
+    return event;
 }
 
-int Tetris::detect_tspin() const
+template <typename Rules>
+bool BasicTetris<Rules>::PollEvent(GameEvent &event)
 {
-    if (tetromino_.kind != T)
+    if (events_.IsEmpty())
+        return false;
+
+    event = events_.Front();
+    events_.PopFront();
+    return true;
+}
+
+template <typename Rules>
+int BasicTetris<Rules>::detect_tspin() const
+{
+    if (!Rules::HAS_TSPIN || tetromino_.kind != T)
         return TSPIN_NONE;
 
     if (!(last_move_ & (ROT_LEFT | ROT_RIGHT)))
@@ -347,68 +585,111 @@ int Tetris::detect_tspin() const
     if (GetClearedLineCount() == 4)
         return TSPIN_NONE;
 
-    // Detection
-    const Piece tcorners = GetTcorners(tetromino_.rotation);
-    int front_occluded = 0;
-    int back_occluded = 0;
+    return DetectTspin(field_, tetromino_, last_kick_);
+}
 
-    for (int i = 0; i < 4; i++) {
-        const Point world = tetromino_.pos + tcorners.tiles[i];
-        const int kind = GetFieldTileKind(world);
+template <typename Rules>
+int BasicTetris<Rules>::cancel_garbage(int attack)
+{
+    while (attack > 0 && !garbage_.IsEmpty()) {
+        Garbage &garbage = garbage_.Front();
+        const int count = std::min(attack, garbage.line_count);
 
-        if (!IsEmptyTile(kind)) {
-            if (i == 0 || i == 1)
-                front_occluded++;
-            if (i == 2 || i == 3)
-                back_occluded++;
-        }
+        garbage.line_count -= count;
+        attack -= count;
+
+        if (garbage.line_count == 0)
+            garbage_.PopFront();
     }
 
-    // Kind
-    int tspin_kind = TSPIN_NONE;
+    return attack;
+}
 
-    if (front_occluded == 2 && back_occluded == 1)
-        tspin_kind = TSPIN_NORMAL;
-    else if (front_occluded == 1 && back_occluded == 2)
-        tspin_kind = TSPIN_MINI;
-    else
-        tspin_kind = TSPIN_NONE;
+template <typename Rules>
+bool BasicTetris<Rules>::insert_garbage()
+{
+    while (!garbage_.IsEmpty()) {
+        const Garbage garbage = garbage_.Front();
+        garbage_.PopFront();
+
+        for (int i = 0; i < garbage.line_count; i++) {
+            if (!field_.InsertGarbageLine(garbage.hole_x))
+                return false;
+        }
+    }
 
-    if (tspin_kind == TSPIN_MINI && abs(last_kick_.x) == 1 && abs(last_kick_.y) == 2)
-        tspin_kind = TSPIN_NORMAL;
+    return true;
+}
 
-    return tspin_kind;
+template <typename Rules>
+const Field &BasicTetris<Rules>::GetField() const
+{
+    return field_;
 }
 
-int Tetris::GetFieldTileKind(Point pos) const
+template <typename Rules>
+int BasicTetris<Rules>::GetFieldTileKind(Point pos) const
 {
     return field_.GetTileKind(pos);
 }
 
-int Tetris::GetClearedLineCount() const
+template <typename Rules>
+int BasicTetris<Rules>::GetClearedLineCount() const
 {
     return field_.GetClearedLineCount();
 }
 
-void Tetris::GetClearedLines(int *cleared_line_y) const
+template <typename Rules>
+void BasicTetris<Rules>::GetClearedLines(int *cleared_line_y) const
 {
     field_.GetClearedLines(cleared_line_y);
 }
 
-bool Tetris::IsPerfectClear() const
+template <typename Rules>
+bool BasicTetris<Rules>::IsPerfectClear() const
 {
     return field_.IsEmpty();
 }
 
-int Tetris::GetPieceKindList(int index) const
+template <typename Rules>
+int BasicTetris<Rules>::GetPieceKindList(int index) const
 {
-    if (index < 0 || index >= bag_.size())
+    if (index < 0 || index >= (int) bag_.Size())
         return E;
 
     return bag_[index];
 }
 
-Piece Tetris::GetCurrentPiece() const
+template <typename Rules>
+void BasicTetris<Rules>::ShuffleHiddenPieces(unsigned int seed)
+{
+    rng_.seed(seed);
+
+    // What is left of the current bag, then the whole next one
+    const int size = bag_.Size();
+    if (size < 7)
+        return;
+
+    auto shuffle = [this](int begin, int end) {
+        std::array<int, 7> kinds;
+        int count = 0;
+
+        begin = std::max(begin, preview_count_);
+        for (int i = begin; i < end; i++)
+            kinds[count++] = bag_[i];
+
+        ShufflePieces(kinds.data(), count, rng_);
+
+        for (int i = begin; i < end; i++)
+            bag_[i] = kinds[i - begin];
+    };
+
+    shuffle(0, size - 7);
+    shuffle(size - 7, size);
+}
+
+template <typename Rules>
+Piece BasicTetris<Rules>::GetCurrentPiece() const
 {
     Piece piece = GetPiece(tetromino_.kind, tetromino_.rotation);
 
@@ -418,7 +699,8 @@ Piece Tetris::GetCurrentPiece() const
     return piece;
 }
 
-Piece Tetris::GetGhostPiece() const
+template <typename Rules>
+Piece BasicTetris<Rules>::GetGhostPiece() const
 {
     Piece piece = GetPiece(ghost_.kind, ghost_.rotation);
 
@@ -428,7 +710,8 @@ Piece Tetris::GetGhostPiece() const
     return piece;
 }
 
-Piece Tetris::GetHoldPiece() const
+template <typename Rules>
+Piece BasicTetris<Rules>::GetHoldPiece() const
 {
     Piece piece = GetPiece(hold_.kind, hold_.rotation);
 
@@ -438,12 +721,13 @@ Piece Tetris::GetHoldPiece() const
     return piece;
 }
 
-Piece Tetris::GetNextPiece(int index) const
+template <typename Rules>
+Piece BasicTetris<Rules>::GetNextPiece(int index) const
 {
     const int rotation = 0;
     int kind;
 
-    if (index < 0 || index >= bag_.size())
+    if (index < 0 || index >= (int) bag_.Size())
         kind = E;
     else if (index >= preview_count_)
         kind = E;
@@ -453,67 +737,111 @@ Piece Tetris::GetNextPiece(int index) const
     return GetPiece(kind, rotation);
 }
 
-int Tetris::GetNextPieceCount() const
+template <typename Rules>
+int BasicTetris<Rules>::GetNextPieceCount() const
 {
     return preview_count_;
 }
 
-bool Tetris::IsHoldAvailable() const
+template <typename Rules>
+bool BasicTetris<Rules>::IsHoldAvailable() const
 {
     return is_hold_available_;
 }
 
-int Tetris::GetLevel() const
+template <typename Rules>
+int BasicTetris<Rules>::GetLevel() const
 {
     return scorer_.GetLevel();
 }
 
-int Tetris::GetScore() const
+template <typename Rules>
+int BasicTetris<Rules>::GetScore() const
 {
     return scorer_.GetScore();
 }
 
-int Tetris::GetTotalLineCount() const
+template <typename Rules>
+int BasicTetris<Rules>::GetTotalLineCount() const
 {
     return scorer_.GetLines();
 }
 
-int Tetris::GetComboCounter() const
+template <typename Rules>
+int BasicTetris<Rules>::GetComboCounter() const
 {
     return scorer_.GetComboCounter();
 }
 
-int Tetris::GetComboPoints() const
+template <typename Rules>
+int BasicTetris<Rules>::GetComboPoints() const
 {
     return scorer_.GetComboPoints();
 }
 
-int Tetris::GetTspinKind() const
+template <typename Rules>
+int BasicTetris<Rules>::GetTspinKind() const
 {
     return tspin_kind_;
 }
 
-int Tetris::GetClearPoints() const
+template <typename Rules>
+int BasicTetris<Rules>::GetClearPoints() const
 {
     return scorer_.GetClearPoints();
 }
 
-int Tetris::GetBackToBackCounter() const
+template <typename Rules>
+int BasicTetris<Rules>::GetBackToBackCounter() const
 {
     return scorer_.GetBackToBackCounter();
 }
 
-void Tetris::SetDebugMode()
+template <typename Rules>
+void BasicTetris<Rules>::ReceiveGarbage(int line_count, int hole_x)
+{
+    if (line_count <= 0)
+        return;
+
+    Garbage &garbage = garbage_.PushBack();
+    garbage.line_count = line_count;
+    garbage.hole_x = hole_x;
+}
+
+template <typename Rules>
+int BasicTetris<Rules>::GetPendingGarbage() const
+{
+    int count = 0;
+
+    for (size_t i = 0; i < garbage_.Size(); i++)
+        count += garbage_[i].line_count;
+
+    return count;
+}
+
+template <typename Rules>
+int BasicTetris<Rules>::PopAttack()
+{
+    const int attack = attack_;
+    attack_ = 0;
+
+    return attack;
+}
+
+template <typename Rules>
+void BasicTetris<Rules>::SetDebugMode()
 {
     debug_mode_ = true;
 }
 
-bool Tetris::IsDebugMode() const
+template <typename Rules>
+bool BasicTetris<Rules>::IsDebugMode() const
 {
     return debug_mode_;
 }
 
-void Tetris::SetTetrominoKind(int kind)
+template <typename Rules>
+void BasicTetris<Rules>::SetTetrominoKind(int kind)
 {
     if (!IsSolidTile(kind))
         return;
@@ -525,12 +853,14 @@ void Tetris::SetTetrominoKind(int kind)
         tetromino_.kind = kind;
 }
 
-int Tetris::GetTetrominoKind() const
+template <typename Rules>
+int BasicTetris<Rules>::GetTetrominoKind() const
 {
     return tetromino_.kind;
 }
 
-void Tetris::SetTetrominoRotation(int rotation)
+template <typename Rules>
+void BasicTetris<Rules>::SetTetrominoRotation(int rotation)
 {
     Tetromino test = tetromino_;
     test.rotation = rotation;
@@ -539,12 +869,14 @@ void Tetris::SetTetrominoRotation(int rotation)
         tetromino_.rotation = rotation;
 }
 
-int Tetris::GetTetrominoRotation() const
+template <typename Rules>
+int BasicTetris<Rules>::GetTetrominoRotation() const
 {
     return tetromino_.rotation;
 }
 
-void Tetris::SetTetrominoPos(Point pos)
+template <typename Rules>
+void BasicTetris<Rules>::SetTetrominoPos(Point pos)
 {
     Tetromino test = tetromino_;
     test.pos = pos;
@@ -553,97 +885,142 @@ void Tetris::SetTetrominoPos(Point pos)
         tetromino_.pos = pos;
 }
 
-Point Tetris::GetTetrominoPos() const
+template <typename Rules>
+Point BasicTetris<Rules>::GetTetrominoPos() const
 {
     return tetromino_.pos;
 }
 
-void Tetris::SetFieldTileKind(Point pos, int kind)
+template <typename Rules>
+void BasicTetris<Rules>::SetFieldTileKind(Point pos, int kind)
 {
     return field_.SetTileKind(pos, kind);
 }
 
-int Tetris::GetLockDelayTimer() const
+template <typename Rules>
+int BasicTetris<Rules>::GetLockDelayTimer() const
 {
     return lock_delay_timer_;
 }
 
-int Tetris::GetResetCounter() const
+template <typename Rules>
+int BasicTetris<Rules>::GetResetCounter() const
 {
     return reset_counter_;
 }
 
-float Tetris::GetGravity() const
+template <typename Rules>
+int BasicTetris<Rules>::GetTickRate() const
+{
+    return tick_rate_;
+}
+
+template <typename Rules>
+int BasicTetris<Rules>::GetGravity() const
 {
     return gravity_;
 }
 
-void Tetris::SetGravity(float gravity)
+template <typename Rules>
+void BasicTetris<Rules>::SetGravity(int gravity)
 {
     gravity_ = gravity;
 }
 
-void Tetris::SetGravityDrop(float gravity_drop)
+template <typename Rules>
+void BasicTetris<Rules>::SetGravityDrop(int gravity_drop)
 {
     gravity_drop_ = gravity_drop;
 }
-void Tetris::EnableLog(bool enable)
+template <typename Rules>
+void BasicTetris<Rules>::EnableLog(bool enable)
 {
-    ::EnableLog(enable);
+    is_log_enabled_ = enable;
 }
 
-void Tetris::QuitGame()
+template <typename Rules>
+void BasicTetris<Rules>::QuitGame()
 {
     is_playing_ = false;
 }
 
-void Tetris::PauseGame()
+template <typename Rules>
+void BasicTetris<Rules>::PauseGame()
 {
     is_paused_ = !is_paused_;
 }
 
-bool Tetris::IsPlaying() const
+template <typename Rules>
+bool BasicTetris<Rules>::IsPlaying() const
 {
     return is_playing_;
 }
 
-bool Tetris::IsGameOver() const
+template <typename Rules>
+bool BasicTetris<Rules>::IsGameOver() const
 {
     return is_game_over_;
 }
 
-bool Tetris::IsPaused() const
+template <typename Rules>
+bool BasicTetris<Rules>::IsPaused() const
 {
     return is_paused_;
 }
 
-void Tetris::SetPreviewCount(int count)
+template <typename Rules>
+void BasicTetris<Rules>::SetPreviewCount(int count)
 {
     preview_count_ = std::min(std::max(1, count), 6);
 }
 
-void Tetris::SetGhostEnable(bool enable)
+template <typename Rules>
+void BasicTetris<Rules>::SetRandomSeed(unsigned int seed)
+{
+    random_seed_ = seed;
+    has_random_seed_ = true;
+}
+
+template <typename Rules>
+void BasicTetris<Rules>::SetTickRate(int tick_rate)
+{
+    if (tick_rate <= 0)
+        return;
+
+    tick_rate_ = tick_rate;
+    gravity_ = GetLevelGravity(IsPlaying() ? GetLevel() : 1, tick_rate_);
+}
+
+template <typename Rules>
+void BasicTetris<Rules>::SetGhostEnable(bool enable)
 {
     is_ghost_enable_ = enable;
 }
 
-void Tetris::SetHoldEnable(bool enable)
+template <typename Rules>
+void BasicTetris<Rules>::SetHoldEnable(bool enable)
 {
     is_hold_enable_ = enable;
 }
 
-bool Tetris::IsGhostEnable() const
+template <typename Rules>
+bool BasicTetris<Rules>::IsGhostEnable() const
 {
     return is_ghost_enable_;
 }
 
-bool Tetris::IsHoldEnable() const
+template <typename Rules>
+bool BasicTetris<Rules>::IsHoldEnable() const
 {
     return is_hold_enable_;
 }
 
-void Tetris::add_log(int move)
+template <typename Rules>
+void BasicTetris<Rules>::add_log(int move)
 {
+    if (!is_log_enabled_)
+        return;
+
     AddLog("\n=========================================================");
     AddLog("frame: %ld, move: %d, kind: %d, rotation: %d, pos: (%d, %d)",
             frame_, move, tetromino_.kind, tetromino_.rotation,
@@ -652,7 +1029,7 @@ void Tetris::add_log(int move)
     AddLog("lock_delay_timer_: %d, reset_counter_: %d, need_spawn_: %d",
             lock_delay_timer_, reset_counter_, need_spawn_);
 
-    AddLog("gravity_drop_: %g, gravity_: %g, last_move_: %d, "
+    AddLog("gravity_drop_: %d, gravity_: %d, last_move_: %d, "
             "last_kick_: (%d, %d), tspin_kind_: %d",
             gravity_drop_, gravity_, last_move_,
             last_kick_.x, last_kick_.y, tspin_kind_);
@@ -678,3 +1055,7 @@ void Tetris::add_log(int move)
         AddLog(line);
     }
 }
+
+template class BasicTetris<SRS>;
+template class BasicTetris<ARS>;
+template class BasicTetris<NRS>;
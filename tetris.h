@@ -6,7 +6,9 @@
 #include "point.h"
 #include "piece.h"
 #include "field.h"
-#include <deque>
+#include "ring.h"
+#include "rotation.h"
+#include <random>
 
 enum TetrominoMove {
     MOV_RIGHT     = 1 << 0,
@@ -19,10 +21,56 @@ enum TetrominoMove {
     HOLD_PIECE    = 1 << 7,
 };
 
-class Tetris {
+enum GameEventKind {
+    EVENT_SPAWN,
+    EVENT_LOCK,
+    EVENT_CLEAR,
+    EVENT_TSPIN,
+    EVENT_HOLD,
+    EVENT_LEVEL_UP,
+    EVENT_GAME_OVER,
+};
+
+// Something that happened in a frame, so consumers can react to changes
+// instead of polling the getters every tick
+struct GameEvent {
+    int kind = EVENT_SPAWN;
+    unsigned long frame = 0;
+
+    int piece = E;              // Spawn, lock, hold: the piece kind
+    int level = 0;              // Level up: the new level
+
+    // Clear and T-spin
+    int line_count = 0;
+    int cleared_lines[4] = {0}; // Rows from the bottom
+    int tspin = TSPIN_NONE;
+    bool is_perfect_clear = false;
+    int clear_points = 0;
+    int combo_counter = -1;
+    int combo_points = 0;
+    int back_to_back = -1;
+};
+
+// Gravity and drops count in fixed-point subcells, so games replay
+// bit-exactly on any compiler or platform
+const int GRAVITY_UNIT = 1 << 16;
+
+// Subcells per tick a piece falls at each level, ticking at tick_rate Hz
+int GetLevelGravity(int level, int tick_rate = 60);
+
+// Fisher-Yates straight from rng. std::shuffle differs between standard
+// libraries, so the same seed would deal other bags on another build.
+void ShufflePieces(int *kinds, int count, std::minstd_rand &rng);
+
+// Where new pieces appear
+constexpr Point SPAWN_POS = {4, 19};
+
+// A single game played under the rotation system in Rules (rotation.h)
+template <typename Rules>
+class BasicTetris {
 public:
-    Tetris();
-    ~Tetris();
+    BasicTetris();
+    ~BasicTetris();
 
     // Game controls
     void PlayGame();
@@ -36,13 +84,25 @@ public:
     void SetPreviewCount(int count);
     void SetGhostEnable(bool enable);
     void SetHoldEnable(bool enable);
+    void SetRandomSeed(unsigned int seed);
+    void SetTickRate(int tick_rate);
     bool IsGhostEnable() const;
     bool IsHoldEnable() const;
 
     // Tick Game
     void UpdateFrame(int move);
 
+    // Hard drops the current piece from the top with the given rotation and
+    // column, and locks it. Returns false if it doesn't fit there.
+    bool PlacePiece(int rotation, int x);
+
+    // Hard drops the current piece from placement, a spot a search such as
+    // MoveGenerator found it can reach, and locks it, without going through
+    // frames or gravity. Returns false if it's another kind or doesn't fit.
+    bool PlacePiece(const Tetromino &placement);
+
     // Field
+    const Field &GetField() const;
     int GetFieldTileKind(Point pos) const;
     int GetClearedLineCount() const;
     void GetClearedLines(int *cleared_line_y) const;
@@ -57,6 +117,10 @@ public:
     int GetNextPieceCount() const;
     bool IsHoldAvailable() const;
 
+    // Reseeds the bags and reshuffles the pieces past the preview, each
+    // within its own bag, so copies of a game can play different futures
+    void ShuffleHiddenPieces(unsigned int seed);
+
     // Info
     int GetLevel() const;
     int GetScore() const;
@@ -67,6 +131,14 @@ public:
     int GetClearPoints() const;
     int GetBackToBackCounter() const;
 
+    // Events since the last poll, oldest first. Only the latest 32 are kept.
+    bool PollEvent(GameEvent &event);
+
+    // Versus
+    void ReceiveGarbage(int line_count, int hole_x);
+    int GetPendingGarbage() const;
+    int PopAttack();
+
     // Debug
     void SetDebugMode();
     bool IsDebugMode() const;
@@ -80,26 +152,38 @@ public:
     int GetLockDelayTimer() const;
     int GetResetCounter() const;
 
-    float GetGravity() const;
-    void SetGravity(float gravity);
-    void SetGravityDrop(float gravity_drop);
+    int GetTickRate() const;
+    int GetGravity() const;
+    void SetGravity(int gravity);
+    void SetGravityDrop(int gravity_drop);
 
+    // Whether this game records its frames in the crash log of log.h, on
+    // by default. Copies keep the setting.
     void EnableLog(bool enable);
 
 private:
+    struct Garbage {
+        int line_count = 0;
+        int hole_x = 0;
+    };
+
     Tetromino tetromino_;
     Tetromino ghost_;
     Tetromino hold_;
     Field field_;
 
     Scorer scorer_;
-    std::deque<int> bag_;
+    Ring<int, 14> bag_;
+    std::minstd_rand rng_;
+    unsigned int random_seed_ = 0;
+    bool has_random_seed_ = false;
 
     bool is_playing_ = false;
     bool is_game_over_ = false;
     bool is_paused_ = false;
     bool debug_mode_ = false;
-    int playing_fps_ = 60;
+    bool is_log_enabled_ = true;
+    int tick_rate_ = 60;
 
     int preview_count_ = 3;
     bool is_hold_available_ = false;
@@ -112,13 +196,22 @@ private:
     int reset_counter_ = -1;
     bool need_spawn_ = false;
 
-    float gravity_drop_ = 0;
-    float gravity_ = 1./60;
+    int gravity_drop_ = 0;
+    int gravity_ = GetLevelGravity(1);
     int last_move_ = 0;
     Point last_kick_ = {};
     int tspin_kind_ = 0;
 
+    Ring<GameEvent, 32> events_;
+
+    // Received garbage waits until a piece locks without clearing lines
+    Ring<Garbage, 16> garbage_;
+    bool is_garbage_due_ = false;
+    int attack_ = 0;
+
     bool hard_drop(Tetromino &tet);
+    int get_drop_distance(const Tetromino &tet) const;
+    bool is_instant_gravity() const;
     bool drop_piece(int move);
     bool shift_piece(int move);
     bool rotate_piece(int move);
@@ -133,10 +226,20 @@ private:
     void tick_lock_delay_timer();
     void reset_all_timers();
 
+    bool begin_piece();
+    void lock_piece();
+    void end_game();
+    GameEvent &push_event(int kind);
+
+    int cancel_garbage(int attack);
+    bool insert_garbage();
+
     bool spawn_tetromino();
     void generate_bag();
 
     void add_log(int move);
 };
 
+using Tetris = BasicTetris<SRS>;
+
 #endif
@@ -10,12 +10,47 @@ public:
     Tetromino(int kind, Point pos);
     ~Tetromino();
 
-    bool CanFit(const Field &field) const;
-    bool KickWall(const Field &field, int old_rotation);
+    template <int W, int H>
+    bool CanFit(const BasicField<W, H> &field) const;
+
+    // Tries each kick of the rotation system in Rules
+    template <typename Rules, int W, int H>
+    bool KickWall(const BasicField<W, H> &field, int old_rotation);
 
     int kind = E;
     int rotation = 0;
     Point pos = {0, 0};
 };
 
+template <int W, int H>
+bool Tetromino::CanFit(const BasicField<W, H> &field) const
+{
+    const Piece piece = GetPiece(kind, rotation);
+
+    for (auto tile: piece.tiles) {
+        const Point world = pos + tile;
+        const int kind = field.GetTileKind(world);
+
+        if (!IsEmptyTile(kind))
+            return false;
+    }
+
+    return true;
+}
+
+template <typename Rules, int W, int H>
+bool Tetromino::KickWall(const BasicField<W, H> &field, int old_rotation)
+{
+    for (int i = 0; i < Rules::KICK_COUNT; i++) {
+        Tetromino test = *this;
+        test.pos += Rules::GetKickOffset(kind, old_rotation, rotation, i);
+
+        if (test.CanFit(field)) {
+            pos = test.pos;
+            return true;
+        }
+    }
+    return false;
+}
+
 #endif
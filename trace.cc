@@ -0,0 +1,121 @@
+#include "trace.h"
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+static const size_t MAX_EVENT_COUNT = 1 << 16;
+
+struct TraceEvent {
+    const char *name;
+    int64_t start;
+    int64_t duration;
+};
+
+// One per thread. Written only by its owner, so recording takes no lock.
+struct TraceBuffer {
+    std::array<TraceEvent, MAX_EVENT_COUNT> events;
+    std::atomic<size_t> count {0};
+    const char *thread_name = nullptr;
+    int thread_id = 0;
+};
+
+static std::mutex buffers_mutex;
+static std::vector<TraceBuffer *> buffers;
+
+static const auto epoch = std::chrono::steady_clock::now();
+
+static int64_t now_nanosec()
+{
+    const auto dur = std::chrono::steady_clock::now() - epoch;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count();
+}
+
+static TraceBuffer &get_thread_buffer()
+{
+    // Buffers outlive their threads so they can still be exported
+    thread_local TraceBuffer *buffer = nullptr;
+
+    if (!buffer) {
+        buffer = new TraceBuffer;
+
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        buffer->thread_id = buffers.size() + 1;
+        buffers.push_back(buffer);
+    }
+
+    return *buffer;
+}
+
+TraceScope::TraceScope(const char *name)
+    : name_(name), start_(now_nanosec())
+{
+}
+
+TraceScope::~TraceScope()
+{
+    TraceBuffer &buffer = get_thread_buffer();
+    const size_t count = buffer.count.load(std::memory_order_relaxed);
+
+    buffer.events[count % MAX_EVENT_COUNT] = {name_, start_, now_nanosec() - start_};
+    buffer.count.store(count + 1, std::memory_order_release);
+}
+
+bool IsTraceEnabled()
+{
+#ifdef TETRIS_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SetTraceThreadName(const char *name)
+{
+    get_thread_buffer().thread_name = name;
+}
+
+bool ExportTrace(const char *filename)
+{
+    FILE *fp = fopen(filename, "w");
+
+    if (!fp) {
+        fprintf(stderr, "can't open file: %s\n", filename);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    const char *sep = "";
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+
+    for (const TraceBuffer *buffer: buffers) {
+        if (buffer->thread_name) {
+            fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                    "\"args\":{\"name\":\"%s\"}}",
+                    sep, buffer->thread_id, buffer->thread_name);
+            sep = ",\n";
+        }
+
+        const size_t count = buffer->count.load(std::memory_order_acquire);
+        const size_t first = count > MAX_EVENT_COUNT ? count - MAX_EVENT_COUNT : 0;
+
+        for (size_t i = first; i < count; i++) {
+            const TraceEvent &event = buffer->events[i % MAX_EVENT_COUNT];
+
+            fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f}",
+                    sep, event.name, buffer->thread_id,
+                    event.start / 1000., event.duration / 1000.);
+            sep = ",\n";
+        }
+    }
+
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+
+// Scoped timings exported as Chrome trace JSON (chrome://tracing, Perfetto).
+// Build with `make TRACE=1` to enable. Otherwise the macros compile to nothing.
+#ifdef TETRIS_TRACE
+#define TET_TRACE_CONCAT_(a, b) a##b
+#define TET_TRACE_CONCAT(a, b) TET_TRACE_CONCAT_(a, b)
+#define TET_TRACE_SCOPE(name) TraceScope TET_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TET_TRACE_THREAD(name) SetTraceThreadName(name)
+#else
+#define TET_TRACE_SCOPE(name) do {} while (0)
+#define TET_TRACE_THREAD(name) do {} while (0)
+#endif
+
+class TraceScope {
+public:
+    TraceScope(const char *name);
+    ~TraceScope();
+
+private:
+    const char *name_;
+    int64_t start_;
+};
+
+bool IsTraceEnabled();
+void SetTraceThreadName(const char *name);
+
+// Writes every thread's recent events. Events recorded while exporting may
+// be torn at the oldest end of a buffer that is wrapping around.
+bool ExportTrace(const char *filename);
+
+#endif
@@ -0,0 +1,143 @@
+#include "transposition.h"
+
+#include <cassert>
+
+// Data layout: value in the low 48 bits, then depth + 1, then generation.
+// Stored data is never 0, which marks an empty entry.
+static const uint64_t VALUE_MASK = (uint64_t(1) << 48) - 1;
+
+static uint64_t pack(uint64_t value, int depth, uint8_t generation)
+{
+    return (value & VALUE_MASK) | uint64_t(depth + 1) << 48 | uint64_t(generation) << 56;
+}
+
+static int get_depth(uint64_t data) { return int((data >> 48) & 0xff) - 1; }
+static uint8_t get_generation(uint64_t data) { return data >> 56; }
+
+static uint64_t mix(uint64_t hash)
+{
+    // splitmix64 finalizer
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+    return hash ^ (hash >> 31);
+}
+
+uint64_t HashQueue(const int *kinds, int count, int hold_kind)
+{
+    uint64_t hash = mix(uint64_t(hold_kind) + 1);
+
+    for (int i = 0; i < count; i++)
+        hash = mix(hash ^ (uint64_t(kinds[i]) + 8 * (i + 1)));
+
+    return mix(hash ^ uint64_t(count) << 32);
+}
+
+TranspositionTable::TranspositionTable(int size_log2, int policy)
+    : entries_(new Entry[size_t(1) << size_log2]),
+      mask_((uint64_t(1) << size_log2) - 1),
+      policy_(policy)
+{
+    assert(size_log2 > 0 && size_log2 < 40);
+    assert(policy == REPLACE_ALWAYS || policy == REPLACE_DEEPER);
+}
+
+TranspositionTable::~TranspositionTable()
+{
+}
+
+void TranspositionTable::Clear()
+{
+    for (uint64_t i = 0; i <= mask_; i++) {
+        entries_[i].check.store(0, std::memory_order_relaxed);
+        entries_[i].data.store(0, std::memory_order_relaxed);
+    }
+
+    generation_ = 0;
+    probe_count_ = 0;
+    hit_count_ = 0;
+    collision_count_ = 0;
+    store_count_ = 0;
+    reject_count_ = 0;
+}
+
+void TranspositionTable::NewGeneration()
+{
+    generation_++;
+}
+
+bool TranspositionTable::Probe(uint64_t key, int min_depth, uint64_t &value)
+{
+    const Entry &entry = entries_[key & mask_];
+    const uint64_t data = entry.data.load(std::memory_order_relaxed);
+    const uint64_t check = entry.check.load(std::memory_order_relaxed);
+
+    probe_count_.fetch_add(1, std::memory_order_relaxed);
+
+    if (data == 0 || (check ^ data) != key) {
+        if (data != 0)
+            collision_count_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (get_depth(data) < min_depth)
+        return false;
+
+    hit_count_.fetch_add(1, std::memory_order_relaxed);
+    value = data & VALUE_MASK;
+    return true;
+}
+
+void TranspositionTable::Store(uint64_t key, int depth, uint64_t value)
+{
+    assert(depth >= 0 && depth < 255);
+    assert(value <= VALUE_MASK);
+
+    Entry &entry = entries_[key & mask_];
+    const uint64_t old_data = entry.data.load(std::memory_order_relaxed);
+    const uint64_t old_check = entry.check.load(std::memory_order_relaxed);
+    const bool is_same_key = (old_check ^ old_data) == key;
+
+    if (policy_ == REPLACE_DEEPER && old_data != 0 && !is_same_key &&
+            get_generation(old_data) == generation_ && get_depth(old_data) > depth) {
+        reject_count_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const uint64_t data = pack(value, depth, generation_);
+    entry.check.store(key ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+    store_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t TranspositionTable::GetProbeCount() const
+{
+    return probe_count_.load(std::memory_order_relaxed);
+}
+
+uint64_t TranspositionTable::GetHitCount() const
+{
+    return hit_count_.load(std::memory_order_relaxed);
+}
+
+uint64_t TranspositionTable::GetCollisionCount() const
+{
+    return collision_count_.load(std::memory_order_relaxed);
+}
+
+double TranspositionTable::GetHitRate() const
+{
+    const uint64_t probes = GetProbeCount();
+    return probes > 0 ? (double) GetHitCount() / probes : 0.;
+}
+
+void TranspositionTable::PrintStats(FILE *fp) const
+{
+    fprintf(fp, "tt: entries: %llu, probes: %llu, hits: %llu (%.1f%%), "
+            "collisions: %llu, stores: %llu, rejected: %llu\n",
+            (unsigned long long) mask_ + 1,
+            (unsigned long long) GetProbeCount(),
+            (unsigned long long) GetHitCount(), 100 * GetHitRate(),
+            (unsigned long long) GetCollisionCount(),
+            (unsigned long long) store_count_.load(std::memory_order_relaxed),
+            (unsigned long long) reject_count_.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,60 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+enum ReplacementPolicy {
+    REPLACE_ALWAYS,     // The newest entry wins
+    REPLACE_DEEPER,     // Keeps the deeper entry unless it is from an old generation
+};
+
+// Hash of the pieces still to place, and the held one if any
+uint64_t HashQueue(const int *kinds, int count, int hold_kind);
+
+// Fixed-size cache of search results keyed by a board and queue hash.
+// Any number of threads may probe and store without locks: each entry keeps
+// its key XORed with its data, so a torn write reads back as a miss.
+// Values are 48 bits.
+class TranspositionTable {
+public:
+    explicit TranspositionTable(int size_log2, int policy = REPLACE_DEEPER);
+    ~TranspositionTable();
+
+    void Clear();
+
+    // Entries from older generations are replaced first
+    void NewGeneration();
+
+    // Finds the value stored for key at depth min_depth or deeper
+    bool Probe(uint64_t key, int min_depth, uint64_t &value);
+    void Store(uint64_t key, int depth, uint64_t value);
+
+    // Stats
+    uint64_t GetProbeCount() const;
+    uint64_t GetHitCount() const;
+    uint64_t GetCollisionCount() const;
+    double GetHitRate() const;
+    void PrintStats(FILE *fp) const;
+
+private:
+    struct Entry {
+        std::atomic<uint64_t> check {0};
+        std::atomic<uint64_t> data {0};
+    };
+
+    std::unique_ptr<Entry[]> entries_;
+    uint64_t mask_ = 0;
+    int policy_ = REPLACE_DEEPER;
+    uint8_t generation_ = 0;
+
+    std::atomic<uint64_t> probe_count_ {0};
+    std::atomic<uint64_t> hit_count_ {0};
+    std::atomic<uint64_t> collision_count_ {0};
+    std::atomic<uint64_t> store_count_ {0};
+    std::atomic<uint64_t> reject_count_ {0};
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <array>
+
+// Single writer, single reader. The writer fills the back buffer and
+// publishes it; the reader picks up the most recently published buffer.
+// Neither side ever waits for the other.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() {}
+    ~TripleBuffer() {}
+
+    // Writer
+    T &GetBack()
+    {
+        return buffers_[back_];
+    }
+
+    void Publish()
+    {
+        const int old = middle_.exchange(back_ | DIRTY, std::memory_order_acq_rel);
+        back_ = old & INDEX;
+    }
+
+    // Reader
+    bool Fetch()
+    {
+        if (!(middle_.load(std::memory_order_acquire) & DIRTY))
+            return false;
+
+        const int old = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = old & INDEX;
+        return true;
+    }
+
+    const T &GetFront() const
+    {
+        return buffers_[front_];
+    }
+
+private:
+    enum { INDEX = 0x3, DIRTY = 0x4 };
+
+    std::array<T, 3> buffers_;
+    int back_ = 0;
+    int front_ = 1;
+    std::atomic<int> middle_ {2};
+};
+
+#endif
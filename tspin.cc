@@ -0,0 +1,218 @@
+#include "tspin.h"
+#include "tetris.h"
+#include "scorer.h"
+#include "rotation.h"
+#include "piece.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+static const int UNVISITED = -2;
+
+// Row y with a filled column on each side, at bits 0 and W + 1. Outside the
+// field is filled.
+static uint64_t get_walled_row(const Field &field, int y)
+{
+    const uint64_t walls = 1 | uint64_t(1) << (Field::WIDTH + 1);
+
+    if (y < 0 || y >= Field::HEIGHT)
+        return (uint64_t(1) << (Field::WIDTH + 2)) - 1;
+
+    return walls | uint64_t(field.GetRowMask(y)) << 1;
+}
+
+uint32_t GetTspinCornerMask(const Field &field, int y)
+{
+    const uint64_t below = get_walled_row(field, y - 1);
+    const uint64_t row = get_walled_row(field, y);
+    const uint64_t above = get_walled_row(field, y + 1);
+
+    // Cells around the center at bit x + 1, shifted down to bit x
+    const uint64_t c0 = below, c1 = below >> 2;
+    const uint64_t c2 = above, c3 = above >> 2;
+    const uint64_t three = (c0 & c1 & (c2 | c3)) | (c2 & c3 & (c0 | c1));
+
+    // Every rotation of T has both arms across or both arms up and down
+    const uint64_t center = ~row >> 1;
+    const uint64_t across = ~row & ~row >> 2;
+    const uint64_t upright = ~above >> 1 & ~below >> 1;
+
+    return three & center & (across | upright) & ((uint64_t(1) << Field::WIDTH) - 1);
+}
+
+int DetectTspin(const Field &field, const Tetromino &tet, Point kick)
+{
+    const Piece tcorners = GetTcorners(tet.rotation);
+    int front_occluded = 0;
+    int back_occluded = 0;
+
+    for (int i = 0; i < 4; i++) {
+        const Point world = tet.pos + tcorners.tiles[i];
+
+        if (!IsEmptyTile(field.GetTileKind(world))) {
+            if (i == 0 || i == 1)
+                front_occluded++;
+            if (i == 2 || i == 3)
+                back_occluded++;
+        }
+    }
+
+    int tspin_kind = TSPIN_NONE;
+
+    if (front_occluded == 2 && back_occluded == 1)
+        tspin_kind = TSPIN_NORMAL;
+    else if (front_occluded == 1 && back_occluded == 2)
+        tspin_kind = TSPIN_MINI;
+
+    if (tspin_kind == TSPIN_MINI && abs(kick.x) == 1 && abs(kick.y) == 2)
+        tspin_kind = TSPIN_NORMAL;
+
+    return tspin_kind;
+}
+
+bool HasTspinCorners(const Field &field)
+{
+    for (int y = 0; y < Field::HEIGHT; y++) {
+        if (GetTspinCornerMask(field, y))
+            return true;
+    }
+
+    return false;
+}
+
+TspinFinder::TspinFinder()
+    : parents_(STATE_COUNT), moves_(STATE_COUNT), slot_indices_(STATE_COUNT)
+{
+    queue_.reserve(STATE_COUNT);
+}
+
+TspinFinder::~TspinFinder()
+{
+}
+
+int TspinFinder::get_state_index(const Tetromino &tet)
+{
+    return (tet.rotation * Y_COUNT + tet.pos.y + 2) * X_COUNT + tet.pos.x + 2;
+}
+
+void TspinFinder::add_slot(const Field &field, const Tetromino &from, int move,
+        const Tetromino &to, std::vector<TspinSlot> &slots)
+{
+    // A T that can still fall would not lock here after the rotation
+    Tetromino below = to;
+    below.pos.y--;
+    if (below.CanFit(field))
+        return;
+
+    const Point kick = to.pos - from.pos;
+    const int tspin = DetectTspin(field, to, kick);
+    if (tspin == TSPIN_NONE)
+        return;
+
+    // The first path found is kept, unless a later one scores better
+    int &index = slot_indices_[get_state_index(to)];
+    if (index >= 0 && (slots[index].tspin == TSPIN_NORMAL || tspin == TSPIN_MINI))
+        return;
+
+    if (index < 0) {
+        index = slots.size();
+        slots.emplace_back();
+    }
+
+    TspinSlot &slot = slots[index];
+    slot.placement = to;
+    slot.tspin = tspin;
+    slot.kick = kick;
+
+    slot.path.clear();
+    slot.path.push_back(move);
+    for (int state = get_state_index(from); parents_[state] >= 0; state = parents_[state])
+        slot.path.push_back(moves_[state]);
+    std::reverse(slot.path.begin(), slot.path.end());
+
+    Field next = field;
+    Piece piece = GetPiece(to.kind, to.rotation);
+    for (auto &tile: piece.tiles)
+        tile += to.pos;
+    next.SetPiece(piece);
+    slot.line_count = next.GetClearedLineCount();
+}
+
+void TspinFinder::Find(const Field &field, std::vector<TspinSlot> &slots)
+{
+    TET_TRACE_SCOPE("TspinFinder::Find");
+
+    slots.clear();
+
+    Tetromino start(T, SPAWN_POS);
+    start.rotation = SRS::SPAWN_ROTATIONS[T];
+    if (!start.CanFit(field))
+        return;
+
+    // Paths end at the start, whose parent is -1
+    std::fill(parents_.begin(), parents_.end(), UNVISITED);
+    std::fill(slot_indices_.begin(), slot_indices_.end(), -1);
+    parents_[get_state_index(start)] = -1;
+
+    queue_.clear();
+    queue_.push_back(start);
+
+    // Breadth first over (rotation, x, y) like MoveGenerator::Generate
+    for (size_t head = 0; head < queue_.size(); head++) {
+        const Tetromino current = queue_[head];
+
+        auto visit = [this, &current](const Tetromino &tet, int move) {
+            const int index = get_state_index(tet);
+            if (parents_[index] == UNVISITED) {
+                parents_[index] = get_state_index(current);
+                moves_[index] = move;
+                queue_.push_back(tet);
+            }
+        };
+
+        Tetromino moved = current;
+        moved.pos.y--;
+        if (moved.CanFit(field))
+            visit(moved, MOV_DOWN);
+
+        for (int move: {MOV_LEFT, MOV_RIGHT}) {
+            moved = current;
+            moved.pos.x += move == MOV_LEFT ? -1 : 1;
+            if (moved.CanFit(field))
+                visit(moved, move);
+        }
+
+        // Every rotation is checked as a slot, even into a state reached
+        // before by another move
+        for (int move: {ROT_RIGHT, ROT_LEFT}) {
+            moved = current;
+            moved.rotation = (current.rotation + (move == ROT_RIGHT ? 1 : 3)) % 4;
+            if (moved.KickWall<SRS>(field, current.rotation)) {
+                add_slot(field, current, move, moved, slots);
+                visit(moved, move);
+            }
+        }
+    }
+}
+
+int TspinFinder::FindBatch(const Field *fields, int count,
+        std::vector<std::vector<TspinSlot>> &slots)
+{
+    TET_TRACE_SCOPE("TspinFinder::FindBatch");
+
+    int search_count = 0;
+    slots.resize(count);
+
+    for (int i = 0; i < count; i++) {
+        if (!HasTspinCorners(fields[i])) {
+            slots[i].clear();
+            continue;
+        }
+
+        Find(fields[i], slots[i]);
+        search_count++;
+    }
+
+    return search_count;
+}
@@ -0,0 +1,70 @@
+#ifndef TSPIN_H
+#define TSPIN_H
+
+#include "tetromino.h"
+#include "field.h"
+#include "point.h"
+#include <cstdint>
+#include <vector>
+
+// A spot where a T from spawn can lock as a T-spin
+struct TspinSlot {
+    Tetromino placement;
+
+    // TSPIN_NORMAL or TSPIN_MINI, as Tetris::detect_tspin would score it
+    int tspin = 0;
+    int line_count = 0;
+
+    // Moves from spawn, like MOV_LEFT or ROT_RIGHT, ending with the
+    // rotation into the slot, and the kick that rotation takes
+    std::vector<int> path;
+    Point kick = {0, 0};
+};
+
+// The corner rules for a T locked at tet by a rotation that took kick:
+// TSPIN_NORMAL with both front corners and a back one filled, TSPIN_MINI
+// with a front one and both back ones, made normal by a 1 by 2 kick.
+// Tetris and TspinFinder both score with it.
+int DetectTspin(const Field &field, const Tetromino &tet, Point kick);
+
+// Bit x set where a T centered at (x, y) would have an empty center, room
+// for the arms of some rotation and three or more filled corners, which
+// every T-spin needs
+uint32_t GetTspinCornerMask(const Field &field, int y);
+
+// Whether any row has such a cell, so a board without one can be skipped
+bool HasTspinCorners(const Field &field);
+
+// Searches the moves of a T under SRS for every lock that counts as a
+// T-spin. Buffers are kept between calls, like MoveGenerator.
+class TspinFinder {
+public:
+    TspinFinder();
+    ~TspinFinder();
+
+    // Slots on field, in the order a breadth first search reaches them
+    void Find(const Field &field, std::vector<TspinSlot> &slots);
+
+    // Finds the slots of each board into slots[i]. Boards are screened with
+    // HasTspinCorners first, and the count of boards searched is returned.
+    int FindBatch(const Field *fields, int count, std::vector<std::vector<TspinSlot>> &slots);
+
+private:
+    static constexpr int X_COUNT = Field::WIDTH + 4;
+    static constexpr int Y_COUNT = Field::HEIGHT + 4;
+    static constexpr int STATE_COUNT = 4 * X_COUNT * Y_COUNT;
+
+    // The state each one was first reached from and the move it took
+    std::vector<int> parents_;
+    std::vector<uint8_t> moves_;
+    std::vector<Tetromino> queue_;
+
+    // Index into slots for each state found to be a slot, or -1
+    std::vector<int> slot_indices_;
+
+    static int get_state_index(const Tetromino &tet);
+    void add_slot(const Field &field, const Tetromino &from, int move,
+            const Tetromino &to, std::vector<TspinSlot> &slots);
+};
+
+#endif
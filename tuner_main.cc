@@ -0,0 +1,351 @@
+#include "bot.h"
+#include "tetris.h"
+#include "log.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const int WEIGHT_COUNT = 4;
+
+// Garbage arrives every this many pieces
+static const int GARBAGE_INTERVAL = 10;
+
+struct Options {
+    int population = 32;
+    int generation_count = 20;
+    int game_count = 64;
+    int piece_limit = 500;
+    int garbage_count = 0;
+    int depth = 1;
+    int thread_count = 1;
+    unsigned int seed = 1;
+    const char *checkpoint = nullptr;
+};
+
+struct Candidate {
+    double weights[WEIGHT_COUNT] = {0};
+    double fitness = 0;
+};
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: tetris-tune [-n population] [-i generations] [-m games] [-l pieces]\n"
+            "                   [-g lines] [-d depth] [-j threads] [-s seed] [-c file]\n"
+            "  -n population   candidates per generation (default: 32)\n"
+            "  -i generations  generations to run (default: 20)\n"
+            "  -m games        games per candidate and generation (default: 64)\n"
+            "  -l pieces       pieces a game lasts at most (default: 500)\n"
+            "  -g lines        garbage lines received every 10 pieces (default: 0)\n"
+            "  -d depth        pieces the bot searches (default: 1)\n"
+            "  -j threads      threads playing games (default: all cores)\n"
+            "  -s seed         random seed for bags, garbage and the search (default: 1)\n"
+            "  -c file         checkpoint saved after every generation, and resumed from\n");
+}
+
+static BotWeights to_bot_weights(const double *weights)
+{
+    BotWeights bot_weights;
+    bot_weights.height = weights[0];
+    bot_weights.lines = weights[1];
+    bot_weights.holes = weights[2];
+    bot_weights.bumpiness = weights[3];
+    return bot_weights;
+}
+
+// Only the direction of the weights changes which move a bot picks
+static void normalize(double *weights)
+{
+    double length = 0;
+    for (int i = 0; i < WEIGHT_COUNT; i++)
+        length += weights[i] * weights[i];
+
+    length = std::sqrt(length);
+    if (length == 0)
+        return;
+
+    for (int i = 0; i < WEIGHT_COUNT; i++)
+        weights[i] /= length;
+}
+
+static unsigned int mix_seed(unsigned int seed, unsigned int a, unsigned int b)
+{
+    uint32_t x = seed ^ (0x9e3779b9u * (a + 1)) ^ (0x85ebca6bu * (b + 1));
+    x = (x ^ (x >> 16)) * 0x7feb352du;
+    x = (x ^ (x >> 15)) * 0x846ca68bu;
+    return x ^ (x >> 16);
+}
+
+// Lines a bot clears in one seeded game
+static int play_game(const Options &options, const BotWeights &weights, unsigned int seed)
+{
+    Tetris tetris;
+    tetris.SetRandomSeed(seed);
+    tetris.PlayGame();
+
+    Bot bot;
+    bot.SetWeights(weights);
+
+    std::minstd_rand rng(seed);
+    std::uniform_int_distribution<int> hole_x(0, FIELD_WIDTH - 1);
+
+    for (int piece = 0; piece < options.piece_limit; piece++) {
+        if (options.garbage_count > 0 && piece % GARBAGE_INTERVAL == GARBAGE_INTERVAL - 1)
+            tetris.ReceiveGarbage(options.garbage_count, hole_x(rng));
+
+        if (!PlayBotMove(bot, tetris, options.depth))
+            break;
+    }
+
+    return tetris.GetTotalLineCount();
+}
+
+// Every candidate plays the same games, so they differ by their weights
+// and not by their luck
+static void evaluate(const Options &options, int generation, std::vector<Candidate> &population)
+{
+    const int task_count = population.size() * options.game_count;
+    std::vector<int> lines(task_count);
+    std::atomic<int> next_task {0};
+
+    auto work = [&]() {
+        for (;;) {
+            const int index = next_task.fetch_add(1);
+            if (index >= task_count)
+                break;
+
+            const Candidate &candidate = population[index / options.game_count];
+            const unsigned int seed =
+                mix_seed(options.seed, generation, index % options.game_count);
+            lines[index] = play_game(options, to_bot_weights(candidate.weights), seed);
+        }
+    };
+
+    GetWorkerPool().Run(options.thread_count, work);
+
+    for (size_t i = 0; i < population.size(); i++) {
+        double sum = 0;
+        for (int j = 0; j < options.game_count; j++)
+            sum += lines[i * options.game_count + j];
+        population[i].fitness = sum / options.game_count;
+    }
+
+    std::stable_sort(population.begin(), population.end(),
+            [](const Candidate &a, const Candidate &b) {
+                return a.fitness > b.fitness;
+            });
+}
+
+// The best tenth carries over, and the rest are children of two parents
+// picked by tournament, averaged by fitness and mutated
+static void breed(const Options &options, int generation, std::vector<Candidate> &population)
+{
+    std::minstd_rand rng(mix_seed(options.seed, generation, ~0u));
+    std::uniform_int_distribution<int> pick(0, population.size() - 1);
+    std::uniform_real_distribution<double> chance(0, 1);
+    std::normal_distribution<double> noise(0, 0.2 * std::pow(0.95, generation));
+
+    auto tournament = [&]() {
+        int best = pick(rng);
+        for (int i = 0; i < 2; i++)
+            best = std::min(best, pick(rng));
+        return population[best];
+    };
+
+    const int elite_count = std::max(1, options.population / 10);
+    std::vector<Candidate> next(population.begin(), population.begin() + elite_count);
+
+    while ((int) next.size() < options.population) {
+        const Candidate a = tournament();
+        const Candidate b = tournament();
+        const double total = a.fitness + b.fitness;
+        const double ratio = total > 0 ? a.fitness / total : 0.5;
+
+        Candidate child;
+        for (int i = 0; i < WEIGHT_COUNT; i++) {
+            child.weights[i] = ratio * a.weights[i] + (1 - ratio) * b.weights[i];
+            if (chance(rng) < 0.5)
+                child.weights[i] += noise(rng);
+        }
+        normalize(child.weights);
+        next.push_back(child);
+    }
+
+    population = next;
+}
+
+static bool save_checkpoint(const char *filename, int generation,
+        const std::vector<Candidate> &population)
+{
+    // Written aside and renamed, so a killed run leaves the last whole one
+    const std::string temp = std::string(filename) + ".tmp";
+    FILE *fp = fopen(temp.c_str(), "w");
+
+    if (!fp) {
+        fprintf(stderr, "can't open file: %s\n", temp.c_str());
+        return false;
+    }
+
+    fprintf(fp, "generation %d\n", generation);
+    fprintf(fp, "population %d\n", (int) population.size());
+    for (const Candidate &candidate: population) {
+        for (int i = 0; i < WEIGHT_COUNT; i++)
+            fprintf(fp, "%.17g ", candidate.weights[i]);
+        fprintf(fp, "%.17g\n", candidate.fitness);
+    }
+
+    if (fclose(fp) != 0 || rename(temp.c_str(), filename) != 0) {
+        fprintf(stderr, "can't write file: %s\n", filename);
+        return false;
+    }
+
+    return true;
+}
+
+static bool load_checkpoint(const char *filename, int &generation,
+        std::vector<Candidate> &population)
+{
+    FILE *fp = fopen(filename, "r");
+    if (!fp)
+        return false;
+
+    int count = 0;
+    bool is_valid = fscanf(fp, "generation %d\n", &generation) == 1 &&
+        fscanf(fp, "population %d\n", &count) == 1 && count > 0;
+
+    std::vector<Candidate> loaded(is_valid ? count : 0);
+    for (Candidate &candidate: loaded) {
+        for (int i = 0; i < WEIGHT_COUNT; i++)
+            is_valid = is_valid && fscanf(fp, "%lf", &candidate.weights[i]) == 1;
+        is_valid = is_valid && fscanf(fp, "%lf", &candidate.fitness) == 1;
+    }
+
+    fclose(fp);
+
+    if (!is_valid) {
+        fprintf(stderr, "not a checkpoint: %s\n", filename);
+        return false;
+    }
+
+    population = loaded;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    options.thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    // Arguments
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            options.population = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            options.generation_count = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            options.game_count = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+            options.piece_limit = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-g") && i + 1 < argc) {
+            options.garbage_count = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            options.depth = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            options.thread_count = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            options.seed = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+            options.checkpoint = argv[++i];
+        }
+        else {
+            fprintf(stderr, "error: unknown option: %s\n", argv[i]);
+            usage();
+            return 1;
+        }
+    }
+
+    if (options.population < 2 || options.generation_count < 1 || options.game_count < 1 ||
+        options.piece_limit < 1 || options.garbage_count < 0 ||
+        options.garbage_count >= FIELD_HEIGHT || options.depth < 1 || options.depth > 4 ||
+        options.thread_count < 1) {
+        usage();
+        return 1;
+    }
+
+    EnableLog(false);
+
+    // The default weights and variations of them, or where the last run stopped
+    int generation = 0;
+    std::vector<Candidate> population;
+
+    if (options.checkpoint && load_checkpoint(options.checkpoint, generation, population)) {
+        printf("resumed from %s at generation %d\n", options.checkpoint, generation);
+        options.population = population.size();
+        breed(options, generation++, population);
+    }
+    else {
+        std::minstd_rand rng(options.seed);
+        std::normal_distribution<double> noise(0, 0.2);
+        const BotWeights defaults;
+
+        population.resize(options.population);
+        for (size_t i = 0; i < population.size(); i++) {
+            double *weights = population[i].weights;
+            weights[0] = defaults.height;
+            weights[1] = defaults.lines;
+            weights[2] = defaults.holes;
+            weights[3] = defaults.bumpiness;
+
+            for (int j = 0; i > 0 && j < WEIGHT_COUNT; j++)
+                weights[j] += noise(rng);
+            normalize(weights);
+        }
+    }
+
+    for (int i = 0; i < options.generation_count; i++, generation++) {
+        const auto start = std::chrono::steady_clock::now();
+        evaluate(options, generation, population);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double mean = 0;
+        for (const Candidate &candidate: population)
+            mean += candidate.fitness;
+        mean /= population.size();
+
+        const Candidate &best = population[0];
+        const double game_count = (double) population.size() * options.game_count;
+        printf("generation %d: best %.1f lines, mean %.1f, weights %.6f %.6f %.6f %.6f, "
+                "%.1f s, %.0f games/s\n",
+                generation, best.fitness, mean,
+                best.weights[0], best.weights[1], best.weights[2], best.weights[3],
+                elapsed.count(), elapsed.count() > 0 ? game_count / elapsed.count() : 0.);
+        fflush(stdout);
+
+        if (options.checkpoint && !save_checkpoint(options.checkpoint, generation, population))
+            return 1;
+
+        if (i + 1 < options.generation_count)
+            breed(options, generation, population);
+    }
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "worker_pool.h"
+#include "trace.h"
+
+// Set on workers, and on a caller for the length of its run
+static thread_local bool is_in_run = false;
+
+WorkerPool::WorkerPool()
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_quitting_ = true;
+    }
+    start_cond_.notify_all();
+
+    for (auto &thread: threads_)
+        thread.join();
+}
+
+void WorkerPool::Run(int thread_count, const std::function<void()> &work)
+{
+    if (thread_count <= 1 || is_in_run) {
+        work();
+        return;
+    }
+
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while ((int) threads_.size() < thread_count - 1)
+            threads_.emplace_back(&WorkerPool::run_worker, this, (int) threads_.size());
+
+        work_ = &work;
+        wanted_count_ = thread_count - 1;
+        running_count_ = wanted_count_;
+        generation_++;
+    }
+    start_cond_.notify_all();
+
+    is_in_run = true;
+    work();
+    is_in_run = false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cond_.wait(lock, [this]() { return running_count_ == 0; });
+    work_ = nullptr;
+}
+
+void WorkerPool::run_worker(int index)
+{
+    TET_TRACE_THREAD("worker");
+    is_in_run = true;
+
+    uint64_t generation = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for (;;) {
+        start_cond_.wait(lock, [&]() { return is_quitting_ || generation_ != generation; });
+        if (is_quitting_)
+            return;
+
+        // Runs that want fewer threads leave the rest waiting
+        generation = generation_;
+        if (index >= wanted_count_)
+            continue;
+
+        const std::function<void()> &work = *work_;
+        lock.unlock();
+        work();
+        lock.lock();
+
+        if (--running_count_ == 0)
+            done_cond_.notify_one();
+    }
+}
+
+WorkerPool &GetWorkerPool()
+{
+    static WorkerPool pool;
+    return pool;
+}
@@ -0,0 +1,45 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads kept between parallel loops, so tools that run many of them
+// don't start new threads (and, in trace builds, new trace buffers) each
+// time. One run at a time; a run started from inside another calls work
+// on its own thread alone.
+class WorkerPool {
+public:
+    WorkerPool();
+    ~WorkerPool();
+
+    // Calls work on the calling thread and on thread_count - 1 workers,
+    // started on first need, and returns once every call has. Each call
+    // takes tasks from a shared counter until none are left.
+    void Run(int thread_count, const std::function<void()> &work);
+
+private:
+    std::mutex run_mutex_;
+
+    std::mutex mutex_;
+    std::condition_variable start_cond_;
+    std::condition_variable done_cond_;
+    const std::function<void()> *work_ = nullptr;
+    uint64_t generation_ = 0;
+    int wanted_count_ = 0;
+    int running_count_ = 0;
+    bool is_quitting_ = false;
+
+    std::vector<std::thread> threads_;
+
+    void run_worker(int index);
+};
+
+// The pool shared by the rollouts, the solver, the league and the tuner
+WorkerPool &GetWorkerPool();
+
+#endif